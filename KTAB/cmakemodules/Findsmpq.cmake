@@ -29,6 +29,7 @@ if(SMPQ_SOURCE_DIR)
     ${SMPQ_SOURCE_DIR}/mainwindow.cpp
     ${SMPQ_SOURCE_DIR}/csv.cpp
     ${SMPQ_SOURCE_DIR}/database.cpp
+    ${SMPQ_SOURCE_DIR}/scenariocache.cpp
     ${SMPQ_SOURCE_DIR}/bargraph.cpp
     ${SMPQ_SOURCE_DIR}/linegraph.cpp
     ${SMPQ_SOURCE_DIR}/runsmp.cpp
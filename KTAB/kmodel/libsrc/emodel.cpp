@@ -150,6 +150,11 @@ EPosition<PT>::~EPosition() {
 
 
 
+template <class PT>
+uint64_t EPosition<PT>::fingerprint(double) const {
+  return hashCombine(0, ((uint64_t)(ndx)));
+}
+
 template <class PT>
 void EPosition<PT>::print(ostream& os) const {
   os << "[EPosition " << ndx <<"]";
@@ -646,56 +651,113 @@ EState<PT>* EState<PT>::doMCN(ReportingLevel rl) const {
     currNdcs[i] = ppi->getIndex();
   }
 
-  vector<VUI> neighbors = {};
-  // the 0-neighbor, so we never take something less than the current
-  neighbors.push_back(currNdcs);
-
- // const unsigned int numOpt = eMod->numOptions();
+  // Each actor's moves are the similar options other than its current one.
   const unsigned int numSim = eMod->nSim;
-
-  // add 1-neighbors
+  vector<VUI> moves = {};
+  moves.resize(numA);
   for (unsigned int ai = 0; ai < numA; ai++) {
-    const VUI simI = similarPol(currNdcs[ai], numSim);
-    for (auto hpi : simI) {
+    for (auto hpi : similarPol(currNdcs[ai], numSim)) {
       if (hpi != currNdcs[ai]) {
-        VUI newN = currNdcs;
-        newN[ai] = hpi;
-        neighbors.push_back(newN);
+        moves[ai].push_back(hpi);
       }
     }
   }
 
-  // add 2-neighbors, avoiding equivalent permutations
-  for (unsigned int ai = 0; ai < numA; ai++) {
-    const VUI simI = similarPol(currNdcs[ai], numSim);
-    for (auto hpi : simI) {
-      for (unsigned int aj = 0; aj < numA; aj++) {
-        const VUI simJ = similarPol(currNdcs[aj], numSim);
-        for (auto hpj : simJ) {
-          if ((ai < aj) && (hpi != currNdcs[ai]) && (hpj != currNdcs[aj])) {
-            VUI newN = currNdcs;
-            newN[ai] = hpi;
-            newN[aj] = hpj;
-            neighbors.push_back(newN);
-          }
-        }
-      }
-    }
+  // Neighbors are not stored, but generated from their index, in this order:
+  // the 0-neighbor, so we never take something less than the current,
+  // then the 1-neighbors by actor, then the 2-neighbors by (ai, hpi, aj, hpj)
+  // with ai < aj, avoiding equivalent permutations.
+  // three-neighbors are possible, but prohibitively expensive and not very helpful.
+  uint64_t num1 = 0;
+  vector<uint64_t> movesAfter = {}; // moves of all actors after ai
+  vector<uint64_t> num2 = {}; // 2-neighbors whose first move is by ai
+  movesAfter.resize(numA);
+  num2.resize(numA);
+  for (unsigned int ai = numA; 0 < ai; ai--) {
+    movesAfter[ai - 1] = num1;
+    num2[ai - 1] = moves[ai - 1].size() * num1;
+    num1 = num1 + moves[ai - 1].size();
+  }
+  uint64_t numNghbrs = 1 + num1;
+  for (auto n2 : num2) {
+    numNghbrs = numNghbrs + n2;
   }
 
-  // three-neighbors are possible, but prohibitively expensive and not very helpful.
+  auto nghbrOf = [&currNdcs, &moves, &movesAfter, &num2, num1](uint64_t k) {
+    VUI ni = currNdcs;
+    if (0 == k) {
+      return ni;
+    }
+    k = k - 1;
+    unsigned int ai = 0;
+    if (k < num1) {
+      while (moves[ai].size() <= k) {
+        k = k - moves[ai].size();
+        ai++;
+      }
+      ni[ai] = moves[ai][k];
+      return ni;
+    }
+    k = k - num1;
+    while (num2[ai] <= k) {
+      k = k - num2[ai];
+      ai++;
+    }
+    ni[ai] = moves[ai][k / movesAfter[ai]];
+    k = k % movesAfter[ai];
+    unsigned int aj = ai + 1;
+    while (moves[aj].size() <= k) {
+      k = k - moves[aj].size();
+      aj++;
+    }
+    ni[aj] = moves[aj][k];
+    return ni;
+  };
 
   if (ReportingLevel::Silent < rl) {
-    LOG(INFO) << "Creating and ranking "<<neighbors.size() << " neighboring states";
+    LOG(INFO) << "Ranking " << numNghbrs << " neighboring states";
   }
-  // create and rank all (!) the neighboring states
+  // create and rank the neighboring states which might beat the best so far
   const auto w = eMod->actorWeights(); // a row vector
-  const unsigned int numNghbrs = neighbors.size();
 
-  // these two variables collect the results of a parallel search
+  // Expected utilities are a probability-weighted average of the utilities of
+  // the occupied options, so zeta = sum_j p_j z_j with z_j = sum_i w_i u_i(ni[j]),
+  // and can be no more than the largest z_j. Neighbors whose bound cannot
+  // beat the best so far are skipped without building their state.
+  // The utilities are those which uMatH(0) will use.
+  std::map<unsigned int, double> optZeta = {};
+  auto addOptZeta = [this, &optZeta, &w, numA](unsigned int tj) {
+    if (optZeta.end() == optZeta.find(tj)) {
+      const auto uj = actorUtilVectFn(0, tj);
+      double zj = 0.0;
+      for (unsigned int i = 0; i < numA; i++) {
+        zj = zj + w(0, i) * uj[i];
+      }
+      optZeta[tj] = zj;
+    }
+    return;
+  };
+  for (unsigned int ai = 0; ai < numA; ai++) {
+    addOptZeta(currNdcs[ai]);
+    for (auto hpi : moves[ai]) {
+      addOptZeta(hpi);
+    }
+  }
+  const bool pruneP = true;
+  auto zetaBound = [&optZeta, numA](const VUI& ni) {
+    double zb = optZeta.at(ni[0]);
+    for (unsigned int j = 1; j < numA; j++) {
+      const double zj = optZeta.at(ni[j]);
+      zb = (zb < zj) ? zj : zb;
+    }
+    return zb;
+  };
+
+  // these variables collect the results of a parallel search
   // for the neighbor with highest Zeta
   double bestZeta = 0.0; // all real zetas are positive
-  unsigned int bestNghbr = 0;
+  uint64_t bestNghbr = 0;
+  uint64_t numPruned = 0;
   std::mutex nsEvalMutex;
 
   // somewhat more explicit than "auto"
@@ -719,11 +781,24 @@ EState<PT>* EState<PT>::doMCN(ReportingLevel rl) const {
   };
 
 
-  function<void(unsigned int)> testNghbr =
-      [&neighbors, &w, &nsEvalMutex, &bestZeta, &bestNghbr, rl, numA, numP, this, stateFromVUI]
-      (unsigned int i) {
+  function<void(uint64_t)> testNghbr =
+      [&nghbrOf, &zetaBound, pruneP, &w, &nsEvalMutex, &bestZeta, &bestNghbr, &numPruned,
+       rl, numA, numP, this, stateFromVUI]
+      (uint64_t i) {
     const auto rlNewEU = ReportingLevel::Silent;
-    const VUI ni = neighbors[i];
+    const VUI ni = nghbrOf(i);
+    if (pruneP) {
+      const double zb = zetaBound(ni);
+      nsEvalMutex.lock();
+      const bool skipP = (zb < bestZeta);
+      if (skipP) {
+        numPruned++;
+      }
+      nsEvalMutex.unlock();
+      if (skipP) {
+        return;
+      }
+    }
     auto ns = stateFromVUI(ni, true);
     const unsigned int numUi = ns->uIndices.size();
 
@@ -745,7 +820,7 @@ EState<PT>* EState<PT>::doMCN(ReportingLevel rl) const {
       bestZeta = zi;
       bestNghbr = i;
       if (ReportingLevel::Low < rl) {
-        LOG(INFO) << KBase::getFormattedString("New best neighbor is %u with z=%.4f (delta=%.2E)\n",
+        LOG(INFO) << KBase::getFormattedString("New best neighbor is %llu with z=%.4f (delta=%.2E)\n",
                i, zi, delta);
         KBase::printVUI(ni);
       }
@@ -770,18 +845,31 @@ EState<PT>* EState<PT>::doMCN(ReportingLevel rl) const {
     }
   }
 
+  // Each chunk takes every numChunks-th neighbor, so all of them start with
+  // the 1-neighbors, which usually set a good bound for the 2-neighbors.
+  unsigned int numChunks = 1;
   if (parP) {
-    KBase::groupThreads(testNghbr, 0, numNghbrs-1);
+    numChunks = std::thread::hardware_concurrency();
+    numChunks = (0 == numChunks) ? 4 : numChunks;
   }
-  else {
-    for (unsigned int i=0; i<numNghbrs; i++) {
+  auto chunk = [&testNghbr, numNghbrs, numChunks](unsigned int c) {
+    for (uint64_t i = c; i < numNghbrs; i += numChunks) {
       testNghbr(i);
     }
+    return;
+  };
+  if (parP) {
+    KBase::groupThreads(chunk, 0, numChunks-1, numChunks);
+  }
+  else {
+    chunk(0);
   }
 
-  VUI nghbr = neighbors[bestNghbr];
+  VUI nghbr = nghbrOf(bestNghbr);
   if (ReportingLevel::Silent < rl) {
-    LOG(INFO) << KBase::getFormattedString("Highest zeta is %.5f for state %u: \n", bestZeta, bestNghbr);
+    LOG(INFO) << KBase::getFormattedString("Skipped %llu of %llu neighbors by their zeta bound",
+                                           numPruned, numNghbrs);
+    LOG(INFO) << KBase::getFormattedString("Highest zeta is %.5f for state %llu: \n", bestZeta, bestNghbr);
     printVUI(nghbr);
   }
 
@@ -801,44 +889,86 @@ KMatrix EState<PT>::hypExpUtilMat () const {
   return eu;
 }
 
+template<class PT>
+void EState<PT>::clearSimilarityIndex() const {
+  std::lock_guard<std::mutex> lock(pwsMutex);
+  pwsCols = {};
+  pwsCaps = {};
+  pwsNearest = {};
+  return;
+}
+
 template<class PT>
 VUI EState<PT>::powerWeightedSimilarity(const KMatrix& uMat, unsigned int ti, unsigned int nSim) const
 {
   const unsigned int numPos = eMod->numOptions();
   const unsigned int numAct = eMod->numAct;
+  assert(numAct == uMat.numR());
+  assert(numPos == uMat.numC());
+  assert(ti < numPos);
+  const unsigned int num = (nSim < numPos) ? nSim : numPos;
+
+  vector<double> caps = {};
+  caps.resize(numAct);
+  for (unsigned int j=0; j<numAct; j++) {
+    auto ej = (const KBase::EActor<unsigned int>*)(eMod->actrs[j]);
+    caps[j] = ej->sCap;
+  }
 
-  const auto colI = KBase::vSlice(uMat, ti);
+  std::lock_guard<std::mutex> lock(pwsMutex);
+
+  // a cheap check, not a full one: see clearSimilarityIndex
+  bool freshP = (numPos*numAct == pwsCols.size()) && (caps == pwsCaps);
+  for (unsigned int j = 0; freshP && (j < numAct); j++) {
+    freshP = (pwsCols[ti*numAct + j] == uMat(j, ti));
+  }
+  if (!freshP) {
+    pwsCaps = caps;
+    pwsNearest = {};
+    pwsCols.resize(numPos*numAct);
+    for (unsigned int k = 0; k < numPos; k++) {
+      for (unsigned int j = 0; j < numAct; j++) {
+        pwsCols[k*numAct + j] = uMat(j, k);
+      }
+    }
+  }
+
+  const auto nk = pwsNearest.find(ti);
+  if ((pwsNearest.end() != nk) && (num <= nk->second.size())) {
+    return VUI(nk->second.begin(), nk->second.begin() + num);
+  }
+
+  const double* ui = &(pwsCols[ti*numAct]);
+  const double* sj = &(caps[0]);
   vector<TDI> vdk = {};
   vdk.resize(numPos);
   for (unsigned int k = 0; k < numPos; k++) {
+    const double* uk = &(pwsCols[k*numAct]);
     double dk = 0.0;
-    //const auto colK = KBase::vSlice(uMat, k);
-    //assert (numAct == colK.numR());
     for (unsigned int j=0; j<numAct; j++) {
-      auto ej = (const KBase::EActor<unsigned int>*)(eMod->actrs[j]);
-      double sj = ej->sCap;
-      //auto duj = colI(j,0)-colK(j,0);
-      const double duj = uMat(j,ti) - uMat(j, k);
-      dk = dk + (sj*duj*duj);
+      const double duj = ui[j] - uk[j];
+      dk = dk + (sj[j]*duj*duj);
     }
     //LOG(INFO) << KBase::getFormattedString("%2u PW %.4f \n", k, dk);
     vdk[k] = TDI(dk, k);
   }
 
-  auto tupleLess = [](TDI t1, TDI t2) {
+  // only the nearest num need to be found and sorted; ties go to the lower index
+  auto tupleLess = [](const TDI& t1, const TDI& t2) {
     const double d1 = get<0>(t1);
     const double d2 = get<0>(t2);
-    return (d1 < d2);
+    return (d1 < d2) || ((d1 == d2) && (get<1>(t1) < get<1>(t2)));
   };
-  std::sort(vdk.begin(), vdk.end(), tupleLess);
+  std::nth_element(vdk.begin(), vdk.begin() + num, vdk.end(), tupleLess);
+  std::sort(vdk.begin(), vdk.begin() + num, tupleLess);
 
-  const unsigned int num = (nSim < numPos) ? nSim : numPos;
   VUI sdk = {};
   sdk.resize(num);
   for (unsigned int i = 0; i < num; i++) {
     unsigned int ki = get<1>(vdk[i]);
     sdk[i] = ki;
   }
+  pwsNearest[ti] = sdk;
   return sdk;
 }
 
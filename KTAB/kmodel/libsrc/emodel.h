@@ -123,6 +123,8 @@ public:
   int getIndex() const {
     return ndx;
   }
+  // options are enumerated, so the index is all there is to hash
+  virtual uint64_t fingerprint(double quantum) const;
 protected:
 
   // print the ndx to the output stream
@@ -168,6 +170,12 @@ public:
   // EState::powerWeightedSimilarity is an obvious candidate similarity-measure.
   virtual VUI similarPol(unsigned int ti, unsigned int numPol = 0) const = 0;
 
+  // Drop the index behind powerWeightedSimilarity. The index notices only a change
+  // in the shape of the utility matrix, in the actors' capabilities, or in column ti
+  // of the query itself; any other change to the utilities must be signalled with
+  // this, as PMatrixModel::setPMatrix and RP2Model::setRP2 do.
+  void clearSimilarityIndex() const;
+
   // get the index into Theta from the i-th position of this state.
   unsigned int posNdx(const unsigned int i) const;
 
@@ -210,15 +218,24 @@ protected:
   KMatrix hypExpUtilMat () const;
 
   EModel<PT>*  eMod = nullptr; // saves a lot of type-casting later
-  
-  
+
+
   // This is an attempt to define a domain-independent measure of similarity,
   // by looking at the difference in outcomes to actors.
   // Notice that if we sort the columns by difference from #ti,
   // those with small differences in outcome might do it by very different
   // means, so that columns from all over the matrix are placed near ti.
+  // The first call copies uMat option-major, so each distance is one contiguous
+  // loop; the nearest options of each ti are then kept, so repeats cost O(nSim),
+  // until the index is rebuilt (see clearSimilarityIndex).
   VUI powerWeightedSimilarity(const KMatrix& uMat, unsigned int ti, unsigned int nSim) const;
 
+  // index for powerWeightedSimilarity
+  mutable vector<double> pwsCols = {}; // utilities, one option after another
+  mutable vector<double> pwsCaps = {}; // the capabilities used with them
+  mutable std::map<unsigned int, VUI> pwsNearest = {}; // nearest options to ti, closest first
+  mutable std::mutex pwsMutex;
+
 private:
 };
 
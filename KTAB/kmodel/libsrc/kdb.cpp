@@ -0,0 +1,398 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+// DBValue, DBQuery, and the sqlite3 backend of DBConn
+// --------------------------------------------
+
+#include "kdb.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+namespace KBase {
+
+long long DBValue::toInt() const {
+  switch (typ) {
+  case Type::Int: return iVal;
+  case Type::Real: return (long long)rVal;
+  case Type::Text: return std::strtoll(sVal.c_str(), nullptr, 10);
+  default: return 0;
+  }
+}
+
+double DBValue::toDouble() const {
+  switch (typ) {
+  case Type::Int: return (double)iVal;
+  case Type::Real: return rVal;
+  case Type::Text: return std::strtod(sVal.c_str(), nullptr);
+  default: return 0.0;
+  }
+}
+
+string DBValue::toString() const {
+  char buff[32];
+  switch (typ) {
+  case Type::Int: return std::to_string(iVal);
+  case Type::Real:
+    // enough digits to read back the same double
+    snprintf(buff, sizeof(buff), "%.17g", rVal);
+    return string(buff);
+  case Type::Text: return sVal;
+  default: return "";
+  }
+}
+
+void copyTextRow(string & buf, const DBValue * row, unsigned int nc) {
+  for (unsigned int c = 0; c < nc; c++) {
+    const DBValue & v = row[c];
+    if (0 < c) {
+      buf += '\t';
+    }
+    if (v.isNull()) {
+      buf += "\\N";
+    }
+    else if (DBValue::Type::Text != v.type()) {
+      buf += v.toString();
+    }
+    else {
+      for (char ch : v.toString()) {
+        switch (ch) {
+        case '\\': buf += "\\\\"; break;
+        case '\t': buf += "\\t"; break;
+        case '\n': buf += "\\n"; break;
+        case '\r': buf += "\\r"; break;
+        default: buf += ch;
+        }
+      }
+    }
+  }
+  buf += '\n';
+  return;
+}
+
+// -------------------------------------------------
+
+bool DBConn::hasTable(const string & name) {
+  auto lower = [](string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+  };
+  const string n = lower(name);
+  for (auto t : tables()) {
+    if (lower(t) == n) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// -------------------------------------------------
+
+bool DBQuery::prepare(const string & sql) {
+  stmt.reset();
+  err = "";
+  if (nullptr == conn) {
+    err = "no database connection";
+    return false;
+  }
+  stmt.reset(conn->prepare(sql));
+  if (nullptr == stmt) {
+    err = conn->lastError();
+    return false;
+  }
+  return true;
+}
+
+void DBQuery::bindValue(const string & name, const DBValue & v) {
+  if (nullptr != stmt) {
+    stmt->bind(name, v);
+  }
+}
+
+void DBQuery::bindValue(int pos, const DBValue & v) {
+  if (nullptr != stmt) {
+    stmt->bind(pos, v);
+  }
+}
+
+bool DBQuery::exec() {
+  if (nullptr == stmt) {
+    return false;
+  }
+  const bool ok = stmt->exec();
+  err = ok ? "" : stmt->lastError();
+  return ok;
+}
+
+bool DBQuery::exec(const string & sql) {
+  return prepare(sql) && exec();
+}
+
+bool DBQuery::next() {
+  return (nullptr != stmt) && stmt->next();
+}
+
+DBValue DBQuery::value(int col) const {
+  return (nullptr != stmt) ? stmt->value(col) : DBValue();
+}
+
+int DBQuery::numCols() const {
+  return (nullptr != stmt) ? stmt->numCols() : 0;
+}
+
+void DBQuery::finish() {
+  stmt.reset();
+}
+
+string DBQuery::lastError() const {
+  return err;
+}
+
+// -------------------------------------------------
+// sqlite3 backend: no layer between the model and the C API
+
+class SqliteStmt : public DBStmt {
+public:
+  SqliteStmt(sqlite3 * d, sqlite3_stmt * s) : db(d), stmt(s) {}
+  virtual ~SqliteStmt() {
+    sqlite3_finalize(stmt);
+  }
+
+  virtual void bind(int pos, const DBValue & v) override {
+    // sqlite3 refuses bindings on a statement which has been stepped
+    // and not reset. Resetting keeps the other bindings, as DBStmt promises.
+    if (stepped) {
+      sqlite3_reset(stmt);
+      stepped = false;
+      pendingRow = false;
+      atEnd = false;
+    }
+    const int n = pos + 1; // sqlite3 counts from 1
+    int rc = SQLITE_OK;
+    switch (v.type()) {
+    case DBValue::Type::Int:
+      rc = sqlite3_bind_int64(stmt, n, v.toInt());
+      break;
+    case DBValue::Type::Real:
+      rc = sqlite3_bind_double(stmt, n, v.toDouble());
+      break;
+    case DBValue::Type::Text: {
+      const string s = v.toString();
+      rc = sqlite3_bind_text(stmt, n, s.c_str(), s.size(), SQLITE_TRANSIENT);
+    }
+      break;
+    default:
+      rc = sqlite3_bind_null(stmt, n);
+    }
+    // keep the first failure, for exec to report
+    if ((SQLITE_OK != rc) && bindErr.empty()) {
+      bindErr = "binding parameter " + std::to_string(n) + ": " + sqlite3_errstr(rc);
+    }
+  }
+
+  virtual void bind(const string & name, const DBValue & v) override {
+    const int n = sqlite3_bind_parameter_index(stmt, name.c_str());
+    if (0 < n) {
+      bind(n - 1, v);
+    }
+  }
+
+  virtual bool exec() override {
+    if (!bindErr.empty()) {
+      stepErr = bindErr;
+      bindErr = "";
+      return false;
+    }
+    stepErr = "";
+    if (stepped) {
+      sqlite3_reset(stmt);
+    }
+    pendingRow = false;
+    atEnd = false;
+    stepped = true;
+    const int rc = sqlite3_step(stmt);
+    if (SQLITE_ROW == rc) {
+      pendingRow = true;
+      return true;
+    }
+    if (SQLITE_DONE != rc) {
+      stepErr = sqlite3_errmsg(db); // before the reset
+    }
+    finishSteps();
+    return (SQLITE_DONE == rc);
+  }
+
+  virtual bool next() override {
+    if (pendingRow) {
+      pendingRow = false;
+      return true;
+    }
+    if (atEnd) {
+      return false;
+    }
+    if (SQLITE_ROW != sqlite3_step(stmt)) {
+      finishSteps();
+      return false;
+    }
+    return true;
+  }
+
+  virtual DBValue value(int col) const override {
+    switch (sqlite3_column_type(stmt, col)) {
+    case SQLITE_INTEGER:
+      return DBValue((long long)sqlite3_column_int64(stmt, col));
+    case SQLITE_FLOAT:
+      return DBValue(sqlite3_column_double(stmt, col));
+    case SQLITE_NULL:
+      return DBValue();
+    default:
+      return DBValue(string((const char *)sqlite3_column_text(stmt, col)));
+    }
+  }
+
+  virtual int numCols() const override {
+    return sqlite3_column_count(stmt);
+  }
+
+  virtual string lastError() const override {
+    return stepErr.empty() ? string(sqlite3_errmsg(db)) : stepErr;
+  }
+
+protected:
+  sqlite3 * db = nullptr;
+  sqlite3_stmt * stmt = nullptr;
+  bool pendingRow = false; // exec stepped onto the first row, for next to return
+  bool atEnd = false;
+  bool stepped = false; // stepped since the last reset
+  string bindErr = ""; // first failed binding since the last exec
+  string stepErr = ""; // why the last exec failed
+
+  // reset as soon as the results run out, so the statement takes
+  // new bindings and holds no locks
+  void finishSteps() {
+    atEnd = true;
+    stepped = false;
+    sqlite3_reset(stmt);
+  }
+};
+
+class SqliteConn : public DBConn {
+public:
+  SqliteConn() {}
+  virtual ~SqliteConn() {
+    close();
+  }
+
+  virtual string driver() const override { return "QSQLITE"; }
+
+  virtual bool open(const string & dbName, const string &, int,
+                    const string &, const string &) override {
+    close();
+    name = dbName;
+    if (SQLITE_OK != sqlite3_open_v2(dbName.c_str(), &db,
+                                     SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr)) {
+      err = (nullptr != db) ? sqlite3_errmsg(db) : "out of memory";
+      close();
+      return false;
+    }
+    sqlite3_busy_timeout(db, 5000); // as Qt's QSQLITE did
+    return true;
+  }
+
+  virtual bool isOpen() const override { return nullptr != db; }
+
+  virtual void close() override {
+    if (nullptr != db) {
+      sqlite3_close_v2(db);
+      db = nullptr;
+    }
+  }
+
+  virtual string databaseName() const override { return name; }
+
+  virtual DBStmt * prepare(const string & sql) override {
+    if (nullptr == db) {
+      err = "database not open";
+      return nullptr;
+    }
+    sqlite3_stmt * s = nullptr;
+    if (SQLITE_OK != sqlite3_prepare_v2(db, sql.c_str(), sql.size() + 1, &s, nullptr)) {
+      err = sqlite3_errmsg(db);
+      sqlite3_finalize(s);
+      return nullptr;
+    }
+    return new SqliteStmt(db, s);
+  }
+
+  virtual bool transaction() override { return run("BEGIN"); }
+  virtual bool commit() override { return run("COMMIT"); }
+  virtual bool rollback() override { return run("ROLLBACK"); }
+
+  virtual vector<string> tables() override {
+    auto tabs = vector<string>();
+    std::unique_ptr<DBStmt> s(prepare("SELECT name FROM sqlite_master WHERE type = 'table'"));
+    if ((nullptr != s) && s->exec()) {
+      while (s->next()) {
+        tabs.push_back(s->value(0).toString());
+      }
+    }
+    return tabs;
+  }
+
+  virtual string lastError() const override { return err; }
+
+protected:
+  sqlite3 * db = nullptr;
+  string name = "";
+  string err = "";
+
+  bool run(const char * sql) {
+    char * msg = nullptr;
+    const bool ok = (nullptr != db) && (SQLITE_OK == sqlite3_exec(db, sql, nullptr, nullptr, &msg));
+    if (nullptr != msg) {
+      err = msg;
+      sqlite3_free(msg);
+    }
+    return ok;
+  }
+};
+
+// -------------------------------------------------
+
+DBConn * DBConn::create(const string & driver) {
+  if ("QSQLITE" == driver) {
+    return new SqliteConn();
+  }
+#ifdef KTAB_QT_SQL
+  return newQtConn(driver);
+#else
+  return nullptr;
+#endif
+}
+
+}; // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
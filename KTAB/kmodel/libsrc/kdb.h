@@ -0,0 +1,155 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+// Storage behind Model's SQL logging. DBConn is one connection, with a
+// backend per driver name, as in the connection strings:
+//   QSQLITE  the sqlite3 C API directly; always built
+//   QPSQL    Qt's PostgreSQL driver; only with KTAB_QT_SQL
+// DBQuery gives the model code the prepare/bindValue/exec/next pattern
+// it used with QSqlQuery, so a build without Qt loses only PostgreSQL.
+// --------------------------------------------
+#ifndef KTAB_DB_H
+#define KTAB_DB_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace KBase {
+using std::string;
+using std::vector;
+
+// a NULL, integer, floating point or text value, bound to or read from a statement
+class DBValue {
+public:
+  enum class Type { Null, Int, Real, Text };
+
+  DBValue() {}
+  DBValue(int v) : typ(Type::Int), iVal(v) {}
+  DBValue(unsigned int v) : typ(Type::Int), iVal(v) {}
+  DBValue(long v) : typ(Type::Int), iVal(v) {}
+  DBValue(unsigned long v) : typ(Type::Int), iVal(v) {}
+  DBValue(long long v) : typ(Type::Int), iVal(v) {}
+  DBValue(unsigned long long v) : typ(Type::Int), iVal(v) {}
+  DBValue(double v) : typ(Type::Real), rVal(v) {}
+  DBValue(const string & v) : typ(Type::Text), sVal(v) {}
+  DBValue(const char * v) : typ(Type::Text), sVal(v) {}
+
+  Type type() const { return typ; }
+  bool isNull() const { return Type::Null == typ; }
+  long long toInt() const;
+  double toDouble() const;
+  string toString() const;
+
+protected:
+  Type typ = Type::Null;
+  long long iVal = 0;
+  double rVal = 0.0;
+  string sVal = "";
+};
+
+// append one row of nc values to buf in the text format of PostgreSQL's COPY:
+// tab separated, \N for NULL, backslash escapes in strings, ended by a newline
+void copyTextRow(string & buf, const DBValue * row, unsigned int nc);
+
+// one prepared statement. Bindings persist from one exec to the next;
+// exec leaves a SELECT before its first row.
+class DBStmt {
+public:
+  virtual ~DBStmt() {}
+  virtual void bind(int pos, const DBValue & v) = 0; // pos counts from 0
+  virtual void bind(const string & name, const DBValue & v) = 0; // e.g. ":turn_t"
+  virtual bool exec() = 0;
+  virtual bool next() = 0;
+  virtual DBValue value(int col) const = 0;
+  virtual int numCols() const = 0;
+  virtual string lastError() const = 0;
+};
+
+class DBConn {
+public:
+  virtual ~DBConn() {}
+
+  // a closed connection for the named driver; nullptr if this build lacks it
+  static DBConn * create(const string & driver);
+
+  virtual string driver() const = 0;
+  // server, port, user and password are ignored by file-based backends
+  virtual bool open(const string & dbName, const string & server = "", int port = 0,
+                    const string & user = "", const string & pwd = "") = 0;
+  virtual bool isOpen() const = 0;
+  virtual void close() = 0;
+  virtual string databaseName() const = 0;
+
+  // nullptr, with lastError set, if the statement does not compile
+  virtual DBStmt * prepare(const string & sql) = 0;
+  virtual bool transaction() = 0;
+  virtual bool commit() = 0;
+  virtual bool rollback() = 0;
+  virtual vector<string> tables() = 0;
+  virtual string lastError() const = 0;
+
+  // whether the backend has a bulk insert faster than a prepared INSERT (e.g. COPY),
+  // and that insert, of rows laid end to end in vals; false, with nothing
+  // written and lastError set, if it failed
+  virtual bool canCopy() const { return false; }
+  virtual bool copyRows(const string & /*tab*/, const vector<string> & /*cols*/,
+                        const vector<DBValue> & /*vals*/) { return false; }
+
+  // case-insensitive search of tables()
+  bool hasTable(const string & name);
+};
+
+// the query pattern of the model code, over one connection
+class DBQuery {
+public:
+  explicit DBQuery(DBConn * c = nullptr) : conn(c) {}
+
+  bool prepare(const string & sql);
+  void bindValue(const string & name, const DBValue & v);
+  void bindValue(int pos, const DBValue & v);
+  bool exec(); // the prepared statement
+  bool exec(const string & sql); // prepare and run sql
+  bool next();
+  DBValue value(int col) const;
+  int numCols() const;
+  void finish(); // done with the current statement
+  string lastError() const;
+
+protected:
+  DBConn * conn = nullptr;
+  std::unique_ptr<DBStmt> stmt = nullptr;
+  string err = "";
+};
+
+#ifdef KTAB_QT_SQL
+// the Qt backend, in kdbqt.cpp
+DBConn * newQtConn(const string & driver);
+#endif
+
+}; // end of namespace
+
+// --------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,254 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+// The Qt backend of DBConn, used for PostgreSQL. Built only with KTAB_QT_SQL;
+// with KTAB_PG_COPY as well, bulk rows go to the server with COPY.
+// --------------------------------------------
+
+#ifdef KTAB_QT_SQL
+
+#include "kdb.h"
+#include <atomic>
+#include <cstring>
+#include <QSqlDatabase>
+#include <QSqlDriver>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QVariant>
+
+#ifdef KTAB_PG_COPY
+#include <libpq-fe.h>
+#endif
+
+namespace KBase {
+
+static QVariant toQVariant(const DBValue & v) {
+  switch (v.type()) {
+  case DBValue::Type::Int: return QVariant(v.toInt());
+  case DBValue::Type::Real: return QVariant(v.toDouble());
+  case DBValue::Type::Text: return QVariant(QString::fromStdString(v.toString()));
+  default: return QVariant();
+  }
+}
+
+static DBValue fromQVariant(const QVariant & q) {
+  if (q.isNull()) {
+    return DBValue();
+  }
+  switch (q.type()) {
+  case QVariant::Int:
+  case QVariant::UInt:
+  case QVariant::LongLong:
+  case QVariant::ULongLong:
+  case QVariant::Bool:
+    return DBValue(q.toLongLong());
+  case QVariant::Double:
+    return DBValue(q.toDouble());
+  default:
+    return DBValue(q.toString().toStdString());
+  }
+}
+
+class QtStmt : public DBStmt {
+public:
+  explicit QtStmt(const QSqlQuery & q) : qry(q) {}
+  virtual ~QtStmt() {}
+
+  virtual void bind(int pos, const DBValue & v) override {
+    qry.bindValue(pos, toQVariant(v));
+  }
+  virtual void bind(const string & name, const DBValue & v) override {
+    qry.bindValue(QString::fromStdString(name), toQVariant(v));
+  }
+  virtual bool exec() override { return qry.exec(); }
+  virtual bool next() override { return qry.next(); }
+  virtual DBValue value(int col) const override { return fromQVariant(qry.value(col)); }
+  virtual int numCols() const override { return qry.record().count(); }
+  virtual string lastError() const override { return qry.lastError().text().toStdString(); }
+
+protected:
+  QSqlQuery qry;
+};
+
+class QtConn : public DBConn {
+public:
+  explicit QtConn(const string & drv) : drvName(drv) {
+    // each connection needs a name of its own, as models may run on several threads
+    static std::atomic<unsigned int> numConn(0);
+    connName = QString::fromStdString("ktab" + std::to_string(numConn++));
+    QSqlDatabase::addDatabase(QString::fromStdString(drv), connName);
+  }
+  virtual ~QtConn() {
+    close();
+    QSqlDatabase::removeDatabase(connName);
+  }
+
+  virtual string driver() const override { return drvName; }
+
+  virtual bool open(const string & dbName, const string & server, int port,
+                    const string & user, const string & pwd) override {
+    QSqlDatabase qdb = QSqlDatabase::database(connName, false);
+    qdb.setDatabaseName(QString::fromStdString(dbName));
+    qdb.setHostName(QString::fromStdString(server));
+    if (0 < port) {
+      qdb.setPort(port);
+    }
+    const bool ok = qdb.open(QString::fromStdString(user), QString::fromStdString(pwd));
+    err = ok ? "" : qdb.lastError().text().toStdString();
+    return ok;
+  }
+
+  virtual bool isOpen() const override { return db().isOpen(); }
+
+  virtual void close() override {
+    QSqlDatabase qdb = db();
+    if (qdb.isOpen()) {
+      qdb.close();
+    }
+  }
+
+  virtual string databaseName() const override { return db().databaseName().toStdString(); }
+
+  virtual DBStmt * prepare(const string & sql) override {
+    QSqlQuery q(db());
+    q.setForwardOnly(true);
+    if (!q.prepare(QString::fromStdString(sql))) {
+      err = q.lastError().text().toStdString();
+      return nullptr;
+    }
+    return new QtStmt(q);
+  }
+
+  virtual bool transaction() override { return db().transaction(); }
+  virtual bool commit() override { return db().commit(); }
+  virtual bool rollback() override { return db().rollback(); }
+
+  virtual vector<string> tables() override {
+    auto tabs = vector<string>();
+    for (auto t : db().tables()) {
+      tabs.push_back(t.toStdString());
+    }
+    return tabs;
+  }
+
+  virtual string lastError() const override { return err; }
+
+  virtual bool canCopy() const override {
+#ifdef KTAB_PG_COPY
+    return ("QPSQL" == drvName);
+#else
+    return false;
+#endif
+  }
+  virtual bool copyRows(const string & tab, const vector<string> & cols,
+                        const vector<DBValue> & vals) override;
+
+protected:
+  string drvName = "";
+  QString connName;
+  string err = "";
+
+  QSqlDatabase db() const { return QSqlDatabase::database(connName, false); }
+};
+
+bool QtConn::copyRows(const string & tab, const vector<string> & cols,
+                      const vector<DBValue> & vals) {
+#ifdef KTAB_PG_COPY
+  if ("QPSQL" != drvName) {
+    return false;
+  }
+  // Qt hands out the libpq connection it holds, so COPY shares its transaction
+  const QVariant h = db().driver()->handle();
+  if ((!h.isValid()) || (0 != strcmp(h.typeName(), "PGconn*"))) {
+    return false;
+  }
+  PGconn * conn = *static_cast<PGconn * const *>(h.constData());
+  if (nullptr == conn) {
+    return false;
+  }
+  auto pgExec = [conn](const string & sql, ExecStatusType ok) {
+    PGresult * res = PQexec(conn, sql.c_str());
+    const bool rslt = (ok == PQresultStatus(res));
+    PQclear(res);
+    return rslt;
+  };
+
+  // a failed COPY would abort the whole transaction, so it gets a savepoint to
+  // fall back to; outside a transaction this fails, and the caller uses INSERT
+  if (!pgExec("SAVEPOINT ktab_bulk", PGRES_COMMAND_OK)) {
+    err = PQerrorMessage(conn);
+    return false;
+  }
+  string sql = "COPY " + tab + " (";
+  for (unsigned int c = 0; c < cols.size(); c++) {
+    sql += ((0 < c) ? ", " : "") + cols[c];
+  }
+  sql += ") FROM STDIN";
+  const bool started = pgExec(sql, PGRES_COPY_IN);
+  bool ok = started;
+
+  const unsigned int nc = cols.size();
+  const size_t flushLen = 1 << 16;
+  string buf = "";
+  buf.reserve(flushLen + 1024);
+  for (unsigned int r = 0; ok && (r < vals.size()); r += nc) {
+    copyTextRow(buf, &vals[r], nc);
+    if ((flushLen < buf.size()) || (vals.size() <= r + nc)) {
+      ok = (1 == PQputCopyData(conn, buf.data(), buf.size()));
+      buf.clear();
+    }
+  }
+  if (started) {
+    ok = (1 == PQputCopyEnd(conn, ok ? nullptr : "ktab bulk write abandoned")) && ok;
+    PGresult * res = nullptr;
+    while (nullptr != (res = PQgetResult(conn))) {
+      ok = ok && (PGRES_COMMAND_OK == PQresultStatus(res));
+      PQclear(res);
+    }
+  }
+
+  if (ok) {
+    pgExec("RELEASE SAVEPOINT ktab_bulk", PGRES_COMMAND_OK);
+  }
+  else {
+    err = PQerrorMessage(conn);
+    pgExec("ROLLBACK TO SAVEPOINT ktab_bulk", PGRES_COMMAND_OK);
+  }
+  return ok;
+#else
+  return false;
+#endif
+}
+
+DBConn * newQtConn(const string & driver) {
+  return new QtConn(driver);
+}
+
+}; // end of namespace
+
+#endif
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,194 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+// Streaming aggregation of ensembles of stochastic runs
+// --------------------------------------------
+
+#include <assert.h>
+#include <easylogging++.h>
+
+#include "kmodel.h"
+
+namespace KBase {
+
+using std::get;
+
+EnsembleStats::EnsembleStats(const vector<double> & qs) {
+  probs = qs;
+  runLength = StreamSummary(probs);
+}
+
+void EnsembleStats::observe(const Model* m) {
+  assert(nullptr != m);
+  const unsigned int na = m->numAct;
+  const unsigned int nt = ((unsigned int)(m->history.size()));
+  assert(0 < nt);
+
+  // Extract the numbers of each turn before taking the lock, as
+  // the win probabilities need a PCE per state.
+  auto vp0 = dynamic_cast<const VctrPstn*>(m->history[0]->pstns[0]);
+  const unsigned int nd = (nullptr == vp0) ? 0 : vp0->numR();
+  auto pts = vector<vector<KMatrix>>(nt); // [t][i], empty if not a VctrPstn
+  auto wps = vector<vector<double>>(nt); // [t][i], empty if utilities were not set
+  for (unsigned int t = 0; t < nt; t++) {
+    const State* st = m->history[t];
+    assert(na == st->pstns.size());
+    for (unsigned int i = 0; (0 < nd) && (i < na); i++) {
+      auto vpi = dynamic_cast<const VctrPstn*>(st->pstns[i]);
+      assert(nullptr != vpi);
+      pts[t].push_back(KMatrix(*vpi));
+    }
+    if (na == st->aUtil.size()) {
+      auto pn = st->pDist(-1);
+      auto pdt = get<0>(pn);
+      auto unq = get<1>(pn);
+      for (unsigned int i = 0; i < na; i++) {
+        wps[t].push_back(st->posProb(i, unq, pdt));
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(statLock);
+  if (0 == nRuns) {
+    numAct = na;
+    numDim = nd;
+    finalPstnStats = vector<vector<StreamSummary>>(na, vector<StreamSummary>(nd, StreamSummary(probs)));
+    finalWinStats = vector<StreamSummary>(na, StreamSummary(probs));
+  }
+  if ((na != numAct) || (nd != numDim)) {
+    throw KException("EnsembleStats::observe: runs differ in number of actors or dimensions");
+  }
+  while (winStats.size() < nt) {
+    pstnStats.push_back(vector<vector<StreamSummary>>(na, vector<StreamSummary>(nd, StreamSummary(probs))));
+    winStats.push_back(vector<StreamSummary>(na, StreamSummary(probs)));
+  }
+
+  for (unsigned int t = 0; t < nt; t++) {
+    for (unsigned int i = 0; i < na; i++) {
+      for (unsigned int d = 0; d < pts[t].size() && d < nd; d++) {
+        pstnStats[t][i][d].add(pts[t][i](d, 0));
+      }
+      if (0 < wps[t].size()) {
+        winStats[t][i].add(wps[t][i]);
+      }
+    }
+  }
+  for (unsigned int i = 0; i < na; i++) {
+    for (unsigned int d = 0; d < pts[nt - 1].size() && d < nd; d++) {
+      finalPstnStats[i][d].add(pts[nt - 1][i](d, 0));
+    }
+    if (0 < wps[nt - 1].size()) {
+      finalWinStats[i].add(wps[nt - 1][i]);
+    }
+  }
+  runLength.add(nt - 1);
+  nRuns++;
+  return;
+}
+
+unsigned int EnsembleStats::numAt(unsigned int t) const {
+  assert(t < winStats.size());
+  // every run has at least one actor, and positions or utilities at each turn
+  auto n = (0 < numDim) ? pstnStats[t][0][0].stat().count() : winStats[t][0].stat().count();
+  return ((unsigned int)n);
+}
+
+const StreamSummary & EnsembleStats::pstnStat(unsigned int t, unsigned int i, unsigned int d) const {
+  assert(t < pstnStats.size());
+  assert(i < numAct);
+  assert(d < numDim);
+  return pstnStats[t][i][d];
+}
+
+const StreamSummary & EnsembleStats::finalPstnStat(unsigned int i, unsigned int d) const {
+  assert(i < numAct);
+  assert(d < numDim);
+  return finalPstnStats[i][d];
+}
+
+const StreamSummary & EnsembleStats::winStat(unsigned int t, unsigned int i) const {
+  assert(t < winStats.size());
+  assert(i < numAct);
+  return winStats[t][i];
+}
+
+const StreamSummary & EnsembleStats::finalWinStat(unsigned int i) const {
+  assert(i < numAct);
+  return finalWinStats[i];
+}
+
+void EnsembleStats::writeCSV(string fileName, const Model* m, const vector<string> & dimNames,
+                             double pScale) const {
+  assert(nullptr != m);
+  assert(numAct == m->numAct);
+  FILE* f = fopen(fileName.c_str(), "w");
+  if (nullptr == f) {
+    throw KException("EnsembleStats::writeCSV: could not open " + fileName);
+  }
+
+  fprintf(f, "Turn,Actor,Quantity,Count,Mean,StdDev,Min,Max");
+  for (auto p : probs) {
+    fprintf(f, ",Q%g", 100 * p);
+  }
+  fprintf(f, "\n");
+
+  auto row = [f](const string & tn, const string & an, const string & qn,
+                 const StreamSummary & ss, double sc) {
+    const RunningStat & rs = ss.stat();
+    if (0 == rs.count()) {
+      return;
+    }
+    fprintf(f, "%s,%s,%s,%llu,%f,%f,%f,%f", tn.c_str(), an.c_str(), qn.c_str(),
+            (unsigned long long)rs.count(), sc * rs.mean(), sc * rs.stdDev(),
+            sc * rs.min(), sc * rs.max());
+    for (unsigned int k = 0; k < ss.numQuantiles(); k++) {
+      fprintf(f, ",%f", sc * ss.quantile(k).value());
+    }
+    fprintf(f, "\n");
+    return;
+  };
+
+  auto dn = [&dimNames](unsigned int d) {
+    return (d < dimNames.size()) ? dimNames[d] : getFormattedString("Dim%u", d);
+  };
+
+  for (unsigned int t = 0; t <= winStats.size(); t++) {
+    const bool finalP = (t == winStats.size());
+    const string tn = finalP ? string("Final") : std::to_string(t);
+    for (unsigned int i = 0; i < numAct; i++) {
+      const string an = m->actrs[i]->name;
+      for (unsigned int d = 0; d < numDim; d++) {
+        row(tn, an, dn(d), finalP ? finalPstnStats[i][d] : pstnStats[t][i][d], pScale);
+      }
+      row(tn, an, "WinProb", finalP ? finalWinStats[i] : winStats[t][i], 1.0);
+    }
+  }
+  row("All", "All", "NumTurns", runLength, 1.0);
+  fclose(f);
+  return;
+}
+
+} // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -25,6 +25,8 @@
 #include <easylogging++.h>
 
 #include <time.h>
+#include <atomic>
+#include <thread>
 #include "kmodel.h"
 
 namespace KBase {
@@ -58,6 +60,10 @@ Model::Model(string desc, uint64_t sd, vector<bool> f, string Name) {
   {
     LOG(INFO) << "Grp" << i << "=" << (sqlFlags[i] ? 1 : 0); // "a<<b?c:d" was "suspicious code"
   }
+  setLogPolicies(logPolicySpec);
+  for (const auto & tp : logPolicies) {
+    LOG(INFO) << "Log policy for" << tp.first;
+  }
 
   // Record the UTC time so it can be used as the default scenario name
   std::chrono::time_point<std::chrono::system_clock> st;
@@ -149,7 +155,9 @@ Model::~Model() {
 
   while (0 < actrs.size()) {
     Actor * a = actrs[actrs.size() - 1];
-    delete a;
+    if (ownActors) {
+      delete a;
+    }
     actrs.pop_back();
   }
   numAct = 0;
@@ -163,17 +171,11 @@ Model::~Model() {
     KTables.pop_back();
   }
 
-  if (nullptr != qtDB && qtDB->isValid()) {
-    // Note: It is necessary to free the resources held by query object
-    // Else the removeDatabase() method causes segmentation fault
-    QString connName = qtDB->connectionName();
-    if(qtDB->isOpen()) {
-      query.clear();
-      qtDB->close();
-    }
-    delete qtDB;
-    qtDB = nullptr;
-    QSqlDatabase::removeDatabase(connName);
+  if (nullptr != dbConn) {
+    // the statement has to go before its connection
+    query.finish();
+    delete dbConn;
+    dbConn = nullptr;
   }
 }
 
@@ -184,16 +186,149 @@ void Model::run() {
   bool done = false;
   unsigned int iter = 0;
 
+  const bool profP = Profiler::isEnabled();
+  if (profP) {
+    Profiler::collect(true); // discard anything timed before the run
+    turnTiming = {};
+  }
+
+  // a repeated state only implies a repeating future if transitions are deterministic
+  const bool cycleP = (0 < maxCyclePeriod) && (StateTransMode::DeterminsticSTM == stm);
+  auto fps = vector<uint64_t>();
+  if (cycleP) {
+    fps.push_back(s0->fingerprint(fingerprintQuantum));
+  }
+  stopReason = "";
+  stopTurn = 0;
+  if (!KTables.empty()) {
+    checkLogPolicies();
+  }
+  if (nullptr != turnObserver) {
+    turnObserver(0, s0);
+  }
+
   while (!done) {
     assert(nullptr != s0);
     assert(nullptr != s0->step);
     iter++;
     LOG(INFO) << "Starting Model::run iteration" << iter;
-    auto s1 = s0->step();
+    State* s1 = nullptr;
+    {
+      ScopedTimer tmr("Model::run step");
+      s1 = s0->step();
+    }
     addState(s1);
-    done = stop(iter, s1);
+    {
+      ScopedTimer tmr("Model::run stop");
+      done = stop(iter, s1);
+    }
+    if (done) {
+      stopReason = "stopping criterion";
+    }
+    if (cycleP) {
+      fps.push_back(s1->fingerprint(fingerprintQuantum));
+      const unsigned int period = cyclePeriod(fps, maxCyclePeriod);
+      if ((!done) && (0 < period)) {
+        done = true;
+        stopReason = (1 == period) ? string("fixed point")
+                     : getFormattedString("cycle of period %u", period);
+      }
+    }
+    if ((!done) && (nullptr != cancelFlag) && cancelFlag->load()) {
+      done = true;
+      stopReason = "cancelled";
+    }
+    if (done) {
+      stopTurn = iter;
+      lastLogTurn = iter; // for whatever is logged after the run
+      LOG(INFO) << "Model::run ended at turn" << iter << "by" << stopReason;
+    }
+    if (nullptr != turnObserver) {
+      turnObserver(iter, s1);
+    }
     s0 = s1;
+    if (profP) {
+      turnTiming.push_back(Profiler::collect(true));
+    }
+  }
+  return;
+}
+
+string Model::turnTimingFile = "";
+
+void Model::profileTurns(string jsonFile) {
+  turnTimingFile = jsonFile;
+  Profiler::enable(true);
+  return;
+}
+
+unsigned int Model::cyclePeriod(const vector<uint64_t> & fps, unsigned int maxP) {
+  const unsigned int n = fps.size();
+  for (unsigned int p = 1; (p <= maxP) && (2 * p <= n); p++) {
+    bool rptP = true;
+    for (unsigned int k = 0; rptP && (k < p); k++) {
+      rptP = (fps[n - 1 - k] == fps[n - 1 - k - p]);
+    }
+    if (rptP) {
+      return p;
+    }
+  }
+  return 0;
+}
+
+void Model::runEnsemble(unsigned int numTraj, unsigned int numPar,
+                        function<Model*(unsigned int k, uint64_t seed)> trajectory,
+                        EnsembleStats & es) const {
+  assert(nullptr != trajectory);
+  if (StateTransMode::StochasticSTM != stm) {
+    LOG(INFO) << "Model::runEnsemble: transitions are deterministic, so all trajectories will match";
+  }
+  if (0 == numTraj) {
+    return;
+  }
+
+  // each trajectory already uses several threads per turn, so one per core is plenty
+  if (0 == numPar) {
+    numPar = std::thread::hardware_concurrency();
+  }
+  numPar = (0 == numPar) ? 1 : numPar;
+  numPar = (numTraj < numPar) ? numTraj : numPar;
+
+  // workers pull the next trajectory number until all are done
+  std::atomic<unsigned int> nextK(0);
+  auto worker = [this, numTraj, trajectory, &es, &nextK](unsigned int) {
+    for (unsigned int k = nextK++; k < numTraj; k = nextK++) {
+      Model* mk = trajectory(k, streamSeed(rngSeed, k));
+      assert(nullptr != mk);
+      assert(1 == mk->history.size());
+      mk->run();
+      es.observe(mk);
+      delete mk;
+      mk = nullptr;
+    }
+  };
+  groupThreads(worker, 0, numPar - 1, numPar);
+  LOG(INFO) << "Model::runEnsemble: finished" << es.numRuns() << "trajectories";
+  return;
+}
+
+uint64_t Model::streamSeed(uint64_t seed, unsigned int k) {
+  return hashCombine(seed, k);
+}
+
+void Model::writeTurnTiming(string jsonFile) const {
+  FILE* f = fopen(jsonFile.c_str(), "w");
+  if (nullptr == f) {
+    throw KException("Model::writeTurnTiming: could not open " + jsonFile);
+  }
+  fprintf(f, "{\n  \"ScenarioId\": \"%s\",\n  \"turns\": [\n", scenId.c_str());
+  for (unsigned int t = 0; t < turnTiming.size(); t++) {
+    fprintf(f, "    {\"turn\": %u, \"phases\": %s}%s\n", t,
+            Profiler::toJSON(turnTiming[t]).c_str(),
+            (t + 1 < turnTiming.size()) ? "," : "");
   }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
   return;
 }
 
@@ -43,11 +43,15 @@
 
 #include "kutils.h"
 #include "kmatrix.h"
+#include "kprofile.h"
+#include "kstream.h"
 #include "prng.h"
-#include <QSqlDatabase>
-#include <QSqlQuery>
+#include "kdb.h"
+#include <atomic>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 
 namespace KBase {
 using std::ostream;
@@ -63,6 +67,7 @@ class PRNG;
 class State;
 class Actor;
 class KTable;
+class EnsembleStats;
 
 
 // -------------------------------------------------
@@ -201,6 +206,10 @@ public:
   Position();
   virtual ~Position();
 
+  // Hash of this position, with numeric values quantized to the given step,
+  // for cycle detection. The default throws: override it to use that feature.
+  virtual uint64_t fingerprint(double quantum) const;
+
   friend ostream& operator<< (ostream& os, const Position& p) {
     p.print(os);
     return os;
@@ -228,6 +237,7 @@ public:
   VctrPstn(unsigned int nr, unsigned int nc);
   explicit VctrPstn(const KMatrix & m); // copy constructor
   virtual ~VctrPstn();
+  virtual uint64_t fingerprint(double quantum) const;
 protected:
   virtual void print(ostream& os) const;
 private:
@@ -250,6 +260,8 @@ public:
   virtual vector<MtchPstn> neighbors(unsigned int nVar) const;
   // assumes no interaction between items (permutation requires interaction)
 
+  virtual uint64_t fingerprint(double quantum) const;
+
   unsigned int numItm = 0;
   unsigned int numCat = 0;
   VUI match = {}; // must be of length numItm
@@ -284,6 +296,32 @@ protected:
 };
 
 
+// -------------------------------------------------
+// Which rows of one table get logged, within the group switched on by sqlFlags.
+// The default logs every row. Turn rules add up: with any of everyN, firstK and lastK
+// set, a turn is logged if any of them picks it. The row rules apply only to tables
+// with the matching columns; "the actor" of a row is its Act_i, Pos_i, Init_i or Voter_k.
+class LogPolicy {
+public:
+  unsigned int everyN = 0; // turns which are multiples of everyN
+  unsigned int firstK = 0; // the first firstK turns
+  unsigned int lastK = 0;  // the last lastK turns, up to Model::lastLogTurn
+  bool ownEst = false;     // only rows where the estimator is the actor (Est_h == Init_i)
+  vector<unsigned int> actors = {}; // only rows about these actors, sorted; empty means all
+  unsigned int topK = 0;   // only each actor's topK most likely bargains; 0 means all
+
+  bool turnP(unsigned int t, unsigned int lastTurn) const;
+  bool actorP(unsigned int i) const;
+  bool estP(unsigned int h, unsigned int i) const {
+    return (!ownEst) || (h == i);
+  }
+  bool allP() const; // true if this logs every row
+
+  // e.g. "every=5,first=3,last=3,h=i,actors=0-4+7,top=3"; throws KException
+  static LogPolicy parse(const string & rules);
+};
+
+
 // -------------------------------------------------
 class Model {
 public:
@@ -324,6 +362,41 @@ public:
   // significant is likely to happen if the run were to continue.
   void run();
 
+  // Cycle detection in run(), only with deterministic state transitions.
+  // If maxCyclePeriod > 0, each state is fingerprinted with the given quantum,
+  // and the run ends as soon as the last p fingerprints repeat the p before
+  // them, for some p <= maxCyclePeriod (p == 1 is a fixed point).
+  unsigned int maxCyclePeriod = 0;
+  double fingerprintQuantum = 1E-6;
+
+  // why and when the last run() ended
+  string stopReason = "";
+  unsigned int stopTurn = 0;
+
+  // Optional hooks for a run on another thread. run() calls turnObserver on the
+  // initial state and then on each new state, from the running thread (stopTurn
+  // is already set when it sees the last one); run() ends after the current
+  // turn once *cancelFlag becomes true.
+  function <void(unsigned int iter, const State* s)> turnObserver = nullptr;
+  const std::atomic<bool> * cancelFlag = nullptr;
+
+  // smallest period p <= maxP such that the last p fingerprints equal the
+  // p before them, or 0 if there is none
+  static unsigned int cyclePeriod(const vector<uint64_t> & fps, unsigned int maxP);
+
+  // Ensemble mode, for stochastic state transitions: run numTraj trajectories
+  // of this scenario, no more than numPar at a time (0 means one per core).
+  // trajectory(k, seed) must build an unrun model for the k-th path, sharing
+  // this model's actors and turn-0 state, whose PRNG starts from the given seed.
+  // Each finished path is folded into es and deleted, so at most numPar
+  // paths exist at once. Trajectories should not write to the database.
+  void runEnsemble(unsigned int numTraj, unsigned int numPar,
+                   function<Model*(unsigned int k, uint64_t seed)> trajectory,
+                   EnsembleStats & es) const;
+
+  // seed of the k-th independent PRNG stream derived from the given seed
+  static uint64_t streamSeed(uint64_t seed, unsigned int k);
+
   // simple voting based on the difference in utility.
   static double vote(VotingRule vr, double wi, double uij, double uik);
 
@@ -375,12 +448,36 @@ public:
   // these should probably be less public and more protected
   vector<Actor*> actrs = {};
   unsigned int numAct = 0;
+  bool ownActors = true; // false if actrs are borrowed from another model, as in an ensemble
   PRNG * rng = nullptr;
   vector<State*> history = {};
 
   vector<KTable*> KTables = {}; // JAH added 20160728 this will hold info for all defined tables
   vector<bool> sqlFlags= {};    // JAH added 20160730 this will hold the logging flag for each group of tables
 
+  // Per-table refinements of sqlFlags, by table name; a table without one logs every row.
+  // A model starts with those of logPolicySpec, set e.g. from the command line.
+  std::map<string, LogPolicy> logPolicies = {};
+  static string logPolicySpec;
+  // the policies of "Tab:rules;Tab:rules"; throws KException on a malformed spec
+  static std::map<string, LogPolicy> parseLogPolicies(const string & spec);
+  // add the policies of spec, replacing existing ones only if asked
+  void setLogPolicies(const string & spec, bool replace = true);
+  // throws KException if a policy names a table this model does not have
+  void checkLogPolicies() const;
+  const LogPolicy & logPolicy(const string & tab) const;
+  bool tabFlag(const string & tab) const; // the sqlFlags entry of the table's group
+  // does the table get any rows at turn t? Checks both sqlFlags and the policy.
+  bool logTurn(const string & tab, unsigned int t) const;
+  // the last turn for LogPolicy::lastK: a driver sets the turn limit before the run,
+  // and the actual last turn once it has stopped
+  unsigned int lastLogTurn = std::numeric_limits<unsigned int>::max();
+
+  // Per-turn phase timings, filled in by run() only when KBase::Profiler is enabled.
+  // turnTiming[t] is the time spent stepping from state t to state t+1;
+  // a driver may append one more entry for its post-run logging.
+  vector<PhaseTable> turnTiming = {};
+
   // output an existing actor util table, for the given turn, to SQLite
   void sqlAUtil(unsigned int t);
   // output an existing PosEquiv table, for the given turn, to SQLite
@@ -396,12 +493,53 @@ public:
 
 	void sqlBargainVote(unsigned int t, vector< std::tuple<uint64_t, uint64_t>> barginidspair_i_j, vector<double> Vote_mat, unsigned int act_k);
 
+  // output the phase timings of the given turn to the TurnTiming table
+  void sqlTurnTiming(unsigned int t);
+  // output all the phase timings as JSON
+  void writeTurnTiming(string jsonFile) const;
+
   void LogInfoTables(); // JAH 20160731
 
   void createTableIndices();
 
   void dropTableIndices();
 
+  // Database layouts. Version 1 repeats the ScenarioId string on every row, with no keys.
+  // Version 2 maps each ScenarioId to an integer in the ScenarioKeys table, and keeps
+  // each table T as TData, keyed by that integer (ScnKey) and clustered on a composite
+  // primary key (WITHOUT ROWID on SQLite); a view named T looks just like the
+  // version 1 table, so readers need not care. New databases get newSchemaVersion,
+  // while an existing one keeps the layout it has.
+  static unsigned int newSchemaVersion;
+  unsigned int schemaVersion = 1; // of the database this model writes to
+
+  // layout of an open database: 0 if it has no KTAB tables yet
+  static unsigned int dbSchemaVersion(DBConn & db);
+
+  // statements to create table t in the version 2 layout: the data table, its
+  // clustering index if it has no primary key, and the view.
+  // A table with no entry in compactKeys is created as it is in version 1.
+  static vector<string> compactSQL(const KTable * t, bool sqliteP);
+  // the same for the secondary indices built after a run, and their names
+  static vector<string> compactIndexSQL(const string & tabName);
+  static vector<string> compactIndexNames(const string & tabName);
+  // SQL name of the table that createSQL's statement creates
+  static string sqlTableName(const string & createSQL);
+  // column definitions and names of a version 1 table, without ScenarioId
+  static vector<string> sqlColumnDefs(const string & createSQL);
+  static vector<string> sqlColumnNames(const string & createSQL);
+
+  // Convert an open version 1 database to version 2 in one transaction: every scenario
+  // found in the tables gets a key, each of the given tables is copied into its
+  // compact form and the old one dropped. False, with nothing changed, on failure.
+  static bool migrateToCompact(DBConn & db, const vector<KTable*> & tabs);
+
+  // what writers put after INSERT INTO, and as the scenario column and value,
+  // so that one statement serves either layout
+  string sqlTab(const string & tabName) const;
+  string sqlScenCol() const;
+  string sqlScenVal() const;
+
   static void demoSQLite();
 
   static KMatrix bigRfromProb(const KMatrix & p, BigRRange rr);
@@ -422,19 +560,43 @@ public:
 
   static KTable * createSQL(unsigned int n);
 
-  void initDBDriver(QString connectionName);
+  // key columns after ScnKey in the version 2 layout, by table name, and whether
+  // they identify a row (a WITHOUT ROWID primary key) or just cluster it (an index)
+  static const std::map<string, tuple<string, bool>> & compactKeys();
+
+  // a connection to the database of loginCredentials, not yet open
+  void initDBDriver();
   bool connectDB();
   void closeDB();
   static void loginCredentials(string connString);
+
+  // enable KBase::Profiler for every later run; drivers record the
+  // per-turn timings in TurnTiming and, if a file is given, as JSON
+  static void profileTurns(string jsonFile = "");
   void beginDBTransaction();
   void commitDBTransaction();
-  QSqlQuery getQuery();
+  DBQuery getQuery() const; // a new query on this model's connection
+
+  // SQLite journal mode (e.g. MEMORY, or WAL to let readers in during a run) and
+  // whether the writer holds the file exclusively, set on each new connection
+  static string sqliteJournal;
+  static bool sqliteExclusive;
+
+  // Bulk writes of one table: bulkBegin, then bulkRow for each row (values in the order
+  // of cols; the scenario column is added here), then bulkEnd. Where the backend has a
+  // bulk path (COPY ... FROM STDIN on PostgreSQL, in a build with KTAB_PG_COPY), the
+  // rows take it; otherwise, or if it fails, they go through the prepared INSERT.
+  // With ownTxn, the rows get a transaction of their own.
+  static bool bulkCopy; // false always uses the prepared INSERT
+  void bulkBegin(const string & tabName, const vector<string> & cols, bool ownTxn = true) const;
+  void bulkRow(const vector<DBValue> & vals) const;
+  void bulkEnd() const;
 
   static void configLogger(string logFile);
 
 protected:
   //static string createTableSQL(unsigned int tn);
-  static const int NumTables = 13; //TODO: constant need to be redefined when new table is added
+  static const int NumTables = 14; //TODO: constant need to be redefined when new table is added
   static const int NumSQLLogGrps = 5; // TODO : Add one to this num when new logging group is added
   // note that the function to write to table #k must be kept
   // synchronized with the result of createSQL(k) !
@@ -445,28 +607,39 @@ protected:
   string scenName = "Scen"; // default is set from UTC time
   string scenDesc = ""; // default is set from UTC time
   string scenId = "none";
+  int scenKey = -1; // scenId's ScenarioKeys entry, in the version 2 layout
   uint64_t rngSeed = 0; // JAH 20160711 rng seed
 
+  // create the ScenarioKeys table if need be, and set scenKey
+  void setScenarioKey();
+
   // this is the basic model of victory dependent on strength-ratio
   static tuple<double, double> vProb(VPModel vpm, const double s1, const double s2);
 
-  static QString dbDriver;
-  static QString server;
+  static string dbDriver;
+  static string server;
   static int port;
-  static QString databaseName;
-  static QString userName;
-  static QString password;
-  QSqlDatabase *qtDB = nullptr;
-  mutable QSqlQuery query;
+  static string databaseName;
+  static string userName;
+  static string password;
+  static string turnTimingFile;
+  DBConn * dbConn = nullptr;
+  mutable DBQuery query;
+
+  // rows held between bulkBegin and bulkEnd
+  mutable string bulkTab = "";
+  mutable vector<string> bulkCols = {};
+  mutable vector<DBValue> bulkVals = {};
+  mutable bool bulkTxn = false;
   void configSqlite() const;
   void execQuery(std::string& qry);
-  bool createDB(const QString& dbName);
-  bool connect(const QString& server,
+  bool createDB(const string& dbName);
+  bool connect(const string& server,
     const int port,
-    const QString& databaseName,
-    const QString& userName,
-    const QString& password);
-  bool isDB(const QString& databaseName);
+    const string& databaseName,
+    const string& userName,
+    const string& password);
+  bool isDB(const string& databaseName);
 private:
   static KMatrix markovUniformPCE(const KMatrix & pv);
   //static KMatrix markovIncentivePCE(const KMatrix & pv);
@@ -474,6 +647,53 @@ private:
 };
 
 
+// -------------------------------------------------
+// Streaming summary of an ensemble of runs of one scenario. For every turn
+// and actor, it tracks each component of VctrPstn positions and the probability
+// that the actor's position is the outcome; the same is kept for the last
+// state of each run. Runs are folded in as they finish and are not stored.
+class EnsembleStats {
+public:
+  explicit EnsembleStats(const vector<double> & qs = { 0.05, 0.50, 0.95 });
+
+  // fold in the history of a finished run; safe to call from several threads
+  void observe(const Model* m);
+
+  unsigned int numRuns() const { return nRuns; }
+  unsigned int numTurns() const { return winStats.size(); }
+  // number of runs which reached turn t
+  unsigned int numAt(unsigned int t) const;
+
+  // stats of component d of actor i's position at turn t (or at the end)
+  const StreamSummary & pstnStat(unsigned int t, unsigned int i, unsigned int d) const;
+  const StreamSummary & finalPstnStat(unsigned int i, unsigned int d) const;
+
+  // stats of the probability that actor i's position wins at turn t (or at the end)
+  const StreamSummary & winStat(unsigned int t, unsigned int i) const;
+  const StreamSummary & finalWinStat(unsigned int i) const;
+
+  // number of turns taken by each run
+  const StreamSummary & lengthStat() const { return runLength; }
+
+  // one row per turn, actor, and quantity; names are taken from m.
+  // Position components are multiplied by pScale (e.g. 100 for SMP).
+  void writeCSV(string fileName, const Model* m, const vector<string> & dimNames,
+                double pScale = 1.0) const;
+
+protected:
+  vector<double> probs = {};
+  unsigned int nRuns = 0;
+  unsigned int numAct = 0;
+  unsigned int numDim = 0;
+  vector<vector<vector<StreamSummary>>> pstnStats = {}; // [t][i][d]
+  vector<vector<StreamSummary>> winStats = {}; // [t][i]
+  vector<vector<StreamSummary>> finalPstnStats = {}; // [i][d]
+  vector<StreamSummary> finalWinStats = {}; // [i]
+  StreamSummary runLength = StreamSummary();
+  mutable std::mutex statLock;
+};
+
+
 // -------------------------------------------------
 class State {
 public:
@@ -521,6 +741,11 @@ public:
 
   double posProb(unsigned int i, const VUI & unq, const KMatrix & pdt) const;
 
+  // Hash of everything which determines the next state under deterministic
+  // transitions. The default hashes the positions in order; subclasses with
+  // more state (e.g. ideal points) should add it in.
+  virtual uint64_t fingerprint(double quantum) const;
+
   // return the turn-number of this state.
   // 0 == initial state, and error if not in the model's history
   unsigned int myTurn() const;
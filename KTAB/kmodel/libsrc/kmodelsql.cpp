@@ -28,32 +28,32 @@
 
 #include "kmodel.h"
 
-#include <QVariant>
-#include <QSqlRecord>
-#include <QSqlQuery>
-#include <QSqlError>
-#include <QSqlDriver>
-
 namespace KBase
 {
 
 using std::get;
 using std::tuple;
 
-QString Model::dbDriver;
-QString Model::server;
+string Model::dbDriver;
+string Model::server;
 int Model::port=5432; // Default port for postgresql
-QString Model::databaseName;
-QString Model::userName;
-QString Model::password;
-
-void Model::initDBDriver(QString connectionName) {
-  if (QSqlDatabase::contains(connectionName)) {
-    LOG(INFO) << "A database connection already exists with the name: " << connectionName.toStdString();
+string Model::databaseName;
+string Model::userName;
+string Model::password;
+string Model::sqliteJournal = "MEMORY";
+bool Model::sqliteExclusive = true;
+
+void Model::initDBDriver() {
+  if (nullptr != dbConn) {
+    LOG(INFO) << "This model already has a database connection";
     return;
   }
-  QSqlDatabase qdb = QSqlDatabase::addDatabase(dbDriver, connectionName);
-  qtDB = new QSqlDatabase(qdb);
+  dbConn = DBConn::create(dbDriver);
+  if (nullptr == dbConn) {
+    LOG(INFO) << "This build has no database driver" << dbDriver;
+    throw KException("Model::initDBDriver: unsupported database driver");
+  }
+  query = DBQuery(dbConn);
 }
 
 bool Model::connectDB() {
@@ -62,44 +62,34 @@ bool Model::connectDB() {
 
 void Model::closeDB()
 {
-  if(qtDB != nullptr && qtDB->isValid() && qtDB->isOpen()) {
-      query.clear();
-      qtDB->close();
+  if (nullptr != dbConn && dbConn->isOpen()) {
+      query.finish();
+      dbConn->close();
   }
 }
 
-bool Model::connect(const QString& server,
+bool Model::connect(const string& server,
   const int port,
-  const QString& databaseName,
-  const QString& userName,
-  const QString& password)
+  const string& databaseName,
+  const string& userName,
+  const string& password)
 {
-  qtDB->setDatabaseName(databaseName);
-  qtDB->setHostName(server);
-  qtDB->setPort(port);
-
-  return qtDB->open(userName, password);
+  return dbConn->open(databaseName, server, port, userName, password);
 }
 
-bool Model::isDB(const QString& databaseName) {
-  QString stmt = "select 1 from pg_database where datname = ";
-  stmt.append(databaseName);
-  query.exec(stmt);
-  if (query.size() == 1) {
-    // database exists
-    return true;
-  }
-  return false;
+bool Model::isDB(const string& databaseName) {
+  string stmt = "select 1 from pg_database where datname = '" + databaseName + "'";
+  const bool found = query.exec(stmt) && query.next();
+  query.finish();
+  return found;
 }
 
-bool Model::createDB(const QString& dbName) {
-  QString createDBqry("CREATE DATABASE \"");
-  createDBqry.append(dbName);
-  createDBqry.append("\"");
-  LOG(INFO) << createDBqry.toStdString();
+bool Model::createDB(const string& dbName) {
+  string createDBqry = "CREATE DATABASE \"" + dbName + "\"";
+  LOG(INFO) << createDBqry;
 
   if (!query.exec(createDBqry)) {
-    LOG(INFO) << query.lastError().text().toStdString();
+    LOG(INFO) << query.lastError();
     return false;
   }
 
@@ -111,33 +101,103 @@ void Model::configSqlite() const {
   // we can shut off some of the journaling stuff intended to protect
   // the DB in case the system crashes in mid-operation.
   // Eliminating these checks can significantly speed operations.
-  query.exec("PRAGMA journal_mode = MEMORY");
-  query.exec("PRAGMA locking_mode = EXCLUSIVE");
+  query.exec("PRAGMA journal_mode = " + sqliteJournal);
+  query.exec(sqliteExclusive ? "PRAGMA locking_mode = EXCLUSIVE" : "PRAGMA locking_mode = NORMAL");
   query.exec("PRAGMA synchronous = OFF");
 
   // not a performance issue, but necessary for the data layout
   query.exec("PRAGMA foreign_keys = ON");
+  query.finish();
 }
 
 void Model::execQuery(std::string& qry) {
-  if (!query.exec(QString::fromStdString(qry))) {
+  if (!query.exec(qry)) {
     LOG(INFO) << "Failed Query: " << qry;
-    LOG(INFO) << query.lastError().text().toStdString();
+    LOG(INFO) << query.lastError();
     assert(false);
   }
 }
 
+// a model with no database (e.g. an ensemble trajectory) has nothing to commit
 void Model::beginDBTransaction() {
-  qtDB->transaction();
+  if (nullptr != dbConn) {
+    dbConn->transaction();
+  }
 }
 
 void Model::commitDBTransaction() {
-  qtDB->commit();
+  if (nullptr != dbConn) {
+    dbConn->commit();
+  }
 }
 
-QSqlQuery Model::getQuery()
+DBQuery Model::getQuery() const
 {
-  return query;
+  return DBQuery(dbConn);
+}
+
+bool Model::bulkCopy = true;
+
+void Model::bulkBegin(const string & tabName, const vector<string> & cols, bool ownTxn) const {
+  assert(bulkTab.empty()); // one table at a time
+  bulkTab = sqlTab(tabName);
+  bulkCols = cols;
+  bulkVals.clear();
+  bulkTxn = ownTxn && (nullptr != dbConn) && dbConn->transaction();
+}
+
+void Model::bulkRow(const vector<DBValue> & vals) const {
+  assert(vals.size() == bulkCols.size());
+  bulkVals.insert(bulkVals.end(), vals.begin(), vals.end());
+}
+
+void Model::bulkEnd() const {
+  assert(!bulkTab.empty());
+  const unsigned int nc = bulkCols.size();
+  bool copied = false;
+  if (bulkCopy && (0 < bulkVals.size()) && dbConn->canCopy()) {
+    // the backend takes whole rows, scenario column included
+    auto cols = vector<string>(1, sqlScenCol());
+    cols.insert(cols.end(), bulkCols.begin(), bulkCols.end());
+    const DBValue scen = (2 == schemaVersion) ? DBValue(scenKey) : DBValue(scenId);
+    auto vals = vector<DBValue>();
+    vals.reserve(bulkVals.size() + bulkVals.size() / nc);
+    for (unsigned int r = 0; r < bulkVals.size(); r += nc) {
+      vals.push_back(scen);
+      vals.insert(vals.end(), bulkVals.begin() + r, bulkVals.begin() + r + nc);
+    }
+    copied = dbConn->copyRows(bulkTab, cols, vals);
+    if (!copied) {
+      LOG(INFO) << "Bulk copy into" << bulkTab << "failed, using INSERT:" << dbConn->lastError();
+    }
+  }
+  if ((0 < bulkVals.size()) && !copied) {
+    string sql = "INSERT INTO " + bulkTab + " (" + sqlScenCol();
+    string vals = sqlScenVal();
+    for (auto c : bulkCols) {
+      sql += ", " + c;
+      vals += ", ?";
+    }
+    sql += ") VALUES (" + vals + ")";
+    query.prepare(sql);
+    for (unsigned int r = 0; r < bulkVals.size(); r += nc) {
+      for (unsigned int c = 0; c < nc; c++) {
+        query.bindValue(c, bulkVals[r + c]);
+      }
+      if (!query.exec()) {
+        LOG(INFO) << query.lastError();
+        assert(false);
+      }
+    }
+    query.finish();
+  }
+  if (bulkTxn) {
+    dbConn->commit();
+  }
+  bulkTab = "";
+  bulkCols = {};
+  bulkVals = {};
+  bulkTxn = false;
 }
 
 // JAH 20160728 added KTable class constructor
@@ -151,6 +211,156 @@ KTable::KTable(unsigned int ID, const string &name, const string &SQL, unsigned
 
 KTable::~KTable() {};
 
+// --------------------------------------------
+
+bool LogPolicy::turnP(unsigned int t, unsigned int lastTurn) const {
+  if ((0 == everyN) && (0 == firstK) && (0 == lastK)) {
+    return true;
+  }
+  const bool nthP = (0 < everyN) && (0 == t % everyN);
+  const bool lastP = (t <= lastTurn) && (lastTurn - t < lastK);
+  return nthP || (t < firstK) || lastP;
+}
+
+bool LogPolicy::actorP(unsigned int i) const {
+  return actors.empty() || std::binary_search(actors.begin(), actors.end(), i);
+}
+
+bool LogPolicy::allP() const {
+  return (0 == everyN) && (0 == firstK) && (0 == lastK) && (!ownEst) && actors.empty() && (0 == topK);
+}
+
+LogPolicy LogPolicy::parse(const string & rules) {
+  auto lp = LogPolicy();
+  auto num = [&rules](const string & s) {
+    unsigned int n = 0;
+    try {
+      size_t used = 0;
+      n = std::stoul(s, &used);
+      if (used != s.size()) {
+        throw std::invalid_argument(s);
+      }
+    }
+    catch (const std::exception &) {
+      throw KException("LogPolicy::parse: bad number '" + s + "' in '" + rules + "'");
+    }
+    return n;
+  };
+
+  std::istringstream rs(rules);
+  string rule;
+  while (std::getline(rs, rule, ',')) {
+    if (rule.empty()) {
+      continue;
+    }
+    if ("h=i" == rule) {
+      lp.ownEst = true;
+      continue;
+    }
+    const size_t eq = rule.find('=');
+    if (string::npos == eq) {
+      throw KException("LogPolicy::parse: unrecognized rule '" + rule + "'");
+    }
+    const string key = rule.substr(0, eq);
+    const string val = rule.substr(eq + 1);
+    if ("every" == key) {
+      lp.everyN = num(val);
+    }
+    else if ("first" == key) {
+      lp.firstK = num(val);
+    }
+    else if ("last" == key) {
+      lp.lastK = num(val);
+    }
+    else if ("top" == key) {
+      lp.topK = num(val);
+    }
+    else if ("actors" == key) {
+      // e.g. 0-4+7 for actors 0 through 4 and 7
+      std::istringstream as(val);
+      string rng;
+      while (std::getline(as, rng, '+')) {
+        const size_t dash = rng.find('-');
+        const unsigned int a1 = num(rng.substr(0, dash));
+        const unsigned int a2 = (string::npos == dash) ? a1 : num(rng.substr(dash + 1));
+        for (unsigned int a = a1; a <= a2; a++) {
+          lp.actors.push_back(a);
+        }
+      }
+      if (lp.actors.empty()) {
+        throw KException("LogPolicy::parse: no actors in '" + rule + "'");
+      }
+    }
+    else {
+      throw KException("LogPolicy::parse: unrecognized rule '" + rule + "'");
+    }
+  }
+  std::sort(lp.actors.begin(), lp.actors.end());
+  lp.actors.erase(std::unique(lp.actors.begin(), lp.actors.end()), lp.actors.end());
+  return lp;
+}
+
+string Model::logPolicySpec = "";
+
+std::map<string, LogPolicy> Model::parseLogPolicies(const string & spec) {
+  auto lps = std::map<string, LogPolicy>();
+  std::istringstream ss(spec);
+  string tp;
+  while (std::getline(ss, tp, ';')) {
+    if (tp.empty()) {
+      continue;
+    }
+    const size_t colon = tp.find(':');
+    if ((string::npos == colon) || (0 == colon)) {
+      throw KException("Model::parseLogPolicies: expected Table:rules, not '" + tp + "'");
+    }
+    lps[tp.substr(0, colon)] = LogPolicy::parse(tp.substr(colon + 1));
+  }
+  return lps;
+}
+
+void Model::setLogPolicies(const string & spec, bool replace) {
+  for (const auto & tp : parseLogPolicies(spec)) {
+    if (replace || (0 == logPolicies.count(tp.first))) {
+      logPolicies[tp.first] = tp.second;
+    }
+  }
+  return;
+}
+
+void Model::checkLogPolicies() const {
+  for (const auto & tp : logPolicies) {
+    bool found = false;
+    for (auto t : KTables) {
+      found = found || (t->tabName == tp.first);
+    }
+    if (!found) {
+      throw KException("Model::checkLogPolicies: no table " + tp.first);
+    }
+  }
+  return;
+}
+
+const LogPolicy & Model::logPolicy(const string & tab) const {
+  static const LogPolicy logAll = LogPolicy();
+  auto tp = logPolicies.find(tab);
+  return (logPolicies.end() == tp) ? logAll : tp->second;
+}
+
+bool Model::tabFlag(const string & tab) const {
+  for (auto t : KTables) {
+    if (t->tabName == tab) {
+      assert(t->tabGrpID < sqlFlags.size());
+      return sqlFlags[t->tabGrpID];
+    }
+  }
+  return false;
+}
+
+bool Model::logTurn(const string & tab, unsigned int t) const {
+  return tabFlag(tab) && logPolicy(tab).turnP(t, lastLogTurn);
+}
+
 void Model::demoSQLite()
 {
   LOG(INFO) << "Starting basic demo of SQLite in Model class";
@@ -537,6 +747,18 @@ KTable * Model::createSQL(unsigned int n)
     name = "ScenarioDesc";
     grpID = 0;
     break;
+
+  case 13: // time spent in each phase of each turn, when profiling is enabled
+    sql = "create table if not exists TurnTiming ("  \
+          "ScenarioId VARCHAR(32) NOT NULL DEFAULT 'None', "\
+          "Turn_t     INTEGER     NOT NULL DEFAULT 0, "\
+          "Phase      VARCHAR(64) NOT NULL DEFAULT 'None', "\
+          "Calls      INTEGER     NOT NULL DEFAULT 0, "\
+          "Seconds    FLOAT       NOT NULL DEFAULT 0.0"\
+          ");";
+    name = "TurnTiming";
+    grpID = 0;
+    break;
   default:
     throw(KException("Model::createTableSQL unrecognized table number"));
   }
@@ -549,6 +771,7 @@ KTable * Model::createSQL(unsigned int n)
 
 void Model::sqlAUtil(unsigned int t)
 {
+  ScopedTimer tmr("Model::sqlAUtil");
   assert(t < history.size());
   State* st = history[t];
   assert(nullptr != st);
@@ -560,37 +783,28 @@ void Model::sqlAUtil(unsigned int t)
   // mission-critical RDBMS, rather than a 1-off record of this run,
   // doing so might be disasterous in case the system crashed before
   // things were cleaned up.
-  string sql = "INSERT INTO PosUtil (ScenarioId, Turn_t, Est_h, Act_i, Pos_j, Util) VALUES ('"
-    + scenId + "', :turn_t, :est_h, :act_i, :pos_j, :util)";
-
-  query.prepare(QString::fromStdString(sql));
-
   // Prepared statements cache the execution plan for a query after the query optimizer has
   // found the best plan, so there is no big gain with simple insertions.
   // What makes a huge difference is bundling a few hundred into one atomic "transaction".
   // For this case, runtime droped from 62-65 seconds to 0.5-0.6 (vs. 0.30-0.33 with no SQL at all).
-  qtDB->transaction();
+  bulkBegin("PosUtil", { "Turn_t", "Est_h", "Act_i", "Pos_j", "Util" });
 
+  const LogPolicy & lp = logPolicy("PosUtil");
   for (unsigned int h = 0; h < numAct; h++)   // estimator is h
   {
-    KMatrix uij = st->aUtil[h]; // utility to actor i of the position held by actor j
+    const KMatrix & uij = st->aUtil[h]; // utility to actor i of the position held by actor j
     for (unsigned int i = 0; i < numAct; i++)
     {
+      if (!lp.estP(h, i) || !lp.actorP(i)) {
+        continue;
+      }
       for (unsigned int j = 0; j < numAct; j++)
       {
-        query.bindValue(":turn_t", t);
-        query.bindValue(":est_h", h);
-        query.bindValue(":act_i", i);
-        query.bindValue(":pos_j", j);
-        query.bindValue(":util", uij(i, j));
-        if (!query.exec()) {
-          LOG(INFO) << query.lastError().text().toStdString();
-          assert(false);
-        }
+        bulkRow({ t, h, i, j, uij(i, j) });
       }
     }
   }
-  qtDB->commit();
+  bulkEnd();
   return;
 }
 
@@ -598,19 +812,20 @@ void Model::sqlAUtil(unsigned int t)
 // module run
 void Model::sqlPosEquiv(unsigned int t)
 {
+  ScopedTimer tmr("Model::sqlPosEquiv");
   assert(t < history.size());
   State* st = history[t];
   assert(nullptr != st);
 
-  string qsql = string("INSERT INTO PosEquiv (ScenarioId, Turn_t, Pos_i, Eqv_j) VALUES ('")
-    + scenId + "', :turn_t, :pos_i, :eqv_j)";
-  query.prepare(QString::fromStdString(qsql));
-
-  qtDB->transaction();
+  bulkBegin("PosEquiv", { "Turn_t", "Pos_i", "Eqv_j" });
 
   // Start inserting record
+  const LogPolicy & lp = logPolicy("PosEquiv");
   for (unsigned int i = 0; i < numAct; i++)
   {
+    if (!lp.actorP(i)) {
+      continue;
+    }
     // calculate the equivalance
     int je = numAct + 1;
     for (unsigned int j = 0; j < numAct && je > numAct; j++)
@@ -620,29 +835,24 @@ void Model::sqlPosEquiv(unsigned int t)
         je = j;
       }
     }
-    query.bindValue(":turn_t", t);
-    query.bindValue(":pos_i", i);
-    query.bindValue(":eqv_j", je);
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
-      assert(false);
-    }
+    bulkRow({ t, i, je });
   }
   // end databse transaction
-  qtDB->commit();
+  bulkEnd();
 
   return;
 }
 
 void Model::sqlBargainEntries(unsigned int t, int bargainId, int initiator, int receiver, double val)
 {
+  ScopedTimer tmr("Model::sqlBargainEntries");
   // prepare the sql statement to insert
-  string sql = string("INSERT INTO Bargn (ScenarioId, Turn_t, BargnID, Init_Act_i, Recd_Act_j, Value) VALUES ('")
-    + scenId + "', :turn_t, :bargnid, :init_i, :recd_j, :value)";
-  query.prepare(QString::fromStdString(sql));
+  string sql = string("INSERT INTO ") + sqlTab("Bargn") + " (" + sqlScenCol() + ", Turn_t, BargnID, Init_Act_i, Recd_Act_j, Value) VALUES ("
+    + sqlScenVal() + ", :turn_t, :bargnid, :init_i, :recd_j, :value)";
+  query.prepare(sql);
 
   // start for the transaction
-  //qtDB->transaction();
+  //dbConn->transaction();
 
   // Turn_t
   query.bindValue(":turn_t", t);
@@ -655,26 +865,27 @@ void Model::sqlBargainEntries(unsigned int t, int bargainId, int initiator, int
   //Value
   query.bindValue(":value", val);
   if (!query.exec()) {
-    LOG(INFO) << query.lastError().text().toStdString();
+    LOG(INFO) << query.lastError();
     assert(false);
   }
-  //qtDB->commit();
+  //dbConn->commit();
 }
 
 
 
 void Model::sqlBargainCoords(unsigned int t, int bargnID, const KBase::VctrPstn & initPos, const KBase::VctrPstn & rcvrPos)
 {
+  ScopedTimer tmr("Model::sqlBargainCoords");
   int nDim = initPos.numR();
   assert(nDim == rcvrPos.numR());
 
   // prepare the sql statement to insert
-  string sql = string("INSERT INTO BargnCoords (ScenarioId, Turn_t, BargnID, Dim_k, Init_Coord, Recd_Coord) VALUES ('")
-    + scenId + "', :turn_t, :bargnid, :dim_k, :init_coord, :recd_coord)";
-  query.prepare(QString::fromStdString(sql));
+  string sql = string("INSERT INTO ") + sqlTab("BargnCoords") + " (" + sqlScenCol() + ", Turn_t, BargnID, Dim_k, Init_Coord, Recd_Coord) VALUES ("
+    + sqlScenVal() + ", :turn_t, :bargnid, :dim_k, :init_coord, :recd_coord)";
+  query.prepare(sql);
 
   // start for the transaction
-  //qtDB->transaction();
+  //dbConn->transaction();
 
   for (int k = 0; k < nDim; k++)
   {
@@ -692,52 +903,57 @@ void Model::sqlBargainCoords(unsigned int t, int bargnID, const KBase::VctrPstn
 
     query.bindValue(":recd_coord", rcvrPos(k, 0) * 100.0);
     if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
+      LOG(INFO) << query.lastError();
       assert(false);
     }
   }
 
-  //qtDB->commit();
+  //dbConn->commit();
 }
 
 
 
 void Model::sqlBargainUtil(unsigned int t, vector<uint64_t> bargnIds,  KBase::KMatrix Util_mat)
 {
+  ScopedTimer tmr("Model::sqlBargainUtil");
   int Util_mat_row = Util_mat.numR();
   int Util_mat_col = Util_mat.numC();
 
 
   // prepare the sql statement to insert
-  string sql = string("INSERT INTO BargnUtil  (ScenarioId, Turn_t,BargnId, Act_i, Util) VALUES ('")
-    + scenId + "', :turn_t, :bgnId, :act_i, :util)";
+  string sql = string("INSERT INTO ") + sqlTab("BargnUtil") + " (" + sqlScenCol() + ", Turn_t,BargnId, Act_i, Util) VALUES ("
+    + sqlScenVal() + ", :turn_t, :bgnId, :act_i, :util)";
 
-  query.prepare(QString::fromStdString(sql));
+  query.prepare(sql);
   // start for the transaction
-  //qtDB->transaction();
+  //dbConn->transaction();
   uint64_t Bargn_i = 0;
+  const LogPolicy & lp = logPolicy("BargnUtil");
   for (unsigned int i = 0; i < Util_mat_row; i++)
   {
+    if (!lp.actorP(i)) {
+      continue;
+    }
     for (unsigned int j = 0; j < Util_mat_col; j++)
     {
       // Turn_t
       query.bindValue(":turn_t", t);
       //Bargn_i
       Bargn_i = bargnIds[j];
-      query.bindValue(":bgnId", (qulonglong)Bargn_i);
+      query.bindValue(":bgnId", (unsigned long long)Bargn_i);
       //Act_i
       query.bindValue(":act_i", i);
       //Util
       query.bindValue(":util", Util_mat(i, j));
       // finish
       if (!query.exec()) {
-        LOG(INFO) << query.lastError().text().toStdString();
+        LOG(INFO) << query.lastError();
         assert(false);
       }
     }
   }
 
-  //qtDB->commit();
+  //dbConn->commit();
 }
 
 // JAH 20160731 added this function in replacement to the separate
@@ -745,16 +961,17 @@ void Model::sqlBargainUtil(unsigned int t, vector<uint64_t> bargnIds,  KBase::KM
 // this only covers the general "Model" info tables; currently only Actors and Scenarios
 void Model::LogInfoTables()
 {
+  ScopedTimer tmr("Model::LogInfoTables");
   // assert tests for all tables here at the start
   assert(numAct == actrs.size());
 
   // for efficiency sake, we'll do all tables in a single transaction
   // form the insert cmmands
   // prepare the prepared statement statements
-  string sql = "INSERT INTO ActorDescription (ScenarioId,Act_i,Name,\"Desc\") VALUES ('"
-    + scenId + "', :act_i, :name, :desc)";
-  query.prepare(QString::fromStdString(sql));
-  qtDB->transaction();
+  string sql = string("INSERT INTO ") + sqlTab("ActorDescription") + " (" + sqlScenCol() + ",Act_i,Name,\"Desc\") VALUES ("
+    + sqlScenVal() + ", :act_i, :name, :desc)";
+  query.prepare(sql);
+  dbConn->transaction();
   // Actor Description Table
   // For each actor fill the required information
   for (unsigned int i = 0; i < actrs.size(); i++) {
@@ -765,11 +982,11 @@ void Model::LogInfoTables()
     query.bindValue(":desc", act->desc.c_str());
     // record
     if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
+      LOG(INFO) << query.lastError();
       assert(false);
     }
   }
-  qtDB->commit();
+  dbConn->commit();
 
   // Scenario Description
   // Turn_t
@@ -794,15 +1011,16 @@ void Model::LogInfoTables()
 
 void Model::sqlBargainVote(unsigned int t, vector< tuple<uint64_t, uint64_t>> barginidspair_i_j, vector<double> Vote_mat,unsigned int act_k)
 {
+  ScopedTimer tmr("Model::sqlBargainVote");
   int Util_mat_row = Vote_mat.size();
 
   // prepare the sql statement to insert
-  string sql = string("INSERT INTO BargnVote (ScenarioId, Turn_t, BargnId_i, BargnId_j, Act_k, Vote) VALUES ('")
-    + scenId + "', :turn_t, :bargnid_i, :bargnid_j, :act_k, :vote)";
-  query.prepare(QString::fromStdString(sql));
+  string sql = string("INSERT INTO ") + sqlTab("BargnVote") + " (" + sqlScenCol() + ", Turn_t, BargnId_i, BargnId_j, Act_k, Vote) VALUES ("
+    + sqlScenVal() + ", :turn_t, :bargnid_i, :bargnid_j, :act_k, :vote)";
+  query.prepare(sql);
 
   // start for the transaction
-  //qtDB->transaction();
+  //dbConn->transaction();
 
   for (unsigned int i = 0; i <Util_mat_row ; i++)
   {
@@ -813,9 +1031,9 @@ void Model::sqlBargainVote(unsigned int t, vector< tuple<uint64_t, uint64_t>> ba
     // Turn_t
     query.bindValue(":turn_t", t);
     //Bargn_i
-    query.bindValue(":bargnid_i", (qulonglong)Bargn_i);
+    query.bindValue(":bargnid_i", (unsigned long long)Bargn_i);
     //Bargn_j
-    query.bindValue(":bargnid_j", (qulonglong)Bargn_j);
+    query.bindValue(":bargnid_j", (unsigned long long)Bargn_j);
     //Act_i
     query.bindValue(":act_k", act_k);
     //Util
@@ -823,31 +1041,31 @@ void Model::sqlBargainVote(unsigned int t, vector< tuple<uint64_t, uint64_t>> ba
     query.bindValue(":vote", voteMat);
     // finish
     if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
+      LOG(INFO) << query.lastError();
       assert(false);
     }
   }
-  //qtDB->commit();
+  //dbConn->commit();
 }
 
 // populates record for table PosProb for each step of
 // module run
 void Model::sqlPosProb(unsigned int t)
 {
+  ScopedTimer tmr("Model::sqlPosProb");
   assert(t < history.size());
   State* st = history[t];
   // check module for null
   assert(nullptr != st);
-  // prepare the sql statement to insert
-  string sql = string("INSERT INTO PosProb (ScenarioId, Turn_t, Est_h,Pos_i, Prob) VALUES ('")
-    + scenId + "', :turn_t, :est_h, :pos_i, :prob)";
-  query.prepare(QString::fromStdString(sql));
-
   // start for the transaction
-  qtDB->transaction();
+  bulkBegin("PosProb", { "Turn_t", "Est_h", "Pos_i", "Prob" });
   // collect the information from each estimator,actor
+  const LogPolicy & lp = logPolicy("PosProb");
   for (unsigned int h = 0; h < numAct; h++)   // estimator is h
   {
+    if (lp.ownEst && !lp.actorP(h)) {
+      continue; // no rows from this estimator
+    }
     // calculate the probablity with respect to each estimator
     auto pn = st->pDist(h);
     auto pdt = std::get<0>(pn); // note that these are unique positions
@@ -856,43 +1074,38 @@ void Model::sqlPosProb(unsigned int t)
     // for each actor pupulate the probablity information
     for (unsigned int i = 0; i < numAct; i++)
     {
+      if (!lp.estP(h, i) || !lp.actorP(i)) {
+        continue;
+      }
       // Extract the probabity for each actor
       double prob = st->posProb(i, unq, pdt);
-      query.bindValue(":turn_t", t);
-      query.bindValue(":est_h", h);
-      query.bindValue(":pos_i", i);
-      query.bindValue(":prob", prob);
-      if (!query.exec()) {
-        LOG(INFO) << query.lastError().text().toStdString();
-        assert(false);
-      }
+      bulkRow({ t, h, i, prob });
     }
   }
-  qtDB->commit();
+  bulkEnd();
   return;
 }
 // populates record for table PosProb for each step of
 // module run
 void Model::sqlPosVote(unsigned int t)
 {
+  ScopedTimer tmr("Model::sqlPosVote");
   assert(t < history.size());
   State* st = history[t];
 
 
   // check module for null
   assert(nullptr != st);
-  // prepare the sql statement to insert
-  string sql = string("INSERT INTO PosVote (ScenarioId, Turn_t, Est_h, Voter_k, Pos_i, Pos_j, Vote) VALUES ('")
-    + scenId + "', :turn_t, :est_h, :voter_k, :pos_i, :pos_j, :vote)";
-  query.prepare(QString::fromStdString(sql));
-
   // start for the transaction
-  qtDB->transaction();
+  bulkBegin("PosVote", { "Turn_t", "Est_h", "Voter_k", "Pos_i", "Pos_j", "Vote" });
   auto vr = VotingRule::Proportional;
   // collect the information from each estimator
-
+  const LogPolicy & lp = logPolicy("PosVote");
   for (unsigned int k = 0; k < numAct; k++)   // voter is k
   {
+    if (!lp.actorP(k)) {
+      continue;
+    }
     auto rd = st->model->actrs[k];
     for (unsigned int i = 0; i < numAct; i++)
     {
@@ -900,34 +1113,54 @@ void Model::sqlPosVote(unsigned int t)
       {
         for (unsigned int h = 0; h < numAct; h++)   // estimator is h
         {
-          if (((h == i) || (h == j)) && (i!=j))
+          if (((h == i) || (h == j)) && (i!=j) && lp.estP(h, k))
           {
             auto vij = rd->vote(h, i, j, st);
-            query.bindValue(":turn_t", t);
-            query.bindValue(":est_h", h);
-            //voter_k
-            query.bindValue(":voter_k", k);
-            // position i
-            query.bindValue(":pos_i", i);
-            //position j
-            query.bindValue(":pos_j", j);
-            // vote ?
-            query.bindValue(":vote", vij);
-            if (!query.exec()) {
-              LOG(INFO) << query.lastError().text().toStdString();
-              assert(false);
-            }
+            bulkRow({ t, h, k, i, j, vij });
           }
         }
       }
     }
   }
-  qtDB->commit();
+  bulkEnd();
 
   return;
 }
 
+void Model::sqlTurnTiming(unsigned int t)
+{
+  assert(t < turnTiming.size());
+  // prepare the sql statement to insert
+  string sql = string("INSERT INTO ") + sqlTab("TurnTiming") + " (" + sqlScenCol() + ", Turn_t, Phase, Calls, Seconds) VALUES ("
+    + sqlScenVal() + ", :turn_t, :phase, :calls, :seconds)";
+  query.prepare(sql);
+
+  // start for the transaction
+  dbConn->transaction();
+  for (const auto & ph : turnTiming[t]) {
+    query.bindValue(":turn_t", t);
+    query.bindValue(":phase", ph.first);
+    query.bindValue(":calls", (unsigned long long)(ph.second.calls));
+    query.bindValue(":seconds", ph.second.seconds);
+    if (!query.exec()) {
+      LOG(INFO) << query.lastError();
+      assert(false);
+    }
+  }
+  dbConn->commit();
+  return;
+}
+
 void Model::createTableIndices() {
+    if (2 == schemaVersion) {
+        // the primary keys already cover what idx_util and idx_actor did
+        for (auto t : KTables) {
+            for (auto s : compactIndexSQL(sqlTableName(t->tabSQL))) {
+                execQuery(s);
+            }
+        }
+        return;
+    }
     const char * indexUtil = "CREATE INDEX IF NOT EXISTS idx_util ON PosUtil(ScenarioId, Turn_t, Est_h, Act_i, Pos_j)";
     string qry = string(indexUtil);
     execQuery(qry);
@@ -938,6 +1171,15 @@ void Model::createTableIndices() {
 }
 
 void Model::dropTableIndices() {
+    if (2 == schemaVersion) {
+        for (auto t : KTables) {
+            for (auto n : compactIndexNames(sqlTableName(t->tabSQL))) {
+                string qry = "DROP INDEX IF EXISTS " + n;
+                execQuery(qry);
+            }
+        }
+        return;
+    }
     const char * indexUtil = "DROP INDEX IF EXISTS idx_util";
     string qry = string(indexUtil);
     execQuery(qry);
@@ -947,6 +1189,254 @@ void Model::dropTableIndices() {
     execQuery(qry);
 }
 
+unsigned int Model::newSchemaVersion = 2;
+
+const std::map<string, tuple<string, bool>> & Model::compactKeys() {
+  // Keys follow the order in which rows are written and read, mostly turn first.
+  // A bargain may be logged more than once per turn, so those tables are only clustered.
+  static const std::map<string, tuple<string, bool>> keys = {
+    { "PosUtil", tuple<string, bool>("Turn_t, Est_h, Act_i, Pos_j", true) },
+    { "PosVote", tuple<string, bool>("Turn_t, Est_h, Voter_k, Pos_i, Pos_j", true) },
+    { "PosProb", tuple<string, bool>("Turn_t, Est_h, Pos_i", true) },
+    { "PosEquiv", tuple<string, bool>("Turn_t, Pos_i", true) },
+    { "UtilChlg", tuple<string, bool>("Turn_t, Est_h, Aff_k, Init_i, Rcvr_j", true) },
+    { "ProbVict", tuple<string, bool>("Turn_t, Est_h, Init_i, Rcvr_j", true) },
+    { "TPProbVictLoss", tuple<string, bool>("Turn_t, Est_h, Init_i, Rcvr_j, ThrdP_k", true) },
+    { "ActorDescription", tuple<string, bool>("Act_i", true) },
+    { "TurnTiming", tuple<string, bool>("Turn_t, Phase", true) },
+    { "Bargn", tuple<string, bool>("BargnId, Turn_t", false) },
+    { "BargnCoords", tuple<string, bool>("Turn_t, BargnId, Dim_k", false) },
+    { "BargnUtil", tuple<string, bool>("Turn_t, BargnId, Act_i", false) },
+    { "BargnVote", tuple<string, bool>("Turn_t, BargnId_i, BargnId_j, Act_k", false) },
+    { "VectorPosition", tuple<string, bool>("Turn_t, Dim_k, Act_i", true) },
+    { "SpatialSalience", tuple<string, bool>("Turn_t, Dim_k, Act_i", true) },
+    { "SpatialCapability", tuple<string, bool>("Turn_t, Act_i", true) },
+    { "DimensionDescription", tuple<string, bool>("Dim_k", true) },
+    { "Accommodation", tuple<string, bool>("Act_i, Act_j", true) }
+  };
+  return keys;
+}
+
+string Model::sqlTableName(const string & createSQL) {
+  const string lead = "create table if not exists ";
+  assert(0 == createSQL.find(lead));
+  const size_t b = lead.size();
+  const size_t e = createSQL.find_first_of(" (", b);
+  return createSQL.substr(b, e - b);
+}
+
+vector<string> Model::sqlColumnDefs(const string & createSQL) {
+  // split the body on the commas outside parentheses, e.g. not those in VARCHAR(32)
+  const size_t b = createSQL.find('(');
+  const size_t e = createSQL.rfind(')');
+  assert((string::npos != b) && (string::npos != e) && (b < e));
+  auto defs = vector<string>();
+  string def = "";
+  int depth = 0;
+  auto flush = [&defs, &def]() {
+    const size_t f = def.find_first_not_of(' ');
+    const size_t l = def.find_last_not_of(' ');
+    if (string::npos != f) {
+      const string d = def.substr(f, l - f + 1);
+      if (0 != d.find("ScenarioId ")) {
+        defs.push_back(d);
+      }
+    }
+    def = "";
+  };
+  for (size_t n = b + 1; n < e; n++) {
+    const char c = createSQL[n];
+    depth += (('(' == c) ? 1 : 0) - ((')' == c) ? 1 : 0);
+    if ((0 == depth) && (',' == c)) {
+      flush();
+    }
+    else {
+      def.push_back(c);
+    }
+  }
+  flush();
+  return defs;
+}
+
+vector<string> Model::sqlColumnNames(const string & createSQL) {
+  auto names = vector<string>();
+  for (auto d : sqlColumnDefs(createSQL)) {
+    if (0 != d.find("CHECK")) {
+      names.push_back(d.substr(0, d.find(' ')));
+    }
+  }
+  return names;
+}
+
+vector<string> Model::compactSQL(const KTable * t, bool sqliteP) {
+  assert(nullptr != t);
+  const string name = sqlTableName(t->tabSQL);
+  const auto kPtr = compactKeys().find(name);
+  if (compactKeys().end() == kPtr) {
+    return { t->tabSQL };
+  }
+  const string keys = "ScnKey, " + std::get<0>(kPtr->second);
+  const bool uniqueP = std::get<1>(kPtr->second);
+
+  string sql = "create table if not exists " + name + "Data (ScnKey INTEGER NOT NULL";
+  for (auto d : sqlColumnDefs(t->tabSQL)) {
+    sql += ", " + d;
+  }
+  if (uniqueP) {
+    sql += ", PRIMARY KEY (" + keys + "))";
+    sql += sqliteP ? " WITHOUT ROWID;" : ";";
+  }
+  else {
+    sql += ");";
+  }
+  auto stmts = vector<string>{ sql };
+  if (!uniqueP) {
+    stmts.push_back("CREATE INDEX IF NOT EXISTS idx_" + name + "_key ON " + name + "Data(" + keys + ")");
+  }
+
+  // readers see the version 1 columns, in the version 1 order
+  string cols = "K.ScenarioId";
+  for (auto c : sqlColumnNames(t->tabSQL)) {
+    cols += ", D." + c;
+  }
+  const string view = name + " AS SELECT " + cols + " FROM " + name + "Data D"
+    " INNER JOIN ScenarioKeys K ON K.ScenarioKey = D.ScnKey";
+  stmts.push_back(sqliteP ? ("CREATE VIEW IF NOT EXISTS " + view) : ("CREATE OR REPLACE VIEW " + view));
+  return stmts;
+}
+
+vector<string> Model::compactIndexNames(const string & tabName) {
+  if ("VectorPosition" == tabName) {
+    return { "idx_vpos_actor" };
+  }
+  return {};
+}
+
+vector<string> Model::compactIndexSQL(const string & tabName) {
+  // one actor's path through time, as for Sankey output and the line plot;
+  // Pos_Coord is included so the index alone answers the query
+  if ("VectorPosition" == tabName) {
+    return { "CREATE INDEX IF NOT EXISTS idx_vpos_actor ON VectorPositionData"
+             "(ScnKey, Act_i, Dim_k, Turn_t, Pos_Coord)" };
+  }
+  return {};
+}
+
+unsigned int Model::dbSchemaVersion(DBConn & db) {
+  if (db.hasTable("ScenarioKeys")) {
+    return 2;
+  }
+  if (db.hasTable("ScenarioDesc")) {
+    return 1;
+  }
+  return 0;
+}
+
+void Model::setScenarioKey() {
+  assert(2 == schemaVersion);
+  string sql = (0 == dbDriver.compare("QPSQL"))
+    ? "create table if not exists ScenarioKeys (ScenarioKey SERIAL PRIMARY KEY, "
+      "ScenarioId VARCHAR(32) NOT NULL UNIQUE)"
+    : "create table if not exists ScenarioKeys (ScenarioKey INTEGER PRIMARY KEY, "
+      "ScenarioId VARCHAR(32) NOT NULL UNIQUE)";
+  execQuery(sql);
+  sql = "INSERT INTO ScenarioKeys (ScenarioId) VALUES ('" + scenId + "')";
+  execQuery(sql);
+  sql = "SELECT ScenarioKey FROM ScenarioKeys WHERE ScenarioId = '" + scenId + "'";
+  execQuery(sql);
+  const bool found = query.next();
+  assert(found);
+  scenKey = query.value(0).toInt();
+  return;
+}
+
+bool Model::migrateToCompact(DBConn & db, const vector<KTable*> & tabs) {
+  if (1 != dbSchemaVersion(db)) {
+    LOG(INFO) << "Model::migrateToCompact: not a version 1 database";
+    return false;
+  }
+  const bool sqliteP = (0 == db.driver().compare("QSQLITE"));
+  DBQuery qry(&db);
+  auto exec = [&qry](const string & sql) {
+    const bool ok = qry.exec(sql);
+    if (!ok) {
+      LOG(INFO) << "Failed Query: " << sql;
+      LOG(INFO) << qry.lastError();
+    }
+    qry.finish();
+    return ok;
+  };
+
+  db.transaction();
+  bool ok = exec(sqliteP
+                 ? "create table ScenarioKeys (ScenarioKey INTEGER PRIMARY KEY, ScenarioId VARCHAR(32) NOT NULL UNIQUE)"
+                 : "create table ScenarioKeys (ScenarioKey SERIAL PRIMARY KEY, ScenarioId VARCHAR(32) NOT NULL UNIQUE)");
+  if (ok) {
+    ok = exec("INSERT INTO ScenarioKeys (ScenarioId) SELECT ScenarioId FROM ScenarioDesc ORDER BY ScenarioId");
+  }
+
+  for (unsigned int n = 0; ok && (n < tabs.size()); n++) {
+    const KTable * t = tabs[n];
+    const string name = sqlTableName(t->tabSQL);
+    const auto kPtr = compactKeys().find(name);
+    if (compactKeys().end() == kPtr) {
+      continue; // e.g. ScenarioDesc, which keeps its layout
+    }
+    const bool oldP = db.hasTable(name);
+    if (oldP) {
+      // scenarios whose information tables were not logged are only found here
+      ok = exec("INSERT INTO ScenarioKeys (ScenarioId) SELECT DISTINCT ScenarioId FROM " + name +
+                " WHERE ScenarioId NOT IN (SELECT ScenarioId FROM ScenarioKeys)");
+      ok = ok && exec("ALTER TABLE " + name + " RENAME TO " + name + "_v1");
+    }
+    for (auto s : compactSQL(t, sqliteP)) {
+      ok = ok && exec(s);
+    }
+    if (ok && oldP) {
+      string cols = "";
+      for (auto c : sqlColumnNames(t->tabSQL)) {
+        cols += ", " + c;
+      }
+      // copy in key order, so the clustered tables are built by appending.
+      // Version 1 logged some rows more than once, which a primary key refuses.
+      const string distinct = std::get<1>(kPtr->second) ? "DISTINCT " : "";
+      ok = exec("INSERT INTO " + name + "Data (ScnKey" + cols + ") SELECT " + distinct + "K.ScenarioKey" + cols +
+                " FROM " + name + "_v1 O INNER JOIN ScenarioKeys K ON K.ScenarioId = O.ScenarioId" +
+                " ORDER BY K.ScenarioKey, " + std::get<0>(kPtr->second));
+      ok = ok && exec("DROP TABLE " + name + "_v1");
+    }
+    for (auto s : compactIndexSQL(name)) {
+      ok = ok && exec(s);
+    }
+    if (ok) {
+      LOG(INFO) << "Migrated" << name;
+    }
+  }
+
+  if (ok) {
+    db.commit();
+  }
+  else {
+    db.rollback();
+  }
+  return ok;
+}
+
+string Model::sqlTab(const string & tabName) const {
+  if ((2 == schemaVersion) && (compactKeys().end() != compactKeys().find(tabName))) {
+    return tabName + "Data";
+  }
+  return tabName;
+}
+
+string Model::sqlScenCol() const {
+  return (2 == schemaVersion) ? "ScnKey" : "ScenarioId";
+}
+
+string Model::sqlScenVal() const {
+  return (2 == schemaVersion) ? std::to_string(scenKey) : ("'" + scenId + "'");
+}
+
 void Model::loginCredentials(string connString) {
   enum class userParams {
     Driver,
@@ -987,29 +1477,29 @@ void Model::loginCredentials(string connString) {
 
     switch (mapStringToUserParams[key]) {
     case userParams::Driver:
-      dbDriver = QString::fromStdString(value);
+      dbDriver = value;
       break;
     case userParams::Server:
-      server = QString::fromStdString(value);
+      server = value;
       break;
     case userParams::Port:
       port = std::stoi(value);
       break;
     case userParams::Database:
-      databaseName = QString::fromStdString(value);
+      databaseName = value;
       break;
     case userParams::Uid:
-      userName = QString::fromStdString(value);
+      userName = value;
       break;
     case userParams::Pwd:
-      password = QString::fromStdString(value);
+      password = value;
       break;
     default:
       LOG(INFO) << "Error in input credentials format.";
     }
   }
 
-  if (dbDriver.isEmpty() || databaseName.isEmpty()) {
+  if (dbDriver.empty() || databaseName.empty()) {
     LOG(INFO) << "Error! Database type or database name can not be left blank.";
     assert(false);
   }
@@ -1022,7 +1512,7 @@ void Model::loginCredentials(string connString) {
 
   // for a non-sqlite db
   if (!dbDriver.compare("QPSQL")) {
-    if (server.isEmpty()) {
+    if (server.empty()) {
       LOG(INFO) << "Error! Please provide address for postgres server";
       assert(false);
     }
@@ -42,6 +42,10 @@ using KBase::KMatrix;
 Position::Position() {}
 Position::~Position() {}
 
+uint64_t Position::fingerprint(double) const {
+  throw KException("Position::fingerprint: not provided for this kind of position");
+}
+
 
 
 // --------------------------------------------
@@ -50,6 +54,14 @@ VctrPstn::VctrPstn(unsigned int nr, unsigned int nc) : Position(), KMatrix(nr, n
 VctrPstn::VctrPstn(const KMatrix & m) : KMatrix(m) {} // copy constructor
 VctrPstn::~VctrPstn() {}
 
+uint64_t VctrPstn::fingerprint(double quantum) const {
+  uint64_t fp = hashCombine(numR(), numC());
+  for (auto v : vals) {
+    fp = hashCombine(fp, quantHash(v, quantum));
+  }
+  return fp;
+}
+
 void VctrPstn::print(ostream& os) const {  
   // better formatting is available through KMatrix::printf
   os << "[VectrPstn ";
@@ -68,6 +80,15 @@ MtchPstn::MtchPstn() : Position()  {
 
 MtchPstn::~MtchPstn() {}
 
+uint64_t MtchPstn::fingerprint(double) const {
+  // the match is discrete, so there is nothing to quantize
+  uint64_t fp = hashCombine(numItm, numCat);
+  for (auto m : match) {
+    fp = hashCombine(fp, m);
+  }
+  return fp;
+}
+
 void MtchPstn::print(ostream& os) const {
   assert(numItm == match.size());
   os << "[MtchPstn ";
@@ -114,8 +114,18 @@ unsigned int State::myTurn() const {
   return t;
 }
 
+uint64_t State::fingerprint(double quantum) const {
+  uint64_t fp = hashCombine(0, pstns.size());
+  for (auto p : pstns) {
+    assert(nullptr != p);
+    fp = hashCombine(fp, p->fingerprint(quantum));
+  }
+  return fp;
+}
+
 void State::setUENdx() {
   /// Looking only at the positions in this state, return a vector of indices of unique positions.
+  ScopedTimer tmr("State::setUENdx");
   assert(0 == uIndices.size());
   assert(0 == eIndices.size());
   // Note that we have to lambda-bind 'this'. Otherwise, we'd need a 'static' function
@@ -146,6 +156,7 @@ void State::setAUtil(int perspH, ReportingLevel rl) {
   // we want to make sure that data is calculated at most once.
   // This is necessary because some utilities are very expensive to calculate,
   // it is easiest to be precise all the time.
+  ScopedTimer tmr("State::setAUtil");
 
   if (-1 == perspH) { // calculate them all at once
     assert(0 == aUtil.size());
@@ -357,6 +357,7 @@ int main(int ac, char **av) {
     LOG(INFO) << "-----------------------------------";
     Model::demoSQLite();
     MDemo::demoDBObject();
+    MDemo::demoDBQuery();
   }
 
   if (tx2P) {
@@ -26,6 +26,7 @@
 
 
 #include "demoleon.h"
+#include <thread>
 
 
 using KBase::PRNG;
@@ -1338,55 +1339,65 @@ KMatrix LeonModel::xprtDemand(const KMatrix & tau) const {
   return x1;
 }
 
-KMatrix LeonModel::randomFTax(PRNG* rng) {
-  using KBase::dot;
-  KMatrix ftax = KMatrix(N, 1);
+KMatrix LeonModel::randomFTax(PRNG* rng) const {
+  // Export demand of each sector depends only on its own tax, so revenue
+  // splits into the taxed and the subsidized sectors. Draw taxes and subsidies
+  // within their limits, then shrink whichever side is larger until they balance.
+  // Shrinking stays within the limits, so the result is feasible directly:
+  // only the rare draw which is all taxes or all subsidies must be redrawn.
+  // revenue of s*tax, as dot(s*tax, xprtDemand(s*tax)) without the temporaries
+  auto revenue = [this](const KMatrix & tax, double s) {
+    double r = 0.0;
+    for (unsigned int i = 0; i < N; i++) {
+      const double ti = s * tax(i, 0);
+      r = r + ti * pow(1.0 / (1.0 + ti), eps(i, 0)) * x0(i, 0);
+    }
+    return r;
+  };
 
-  auto makeRand = [this, rng]() {
-    auto tax = KMatrix(N, 1);
+  KMatrix ftax = KMatrix(N, 1);
+  bool retry = true;
+  while (retry) {
+    auto tPos = KMatrix(N, 1);
+    auto tNeg = KMatrix(N, 1);
     for (unsigned int i = 0; i < N; i++) {
       double ti = rng->uniform(-1, +1);
       if (ti < 0) {
-        ti = ti*maxSub;
+        tNeg(i, 0) = ti*maxSub;
       }
       if (0 < ti) {
-        ti = ti*maxTax;
+        tPos(i, 0) = ti*maxTax;
       }
-      tax(i, 0) = ti;
     }
-    return tax;
-  };
-
-  auto clip = [this](const KMatrix & tm1) {
-    auto tm2 = tm1;
-    for (unsigned int i = 0; i < tm1.numR(); i++) {
-      for (unsigned int j = 0; j < tm1.numC(); j++) {
-        double t = tm1(i, j);
-        t = (t < -maxSub) ? -maxSub : t;
-        t = (maxTax < t) ? maxTax : t;
-        tm2(i, j) = t;
+    const double rPos = revenue(tPos, 1.0);
+    const double rNeg = revenue(tNeg, 1.0);
+    retry = (rPos <= 0.0) || (0.0 <= rNeg);
+    if (retry) {
+      continue;
+    }
+
+    const bool shrinkPos = (-rNeg < rPos);
+    const KMatrix & big = shrinkPos ? tPos : tNeg;
+    const KMatrix & small = shrinkPos ? tNeg : tPos;
+    const double rSmall = shrinkPos ? rNeg : rPos;
+
+    // revenue(s*big) + rSmall changes sign on [0,1], so bisect on s
+    double s0 = 0.0;
+    double s1 = 1.0;
+    const unsigned int iterMax = 60;
+    for (unsigned int iter = 0; iter < iterMax; iter++) {
+      const double sm = (s0 + s1) / 2;
+      const double rm = revenue(big, sm) + rSmall;
+      const bool pastP = shrinkPos ? (0.0 < rm) : (rm < 0.0);
+      if (pastP) {
+        s1 = sm;
+      }
+      else {
+        s0 = sm;
       }
     }
-    return tm2;
-  };
-
-  bool retry = true;
-  while (retry) {
-    retry = false;
-    try {
-      auto t1 = makeRand();
-      // now tax is a bunch of random numbers, within [-maxSub, +maxTax] limits.
-      // first, adjust to revenue neutrality assuming no demand-effects,
-      // then, clip that back within allowable limits (esp make sure -1 < ti)
-      auto t2 = clip(KBase::makePerp(t1, x0));
-      // of course, that might ruin the revenu-neutrality, so repeat:
-      auto t3 = clip(KBase::makePerp(t2, x0));
-      // finally, adjust that including demand effects:
-      ftax = makeFTax(t3);
-    }
-    catch (KBase::KException&) {
-      retry = true;
-    }
+    ftax = (((s0 + s1) / 2) * big) + small;
+    retry = !(infsDegree(ftax) < TolIFD / 10);
   }
   return ftax;
 }
@@ -1493,46 +1504,61 @@ double LeonModel::infsDegree(const KMatrix & tax) const {
 // Return row-vector of expected factor shares (e.g. L of them, e.g. labor), then expected sector shares (N of them).
 // As they are estimated by different economic models, sum of factor VA will usually NOT match sum of sector VA
 KMatrix  LeonModel::vaShares(const KMatrix & tax, bool normalizeSharesP) const {
+  assert(1 == tax.numC());
+  return vaSharesBatch(tax, normalizeSharesP); //  [factor | sector]  as promised
+}
 
-  using KBase::sum;
-
-  auto xt = xprtDemand(tax);
 
-  assert(infsDegree(tax) < TolIFD); // make sure it is a feasible tax
+KMatrix LeonModel::vaSharesBatch(const KMatrix & taxes, bool normalizeSharesP) const {
+  using KBase::vSlice;
 
-  auto qA = aL * xt; // N-by-1 column vector
-  auto budgetL = rho * qA;
+  const unsigned int numT = taxes.numC();
+  assert(N == taxes.numR());
 
-  auto qB = bL * xt; // N-by-1 column vector
-  auto budgetS = KMatrix(1, N);
-  for (unsigned int j = 0; j < N; j++) {
-    double vs = qB(j, 0) * vas(0, j);
-    budgetS(0, j) = vs;
+  // column k is the export demand under the k-th tax
+  auto xt = KMatrix(N, numT);
+  for (unsigned int k = 0; k < numT; k++) {
+    const auto tk = vSlice(taxes, k);
+    assert(infsDegree(tk) < TolIFD); // make sure it is a feasible tax
+    const auto xk = xprtDemand(tk);
+    for (unsigned int i = 0; i < N; i++) {
+      xt(i, k) = xk(i, 0);
+    }
   }
 
-  // note that the sums of factor and of sector VA's will
-  // NOT be equal, as they are assessed by different models.
-  auto fShares = KMatrix(1, L);
-  auto sShares = KMatrix(1, N);
-
-  for (unsigned int j = 0; j < L; j++) {
-    double s = budgetL(j, 0);
-    assert(0 < s);
-    fShares(0, j) = s;
-  }
-  for (unsigned int j = 0; j < N; j++) {
-    double s = budgetS(0, j);
-    assert(0 < s);
-    sShares(0, j) = s;
-  }
+  auto qA = aL * xt; // N-by-numT
+  auto budgetL = rho * qA; // L-by-numT
 
-  if (normalizeSharesP) {
-    fShares = fShares / sum(fShares);
-    sShares = sShares / sum(sShares);
+  auto qB = bL * xt; // N-by-numT
 
+  // note that the sums of factor and of sector VA's will
+  // NOT be equal, as they are assessed by different models.
+  auto shares = KMatrix(numT, L + N);
+  for (unsigned int k = 0; k < numT; k++) {
+    double fSum = 0.0;
+    for (unsigned int j = 0; j < L; j++) {
+      double s = budgetL(j, k);
+      assert(0 < s);
+      shares(k, j) = s;
+      fSum = fSum + s;
+    }
+    double sSum = 0.0;
+    for (unsigned int j = 0; j < N; j++) {
+      double s = qB(j, k) * vas(0, j);
+      assert(0 < s);
+      shares(k, L + j) = s;
+      sSum = sSum + s;
+    }
+    if (normalizeSharesP) {
+      for (unsigned int j = 0; j < L; j++) {
+        shares(k, j) = shares(k, j) / fSum;
+      }
+      for (unsigned int j = 0; j < N; j++) {
+        shares(k, L + j) = shares(k, L + j) / sSum;
+      }
+    }
   }
-
-  return KBase::joinH(fShares, sShares); //  [factor | sector]  as promised
+  return shares; //  [factor | sector]
 }
 
 
@@ -1543,6 +1569,7 @@ KMatrix LeonModel::monteCarloShares(unsigned int nRuns, PRNG* rng) {
   const bool normP = false;
   assert((0 <= maxSub) && (maxSub < 1));
   assert(0 <= maxTax);
+  assert(0 < nRuns);
 
   auto runs = KMatrix(nRuns, L + N);
   auto tau = KMatrix(N, 1); // zero taxes
@@ -1551,31 +1578,52 @@ KMatrix LeonModel::monteCarloShares(unsigned int nRuns, PRNG* rng) {
     runs(0, j) = shr(0, j);
   }
 
-  for (unsigned int i = 1; i < nRuns; i++) {
-    tau = randomFTax(rng); // this occaisonally takes a long time
-    tau = makeFTax(tau);
-    double ifd = infsDegree(tau);
-    assert(ifd < TolIFD);
-    shr = vaShares(tau, normP);
+  const unsigned int numBlocks = (nRuns - 1 + mcBlockSize - 1) / mcBlockSize;
+  vector<uint64_t> seeds = {};
+  for (unsigned int b = 0; b < numBlocks; b++) {
+    seeds.push_back(rng->uniform());
+  }
 
-    for (unsigned int j = 0; j < L + N; j++) {
-      runs(i, j) = shr(0, j);
+  // runs 1 + b*mcBlockSize, ... are drawn by the b-th PRNG, and their shares
+  // come from one product of each Leontief inverse with all their demands
+  auto doBlock = [this, &runs, &seeds, nRuns, normP](unsigned int b) {
+    PRNG bRng = PRNG(seeds[b]);
+    const unsigned int i0 = 1 + b*mcBlockSize;
+    const unsigned int i1 = (nRuns < i0 + mcBlockSize) ? nRuns : i0 + mcBlockSize;
+    auto taus = KMatrix(N, i1 - i0);
+    for (unsigned int i = i0; i < i1; i++) {
+      const auto ti = randomFTax(&bRng);
+      for (unsigned int k = 0; k < N; k++) {
+        taus(k, i - i0) = ti(k, 0);
+      }
     }
-
-    if (KBase::ReportingLevel::Medium <= rl) {
-      LOG(INFO) <<"MC tax policy %4u:" << i;
-      tau.mPrintf(" %+.4f ");
-      LOG(INFO) <<"MC shares %4u:" << i;
-      shr.mPrintf(" %+.4f ");
+    const auto bShr = vaSharesBatch(taus, normP);
+    for (unsigned int i = i0; i < i1; i++) {
       for (unsigned int j = 0; j < L + N; j++) {
-        if (L <= j) {
-          // as they are in [factor |sector] order,
-          // we have L factors to skip then N sectors to show
-          LOG(INFO) << KBase::getFormattedString("for MC tax policy %4u, actor %2u taxed %+.4f has share %+.4f",
-                 i, j, tau(j - L, 0), shr(0, j));
-        }
+        runs(i, j) = bShr(i - i0, j);
       }
     }
+    return;
+  };
+
+  unsigned int numPar = std::thread::hardware_concurrency();
+  numPar = (0 == numPar) ? 4 : numPar;
+  numPar = (numBlocks < numPar) ? numBlocks : numPar;
+  auto worker = [&doBlock, numBlocks, numPar](unsigned int w) {
+    for (unsigned int b = w; b < numBlocks; b += numPar) {
+      doBlock(b);
+    }
+    return;
+  };
+  if (0 < numBlocks) {
+    KBase::groupThreads(worker, 0, numPar - 1, numPar);
+  }
+
+  if (KBase::ReportingLevel::Medium <= rl) {
+    for (unsigned int i = 1; i < nRuns; i++) {
+      LOG(INFO) <<"MC shares %4u:" << i;
+      hSlice(runs, i).mPrintf(" %+.4f ");
+    }
   }
 
   return runs;
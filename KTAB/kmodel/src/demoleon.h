@@ -206,7 +206,7 @@ public:
   KMatrix xprtDemand(const KBase::KMatrix& tau) const;
 
   // make a revenue-neutral but otherwise random tax vector
-  KMatrix randomFTax(PRNG* rng);
+  KMatrix randomFTax(PRNG* rng) const;
 
   // Given an arbitrary tax/subsidy vector, search for the nearest which is revenue-neutral.
   // It may flip the signs of some components. It may throw KException, so be prepared.
@@ -218,7 +218,14 @@ public:
   // As they are estimated by different economic models, sum of factor VA will usually NOT match sum of sector VA
   KMatrix vaShares(const KMatrix & tax, bool normalizeSharesP) const;
 
+  // As vaShares, for each column of feasible taxes at once, returning one row per column
+  KMatrix vaSharesBatch(const KMatrix & taxes, bool normalizeSharesP) const;
+
+  // Draw nRuns-1 random feasible taxes, in parallel, after the zero tax of row 0.
+  // Each block of mcBlockSize runs uses its own PRNG, seeded in turn from rng,
+  // so the sample does not depend on how many threads share the blocks.
   KMatrix monteCarloShares(unsigned int nRuns, KBase::PRNG* rng);
+  static const unsigned int mcBlockSize = 256;
 
   // considering all the positions as vectors, return the distance between states.
   static double stateDist (const LeonState* s1 , const LeonState* s2 );
@@ -23,6 +23,7 @@
 
 #include "sqlitedemo.h"
 #include "kmodel.h"
+#include "kdb.h"
 #include <easylogging++.h>
 
 using std::string;
@@ -150,6 +151,93 @@ void demoDBObject()
   return;
 }
 
+// Re-execute one prepared INSERT with new bindings each time, positional
+// and named, as the model's SQL logging does, and check what comes back.
+void demoDBQuery()
+{
+  using KBase::DBConn;
+  using KBase::DBQuery;
+  using KBase::KException;
+  LOG(INFO) << "Demo DBQuery round trip";
+
+  std::unique_ptr<DBConn> conn(DBConn::create("QSQLITE"));
+  if (!conn->open(":memory:"))
+  {
+    throw KException("demoDBQuery: " + conn->lastError());
+  }
+  auto q = DBQuery(conn.get());
+  if (!q.exec("CREATE TABLE T (a INTEGER, b REAL, c TEXT)"))
+  {
+    throw KException("demoDBQuery: " + q.lastError());
+  }
+
+  const unsigned int numRows = 4;
+  q.prepare("INSERT INTO T (a,b,c) VALUES (?, ?, ?)");
+  for (unsigned int i = 0; i < numRows; i++)
+  {
+    q.bindValue(0, i);
+    q.bindValue(1, 0.5 * i);
+    q.bindValue(2, "row " + std::to_string(i));
+    if (!q.exec())
+    {
+      throw KException("demoDBQuery: positional insert failed: " + q.lastError());
+    }
+  }
+  q.prepare("INSERT INTO T (a,b,c) VALUES (:a, :b, :c)");
+  for (unsigned int i = numRows; i < 2 * numRows; i++)
+  {
+    q.bindValue(":a", i);
+    q.bindValue(":b", 0.5 * i);
+    q.bindValue(":c", "row " + std::to_string(i));
+    if (!q.exec())
+    {
+      throw KException("demoDBQuery: named insert failed: " + q.lastError());
+    }
+  }
+
+  q.prepare("SELECT a, b, c FROM T ORDER BY a");
+  q.exec();
+  unsigned int n = 0;
+  while (q.next())
+  {
+    const bool same = (n == q.value(0).toInt()) && (0.5 * n == q.value(1).toDouble()) &&
+                      ("row " + std::to_string(n) == q.value(2).toString());
+    if (!same)
+    {
+      throw KException("demoDBQuery: row " + std::to_string(n) + " came back as "
+                       + q.value(0).toString() + ", " + q.value(1).toString() + ", " + q.value(2).toString());
+    }
+    n++;
+  }
+  if (2 * numRows != n)
+  {
+    throw KException("demoDBQuery: expected " + std::to_string(2 * numRows)
+                     + " rows, found " + std::to_string(n));
+  }
+  LOG(INFO) << "Read back" << n << "rows, as written";
+
+  // a binding which cannot succeed must fail the exec, not vanish
+  q.prepare("INSERT INTO T (a,b,c) VALUES (?, ?, ?)");
+  q.bindValue(7, 0);
+  if (q.exec())
+  {
+    throw KException("demoDBQuery: out of range binding was not reported");
+  }
+  LOG(INFO) << "Bad binding reported as:" << q.lastError();
+
+  // rows as PostgreSQL's COPY will read them, whatever the strings hold
+  const vector<KBase::DBValue> cpRow = { 3, 0.25, KBase::DBValue(),
+                                         "tab\there, line\nbreak\r, back\\slash \\N" };
+  string cpText = "";
+  KBase::copyTextRow(cpText, &cpRow[0], cpRow.size());
+  const string cpWant = "3\t0.25\t\\N\ttab\\there, line\\nbreak\\r, back\\\\slash \\\\N\n";
+  if (cpWant != cpText)
+  {
+    throw KException("demoDBQuery: COPY text row came out as " + cpText);
+  }
+  LOG(INFO) << "COPY text row escaped as expected";
+  return;
+}
 
 } // end of namespace
 
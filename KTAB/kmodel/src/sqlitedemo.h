@@ -43,6 +43,7 @@ using std::vector;
 
 
 void demoDBObject();
+void demoDBQuery();
 
 class SQLDB {
 public:
@@ -0,0 +1,100 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom 
+// the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// -------------------------------------------------
+// Small vectors whose dimension is fixed at compile time, for the
+// low-dimensional hot paths (most SMP scenarios have 1 to 5 dimensions).
+// Storage is on the stack and every loop has a constant trip count,
+// so the compiler unrolls them. Callers switch on the runtime dimension
+// and keep a KMatrix path for anything above maxFixDim.
+// -------------------------------------------------
+#ifndef KBASE_FIXVEC_H
+#define KBASE_FIXVEC_H
+
+namespace KBase {
+
+const unsigned int maxFixDim = 5;
+
+template <unsigned int N>
+class FixVec {
+public:
+  static_assert(0 < N, "FixVec needs at least one dimension");
+  static constexpr unsigned int dim() { return N; }
+
+  FixVec() {
+    for (unsigned int k = 0; k < N; k++) {
+      v[k] = 0.0;
+    }
+  }
+
+  // copy N contiguous values, e.g. one row of an actors-by-dims block
+  explicit FixVec(const double * p) {
+    for (unsigned int k = 0; k < N; k++) {
+      v[k] = p[k];
+    }
+  }
+
+  double & operator[](unsigned int k) { return v[k]; }
+  const double & operator[](unsigned int k) const { return v[k]; }
+
+  void copyTo(double * p) const {
+    for (unsigned int k = 0; k < N; k++) {
+      p[k] = v[k];
+    }
+  }
+
+  // this = this + a*x, component by component
+  void addScaled(double a, const double * x) {
+    for (unsigned int k = 0; k < N; k++) {
+      v[k] = v[k] + (a * x[k]);
+    }
+  }
+
+  // sum of squares, accumulated in order of k
+  double sqrNorm() const {
+    double s = 0;
+    for (unsigned int k = 0; k < N; k++) {
+      s = s + (v[k] * v[k]);
+    }
+    return s;
+  }
+
+  // sum of ((this - p) * w)^2, accumulated in order of k
+  double wDiffSqr(const double * p, const FixVec<N> & w) const {
+    double s = 0;
+    for (unsigned int k = 0; k < N; k++) {
+      const double dk = (v[k] - p[k]) * w.v[k];
+      s = s + (dk * dk);
+    }
+    return s;
+  }
+
+private:
+  double v[N];
+};
+
+} // end of namespace
+
+#endif // KBASE_FIXVEC_H
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
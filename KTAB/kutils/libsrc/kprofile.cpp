@@ -0,0 +1,140 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom 
+// the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+
+#include "kprofile.h"
+#include "kutils.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace KBase {
+
+std::atomic<bool> Profiler::enabled(false);
+
+namespace {
+
+struct ThreadTally;
+
+// Both are function-local statics so that they are constructed before, and
+// hence destroyed after, the thread_local tally of the main thread.
+std::mutex & registryLock() {
+  static std::mutex m;
+  return m;
+}
+
+struct Registry {
+  vector<ThreadTally*> live = {};
+  PhaseTable retired = {}; // tallies of threads which have exited
+};
+
+Registry & registry() {
+  static Registry r;
+  return r;
+}
+
+void mergeInto(PhaseTable & pt, const std::unordered_map<const char*, PhaseStats> & ps) {
+  for (const auto & kv : ps) {
+    auto & s = pt[string(kv.first)];
+    s.calls = s.calls + kv.second.calls;
+    s.seconds = s.seconds + kv.second.seconds;
+  }
+  return;
+}
+
+struct ThreadTally {
+  // only this thread writes, but collect() may read from another
+  std::mutex lock;
+  std::unordered_map<const char*, PhaseStats> phases = {};
+
+  ThreadTally() {
+    std::lock_guard<std::mutex> g(registryLock());
+    registry().live.push_back(this);
+  }
+
+  ~ThreadTally() {
+    // groupThreads spawns short-lived threads, so fold their tallies
+    // into the retired table rather than losing them
+    std::lock_guard<std::mutex> g(registryLock());
+    auto & r = registry();
+    mergeInto(r.retired, phases);
+    r.live.erase(std::remove(r.live.begin(), r.live.end(), this), r.live.end());
+  }
+};
+
+ThreadTally & myTally() {
+  static thread_local ThreadTally tt;
+  return tt;
+}
+
+} // end of anonymous namespace
+
+void Profiler::enable(bool on) {
+  enabled.store(on);
+}
+
+void Profiler::add(const char* phase, double secs, uint64_t n) {
+  auto & tt = myTally();
+  std::lock_guard<std::mutex> g(tt.lock);
+  auto & ps = tt.phases[phase];
+  ps.calls = ps.calls + n;
+  ps.seconds = ps.seconds + secs;
+  return;
+}
+
+PhaseTable Profiler::collect(bool reset) {
+  std::lock_guard<std::mutex> g(registryLock());
+  auto & r = registry();
+  PhaseTable pt = r.retired;
+  for (auto tt : r.live) {
+    std::lock_guard<std::mutex> gt(tt->lock);
+    mergeInto(pt, tt->phases);
+    if (reset) {
+      tt->phases.clear();
+    }
+  }
+  if (reset) {
+    r.retired.clear();
+  }
+  return pt;
+}
+
+string Profiler::toJSON(const PhaseTable & pt) {
+  string js = "{";
+  bool first = true;
+  for (const auto & kv : pt) {
+    js = js + (first ? "" : ", ")
+         + getFormattedString("\"%s\": {\"calls\": %llu, \"seconds\": %.6f}",
+                              kv.first.c_str(),
+                              (unsigned long long)(kv.second.calls),
+                              kv.second.seconds);
+    first = false;
+  }
+  js = js + "}";
+  return js;
+}
+
+} // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,108 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom 
+// the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// A very light profiler: named phases accumulate wall-clock time and call counts.
+// Each thread tallies into its own table, so timers in worker threads do not
+// contend with each other; Profiler::collect merges them all.
+// When the profiler is disabled, a ScopedTimer costs one relaxed atomic load.
+// -------------------------------------------------
+#ifndef KBASE_PROFILE_H
+#define KBASE_PROFILE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace KBase {
+using std::string;
+using std::vector;
+
+struct PhaseStats {
+  uint64_t calls = 0;
+  double seconds = 0.0; // summed over threads, so it can exceed wall-clock time
+};
+
+// phase name -> totals
+using PhaseTable = std::map<string, PhaseStats>;
+
+class Profiler {
+public:
+  static void enable(bool on = true);
+  static bool isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  // Add to the calling thread's tally. Phase names are expected to be
+  // string literals (or otherwise outlive the profiler).
+  static void add(const char* phase, double secs, uint64_t n = 1);
+
+  // just count, e.g. the number of cache hits
+  static void count(const char* phase, uint64_t n = 1) {
+    if (isEnabled()) {
+      add(phase, 0.0, n);
+    }
+  }
+
+  // Merge the tallies of all threads, live and finished.
+  // If reset, everything is zeroed so the next collect starts afresh.
+  static PhaseTable collect(bool reset = true);
+
+  // JSON object of the form {"phase": {"calls": n, "seconds": s}, ...}
+  static string toJSON(const PhaseTable & pt);
+
+private:
+  static std::atomic<bool> enabled;
+};
+
+// RAII timer: from construction to destruction is charged to the phase.
+class ScopedTimer {
+public:
+  explicit ScopedTimer(const char* phase) : name(phase), on(Profiler::isEnabled()) {
+    if (on) {
+      t0 = std::chrono::steady_clock::now();
+    }
+  }
+  ~ScopedTimer() {
+    if (on) {
+      std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+      Profiler::add(name, dt.count());
+    }
+  }
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+  const char* name;
+  const bool on;
+  std::chrono::steady_clock::time_point t0;
+};
+
+} // end of namespace
+
+// -------------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,94 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom 
+// the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// -------------------------------------------------
+// A bounded, lock-free queue for exactly one producer thread and one
+// consumer thread, e.g. a model run handing per-turn results to a GUI.
+// Each index is written by only one side, so a pair of atomics with
+// acquire/release ordering is all the synchronization needed.
+// -------------------------------------------------
+#ifndef KBASE_QUEUE_H
+#define KBASE_QUEUE_H
+
+#include <atomic>
+#include <cassert>
+#include <vector>
+
+namespace KBase {
+
+template <typename T>
+class SPSCQueue {
+public:
+  // holds at most cap items at once
+  explicit SPSCQueue(unsigned int cap) : slots(cap + 1), head(0), tail(0) {
+    assert(0 < cap);
+  }
+
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue & operator=(const SPSCQueue &) = delete;
+
+  unsigned int capacity() const { return slots.size() - 1; }
+
+  // producer side: false, leaving x untouched, if the queue is full
+  bool push(T & x) {
+    const unsigned int t = tail.load(std::memory_order_relaxed);
+    const unsigned int t1 = next(t);
+    if (t1 == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots[t] = std::move(x);
+    tail.store(t1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side: false if the queue is empty
+  bool pop(T & x) {
+    const unsigned int h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    x = std::move(slots[h]);
+    head.store(next(h), std::memory_order_release);
+    return true;
+  }
+
+  // only a hint while the other side is active
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+private:
+  unsigned int next(unsigned int n) const {
+    return (n + 1 == slots.size()) ? 0 : n + 1;
+  }
+
+  std::vector<T> slots;
+  std::atomic<unsigned int> head; // next item to pop, owned by the consumer
+  std::atomic<unsigned int> tail; // next free slot, owned by the producer
+};
+
+} // end of namespace
+
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,217 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom 
+// the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+
+#include <algorithm>
+#include <math.h>
+
+#include "ksparse.h"
+
+namespace KBase {
+
+KSparse::KSparse() {}
+
+KSparse::KSparse(unsigned int nr, unsigned int nc) {
+    rows = nr;
+    clms = nc;
+    rowStart = vector<unsigned int>(nr + 1, 0);
+}
+
+
+KSparse KSparse::fromTriplets(unsigned int nr, unsigned int nc, const vector<Triplet> & ts) {
+    using std::get;
+    auto a = KSparse(nr, nc);
+
+    // counting sort by row, then sort each row by column
+    for (const auto & t : ts) {
+        if ((nr <= get<0>(t)) || (nc <= get<1>(t))) {
+            throw KException("KSparse::fromTriplets: index out of range");
+        }
+        a.rowStart[get<0>(t) + 1]++;
+    }
+    for (unsigned int i = 0; i < nr; i++) {
+        a.rowStart[i + 1] += a.rowStart[i];
+    }
+    auto next = vector<unsigned int>(a.rowStart.begin(), a.rowStart.end() - 1);
+    auto byRow = vector<std::pair<unsigned int, double>>(ts.size());
+    for (const auto & t : ts) {
+        byRow[next[get<0>(t)]++] = std::make_pair(get<1>(t), get<2>(t));
+    }
+
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < nr; i++) {
+        auto b = byRow.begin() + a.rowStart[i];
+        auto e = byRow.begin() + a.rowStart[i + 1];
+        std::stable_sort(b, e, [](const std::pair<unsigned int, double> & p1,
+                                  const std::pair<unsigned int, double> & p2) {
+            return p1.first < p2.first;
+        });
+        a.rowStart[i] = n;
+        for (auto p = b; p != e; ) {
+            const unsigned int j = p->first;
+            double v = 0.0;
+            for (; (p != e) && (p->first == j); p++) {
+                v = v + p->second;
+            }
+            if (0.0 != v) {
+                byRow[n++] = std::make_pair(j, v);
+            }
+        }
+    }
+    a.rowStart[nr] = n;
+
+    a.clmNdx.resize(n);
+    a.vals.resize(n);
+    for (unsigned int k = 0; k < n; k++) {
+        a.clmNdx[k] = byRow[k].first;
+        a.vals[k] = byRow[k].second;
+    }
+    return a;
+}
+
+
+KSparse KSparse::fromDense(const KMatrix & m, double tol) {
+    assert(0.0 <= tol);
+    auto a = KSparse(m.numR(), m.numC());
+    for (unsigned int i = 0; i < m.numR(); i++) {
+        for (unsigned int j = 0; j < m.numC(); j++) {
+            const double mij = m(i, j);
+            if (tol < fabs(mij)) {
+                a.clmNdx.push_back(j);
+                a.vals.push_back(mij);
+            }
+        }
+        a.rowStart[i + 1] = a.vals.size();
+    }
+    return a;
+}
+
+
+KMatrix KSparse::toDense() const {
+    auto m = KMatrix(rows, clms);
+    for (unsigned int i = 0; i < rows; i++) {
+        for (unsigned int k = rowStart[i]; k < rowStart[i + 1]; k++) {
+            m(i, clmNdx[k]) = vals[k];
+        }
+    }
+    return m;
+}
+
+
+vector<Triplet> KSparse::triplets() const {
+    auto ts = vector<Triplet>();
+    ts.reserve(vals.size());
+    for (unsigned int i = 0; i < rows; i++) {
+        for (unsigned int k = rowStart[i]; k < rowStart[i + 1]; k++) {
+            ts.push_back(Triplet(i, clmNdx[k], vals[k]));
+        }
+    }
+    return ts;
+}
+
+
+KMatrix KSparse::mult(const KMatrix & x) const {
+    assert(clms == x.numR());
+    const unsigned int nc = x.numC();
+    auto y = KMatrix(rows, nc);
+    for (unsigned int i = 0; i < rows; i++) {
+        for (unsigned int j = 0; j < nc; j++) {
+            double yij = 0.0;
+            for (unsigned int k = rowStart[i]; k < rowStart[i + 1]; k++) {
+                yij = yij + vals[k] * x(clmNdx[k], j);
+            }
+            y(i, j) = yij;
+        }
+    }
+    return y;
+}
+
+
+KMatrix KSparse::multT(const KMatrix & x) const {
+    assert(rows == x.numR());
+    const unsigned int nc = x.numC();
+    auto y = KMatrix(clms, nc);
+    // scatter each row of A into the entries of y it touches
+    for (unsigned int i = 0; i < rows; i++) {
+        for (unsigned int j = 0; j < nc; j++) {
+            const double xij = x(i, j);
+            if (0.0 == xij) {
+                continue;
+            }
+            for (unsigned int k = rowStart[i]; k < rowStart[i + 1]; k++) {
+                y(clmNdx[k], j) += vals[k] * xij;
+            }
+        }
+    }
+    return y;
+}
+
+
+KSparse KSparse::trans() const {
+    auto t = KSparse(clms, rows);
+    for (auto j : clmNdx) {
+        t.rowStart[j + 1]++;
+    }
+    for (unsigned int j = 0; j < clms; j++) {
+        t.rowStart[j + 1] += t.rowStart[j];
+    }
+    t.clmNdx.resize(vals.size());
+    t.vals.resize(vals.size());
+    // rows are visited in order, so each row of the transpose comes out sorted
+    auto next = vector<unsigned int>(t.rowStart.begin(), t.rowStart.end() - 1);
+    for (unsigned int i = 0; i < rows; i++) {
+        for (unsigned int k = rowStart[i]; k < rowStart[i + 1]; k++) {
+            const unsigned int n = next[clmNdx[k]]++;
+            t.clmNdx[n] = i;
+            t.vals[n] = vals[k];
+        }
+    }
+    return t;
+}
+
+
+KMatrix operator* (const KSparse & a, const KMatrix & x) {
+    return a.mult(x);
+}
+
+
+KSparse operator* (double s, const KSparse & a) {
+    if (0.0 == s) {
+        return KSparse(a.numR(), a.numC());
+    }
+    auto b = a;
+    for (auto & v : b.vals) {
+        v = s * v;
+    }
+    return b;
+}
+
+
+KSparse trans(const KSparse & a) {
+    return a.trans();
+}
+
+};
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,87 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom 
+// the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// -------------------------------------------------
+// A sparse matrix in compressed-sparse-row (CSR) form, for operators
+// which are overwhelmingly zero, like the block matrices of LP-derived
+// variational inequalities. The compressed-sparse-column form of A is
+// just the CSR form of trans(A). Products with dense KMatrix vectors
+// touch only the stored entries.
+// -------------------------------------------------
+#ifndef KBASE_SPARSE_H
+#define KBASE_SPARSE_H
+
+#include <tuple>
+#include <vector>
+
+#include "kmatrix.h"
+
+namespace KBase {
+using std::tuple;
+using std::vector;
+
+// (row, clm, value)
+typedef tuple<unsigned int, unsigned int, double> Triplet;
+
+class KSparse {
+    friend KSparse operator* (double s, const KSparse & a);
+public:
+    KSparse();
+    KSparse(unsigned int nr, unsigned int nc); // all zero
+
+    // Duplicate (row, clm) entries are summed, and exact zeros are dropped
+    static KSparse fromTriplets(unsigned int nr, unsigned int nc, const vector<Triplet> & ts);
+
+    // keeps only the entries with tol < |mij|
+    static KSparse fromDense(const KMatrix & m, double tol = 0.0);
+    KMatrix toDense() const;
+    vector<Triplet> triplets() const; // in row-major order
+
+    unsigned int numR() const { return rows; }
+    unsigned int numC() const { return clms; }
+    unsigned int nnz() const { return vals.size(); }
+
+    // A*x and trans(A)*x, for any number of columns in x
+    KMatrix mult(const KMatrix & x) const;
+    KMatrix multT(const KMatrix & x) const;
+
+    KSparse trans() const;
+
+protected:
+    unsigned int rows = 0;
+    unsigned int clms = 0;
+    vector<unsigned int> rowStart = vector<unsigned int>(1, 0); // rows+1 offsets into clmNdx and vals
+    vector<unsigned int> clmNdx = vector<unsigned int>();
+    vector<double> vals = vector<double>();
+};
+
+KMatrix operator* (const KSparse & a, const KMatrix & x);
+KSparse operator* (double s, const KSparse & a);
+KSparse trans(const KSparse & a);
+
+};
+
+// -------------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,173 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom 
+// the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+
+#include "kstream.h"
+#include "kutils.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace KBase {
+
+void RunningStat::add(double x) {
+  n++;
+  if (1 == n) {
+    lo = x;
+    hi = x;
+  }
+  else {
+    lo = (x < lo) ? x : lo;
+    hi = (x > hi) ? x : hi;
+  }
+  const double d = x - m1;
+  m1 = m1 + d / n;
+  m2 = m2 + d * (x - m1);
+  return;
+}
+
+double RunningStat::variance() const {
+  return (1 < n) ? m2 / (n - 1) : 0.0;
+}
+
+double RunningStat::stdDev() const {
+  return sqrt(variance());
+}
+
+// --------------------------------------------
+
+P2Quantile::P2Quantile(double p) {
+  if ((p <= 0.0) || (1.0 <= p)) {
+    throw KException("P2Quantile: probability must be strictly between 0 and 1");
+  }
+  pq = p;
+  const double d0[5] = { 0.0, 2 * p, 4 * p, 2 + 2 * p, 4.0 };
+  const double i0[5] = { 0.0, p / 2, p, (1 + p) / 2, 1.0 };
+  for (unsigned int i = 0; i < 5; i++) {
+    pos[i] = i;
+    dsr[i] = d0[i];
+    inc[i] = i0[i];
+  }
+}
+
+void P2Quantile::add(double x) {
+  if (n < 5) { // just collect the first five, in order
+    q[n] = x;
+    n++;
+    if (5 == n) {
+      std::sort(q, q + 5);
+    }
+    return;
+  }
+  n++;
+
+  // find the cell k with q[k] <= x < q[k+1], stretching the ends if needed
+  unsigned int k = 0;
+  if (x < q[0]) {
+    q[0] = x;
+    k = 0;
+  }
+  else if (q[4] <= x) {
+    q[4] = x;
+    k = 3;
+  }
+  else {
+    k = 0;
+    while (q[k + 1] <= x) {
+      k++;
+    }
+  }
+
+  for (unsigned int i = k + 1; i < 5; i++) {
+    pos[i] = pos[i] + 1;
+  }
+  for (unsigned int i = 0; i < 5; i++) {
+    dsr[i] = dsr[i] + inc[i];
+  }
+
+  // nudge the three middle markers toward their desired positions
+  for (unsigned int i = 1; i < 4; i++) {
+    const double d = dsr[i] - pos[i];
+    if (((1.0 <= d) && (1.0 < pos[i + 1] - pos[i])) ||
+        ((d <= -1.0) && (pos[i - 1] - pos[i] < -1.0))) {
+      const int s = (0.0 < d) ? 1 : -1;
+      double qi = parabolic(i, s);
+      if ((q[i - 1] < qi) && (qi < q[i + 1])) {
+        q[i] = qi;
+      }
+      else {
+        q[i] = linear(i, s);
+      }
+      pos[i] = pos[i] + s;
+    }
+  }
+  return;
+}
+
+double P2Quantile::parabolic(unsigned int i, double d) const {
+  const double a = (pos[i] - pos[i - 1] + d) * (q[i + 1] - q[i]) / (pos[i + 1] - pos[i]);
+  const double b = (pos[i + 1] - pos[i] - d) * (q[i] - q[i - 1]) / (pos[i] - pos[i - 1]);
+  return q[i] + d * (a + b) / (pos[i + 1] - pos[i - 1]);
+}
+
+double P2Quantile::linear(unsigned int i, int d) const {
+  const unsigned int j = i + d;
+  return q[i] + d * (q[j] - q[i]) / (pos[j] - pos[i]);
+}
+
+double P2Quantile::value() const {
+  if (0 == n) {
+    return 0.0;
+  }
+  if (n <= 5) { // exact, interpolating between order statistics
+    double v[5] = { 0, 0, 0, 0, 0 };
+    std::copy(q, q + n, v);
+    std::sort(v, v + n);
+    const double r = pq * (n - 1);
+    const unsigned int r0 = ((unsigned int)(floor(r)));
+    const unsigned int r1 = (r0 + 1 < n) ? r0 + 1 : r0;
+    return v[r0] + (r - r0) * (v[r1] - v[r0]);
+  }
+  return q[2];
+}
+
+// --------------------------------------------
+
+StreamSummary::StreamSummary(const vector<double> & probs) {
+  for (auto p : probs) {
+    qs.push_back(P2Quantile(p));
+  }
+}
+
+void StreamSummary::add(double x) {
+  rs.add(x);
+  for (auto & qk : qs) {
+    qk.add(x);
+  }
+  return;
+}
+
+} // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,104 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom 
+// the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// -------------------------------------------------
+// Streaming statistics: values are folded in one at a time and not kept,
+// so memory does not grow with the number of observations.
+// RunningStat uses Welford's update for the mean and variance;
+// P2Quantile is the P-square estimator of Jain and Chlamtac (1985),
+// which tracks one quantile with five markers.
+// -------------------------------------------------
+#ifndef KBASE_STREAM_H
+#define KBASE_STREAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace KBase {
+using std::string;
+using std::vector;
+
+class RunningStat {
+public:
+  void add(double x);
+
+  uint64_t count() const { return n; }
+  double mean() const { return m1; }
+  double variance() const; // sample variance, 0 until there are two values
+  double stdDev() const;
+  double min() const { return lo; }
+  double max() const { return hi; }
+
+private:
+  uint64_t n = 0;
+  double m1 = 0.0;
+  double m2 = 0.0;
+  double lo = 0.0;
+  double hi = 0.0;
+};
+
+class P2Quantile {
+public:
+  explicit P2Quantile(double p = 0.5);
+
+  void add(double x);
+
+  double prob() const { return pq; }
+  // current estimate; exact while there are five or fewer values
+  double value() const;
+
+private:
+  double pq = 0.5;
+  uint64_t n = 0;
+  double q[5] = { 0, 0, 0, 0, 0 };   // marker heights
+  double pos[5] = { 0, 0, 0, 0, 0 }; // actual marker positions
+  double dsr[5] = { 0, 0, 0, 0, 0 }; // desired marker positions
+  double inc[5] = { 0, 0, 0, 0, 0 }; // increments of the desired positions
+
+  double parabolic(unsigned int i, double d) const;
+  double linear(unsigned int i, int d) const;
+};
+
+// mean, spread, and a few quantiles of one stream
+class StreamSummary {
+public:
+  explicit StreamSummary(const vector<double> & probs = { 0.05, 0.50, 0.95 });
+
+  void add(double x);
+
+  const RunningStat & stat() const { return rs; }
+  unsigned int numQuantiles() const { return qs.size(); }
+  const P2Quantile & quantile(unsigned int k) const { return qs[k]; }
+
+private:
+  RunningStat rs = RunningStat();
+  vector<P2Quantile> qs = {};
+};
+
+} // end of namespace
+
+// -------------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
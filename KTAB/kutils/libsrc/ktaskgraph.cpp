@@ -0,0 +1,209 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom 
+// the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+
+#include "ktaskgraph.h"
+#include "kutils.h"
+#include <atomic>
+#include <cassert>
+#include <exception>
+
+namespace KBase {
+
+Executor::Executor(unsigned int numThreads) {
+  numThreads = (0 == numThreads) ? 1 : numThreads;
+  for (unsigned int n = 0; n < numThreads; n++) {
+    workers.push_back(std::thread([this]() {
+      while (true) {
+        function<void()> job = nullptr;
+        {
+          std::unique_lock<std::mutex> lk(qLock);
+          qCV.wait(lk, [this]() {
+            return stopping || (0 < jobs.size());
+          });
+          if (0 == jobs.size()) {
+            return; // stopping, and nothing left to do
+          }
+          job = jobs.front();
+          jobs.pop_front();
+        }
+        job();
+      }
+    }));
+  }
+}
+
+Executor::~Executor() {
+  {
+    std::lock_guard<std::mutex> lk(qLock);
+    stopping = true;
+  }
+  qCV.notify_all();
+  for (auto & w : workers) {
+    w.join();
+  }
+}
+
+Executor & Executor::shared() {
+  static Executor ex(std::thread::hardware_concurrency());
+  return ex;
+}
+
+void Executor::submit(function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lk(qLock);
+    jobs.push_back(job);
+  }
+  qCV.notify_one();
+  return;
+}
+
+// --------------------------------------------
+
+struct TaskGraph::Impl {
+  struct Task {
+    function<void()> fn = nullptr;
+    vector<TaskID> succs = {};
+    unsigned int numDeps = 0;
+    bool onCaller = false;
+  };
+  vector<Task> tasks = {};
+  vector<unsigned int> pending = {}; // unfinished predecessors
+  std::unique_ptr<std::atomic<bool>[]> claimed = nullptr;
+
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<TaskID> ready = {}; // for the caller, who may run any of them
+  unsigned int numDone = 0;
+  std::exception_ptr err = nullptr;
+
+  // Run task n unless someone else already has. Called by the pool and the caller.
+  static void tryRun(std::shared_ptr<Impl> g, TaskID n) {
+    if (g->claimed[n].exchange(true)) {
+      return;
+    }
+    try {
+      g->tasks[n].fn();
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lk(g->lock);
+      if (nullptr == g->err) {
+        g->err = std::current_exception();
+      }
+    }
+    std::lock_guard<std::mutex> lk(g->lock);
+    for (auto s : g->tasks[n].succs) {
+      assert(0 < g->pending[s]);
+      g->pending[s]--;
+      if (0 == g->pending[s]) {
+        makeReady(g, s);
+      }
+    }
+    g->numDone++;
+    g->cv.notify_all();
+    return;
+  }
+
+  // lock must be held
+  static void makeReady(std::shared_ptr<Impl> g, TaskID n) {
+    g->ready.push_back(n);
+    if (!g->tasks[n].onCaller) {
+      Executor::shared().submit([g, n]() {
+        tryRun(g, n);
+      });
+    }
+    return;
+  }
+};
+
+TaskGraph::TaskGraph() : impl(std::make_shared<Impl>()) {
+}
+
+TaskGraph::~TaskGraph() {
+}
+
+TaskGraph::TaskID TaskGraph::add(function<void()> fn, const vector<TaskID> & deps, bool onCaller) {
+  assert(nullptr != fn);
+  const TaskID n = impl->tasks.size();
+  auto t = Impl::Task();
+  t.fn = fn;
+  t.onCaller = onCaller;
+  for (auto d : deps) {
+    if (n <= d) {
+      throw KException("TaskGraph::add: dependency on a task not yet added");
+    }
+    impl->tasks[d].succs.push_back(n);
+    t.numDeps++;
+  }
+  impl->tasks.push_back(t);
+  return n;
+}
+
+unsigned int TaskGraph::size() const {
+  return impl->tasks.size();
+}
+
+void TaskGraph::run() {
+  auto g = impl;
+  const unsigned int n = g->tasks.size();
+  g->claimed.reset(new std::atomic<bool>[n]);
+  {
+    std::lock_guard<std::mutex> lk(g->lock);
+    g->pending = vector<unsigned int>(n);
+    for (unsigned int i = 0; i < n; i++) {
+      g->claimed[i] = false;
+      g->pending[i] = g->tasks[i].numDeps;
+    }
+    for (unsigned int i = 0; i < n; i++) {
+      if (0 == g->pending[i]) {
+        Impl::makeReady(g, i);
+      }
+    }
+  }
+
+  // help until everything is done
+  std::unique_lock<std::mutex> lk(g->lock);
+  while (g->numDone < n) {
+    if (0 < g->ready.size()) {
+      TaskID i = g->ready.front();
+      g->ready.pop_front();
+      lk.unlock();
+      Impl::tryRun(g, i);
+      lk.lock();
+    }
+    else {
+      g->cv.wait(lk);
+    }
+  }
+  lk.unlock();
+
+  if (nullptr != g->err) {
+    std::rethrow_exception(g->err);
+  }
+  return;
+}
+
+} // end of namespace
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
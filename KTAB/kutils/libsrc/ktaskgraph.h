@@ -0,0 +1,97 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom 
+// the Software is furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING 
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+// -------------------------------------------------
+// A small dependency-graph scheduler. Tasks are added with the tasks they
+// depend on, then run() executes each one as soon as all of its
+// predecessors are done, on the shared Executor's worker threads.
+// The thread calling run() works too rather than just waiting, so graphs
+// may be run from inside tasks without exhausting the pool.
+// Tasks marked onCaller (e.g. those using a database connection, which
+// belongs to one thread) only ever run on the thread which called run().
+// -------------------------------------------------
+#ifndef KBASE_TASKGRAPH_H
+#define KBASE_TASKGRAPH_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace KBase {
+using std::function;
+using std::vector;
+
+// A fixed pool of worker threads, shared by every TaskGraph,
+// so a run does not create threads of its own.
+class Executor {
+public:
+  explicit Executor(unsigned int numThreads);
+  ~Executor();
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  // one worker per core, started on first use
+  static Executor & shared();
+
+  void submit(function<void()> job);
+  unsigned int numThreads() const { return workers.size(); }
+
+private:
+  std::mutex qLock;
+  std::condition_variable qCV;
+  std::deque<function<void()>> jobs = {};
+  bool stopping = false;
+  vector<std::thread> workers = {};
+};
+
+class TaskGraph {
+public:
+  using TaskID = unsigned int;
+
+  TaskGraph();
+  ~TaskGraph();
+
+  // The task runs after all of deps have finished; deps must already be in the graph.
+  TaskID add(function<void()> fn, const vector<TaskID> & deps = {}, bool onCaller = false);
+
+  // Run every task once, then return; the graph can not be run again.
+  // The first exception thrown by any task is rethrown here.
+  void run();
+
+  unsigned int size() const;
+
+private:
+  struct Impl;
+  std::shared_ptr<Impl> impl;
+};
+
+} // end of namespace
+
+// -------------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -104,6 +104,22 @@ double trim(double x, double minX, double maxX, bool strict) {
 }
 
 
+uint64_t hashCombine(uint64_t h, uint64_t v) {
+  // the splitmix64 finalizer, applied to the combination
+  uint64_t z = h ^ (v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2));
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+
+uint64_t quantHash(double x, double quantum) {
+  assert(0.0 < quantum);
+  const int64_t q = ((int64_t)(std::llround(x / quantum)));
+  return hashCombine(0, ((uint64_t)(q)));
+}
+
+
 VUI uiSeq(const unsigned int n1, const unsigned int n2, const unsigned int ns) {
   VUI uis = {};
   assert (n1 <= n2);
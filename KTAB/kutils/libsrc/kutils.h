@@ -81,6 +81,13 @@ double nProd(double x, double y);
 
 double trim(double x, double minX, double maxX, bool strict = false);
 
+// mix a value into a running 64-bit hash, e.g. to fingerprint a state
+uint64_t hashCombine(uint64_t h, uint64_t v);
+
+// hash of x after rounding it to the nearest multiple of quantum,
+// so values closer than about quantum/2 usually hash the same
+uint64_t quantHash(double x, double quantum);
+
 // This launches a number of threads, but no more than numPar at a time.
 // The function is given unsigned ints in a range, like [0, n-1] inclusive.
 // If no value is given for numPar, it will guess from the number of cores.
@@ -101,6 +101,21 @@ tuple<KMatrix, unsigned int, KMatrix> viABG(const KMatrix & xInit,
 }
 
 
+tuple<KMatrix, unsigned int, KMatrix> viABG(const KMatrix & xInit,
+                                            const KSparse & M, const KMatrix & q,
+                                            function<KMatrix(const KMatrix & x)> P,
+                                            double beta, double thresh, unsigned int iMax,
+                                            bool extra) {
+  assert(M.numR() == M.numC());
+  assert(M.numR() == q.numR());
+  assert(1 == q.numC());
+  auto F = [&M, &q](const KMatrix & x) {
+    return (M*x + q);
+  };
+  return viABG(xInit, F, P, beta, thresh, iMax, extra);
+}
+
+
 // -------------------------------------------------
 // This is my implementation of BSHe96's method for solving linear variational inequalities:
 // find x in K s.t. for all y in  K, (Mx+q)*(y-x)>=0
@@ -109,34 +124,29 @@ tuple<KMatrix, unsigned int, KMatrix> viABG(const KMatrix & xInit,
 // "A Modified Projection and Contraction Method for a Class of Linear Complementarity Problems",
 // B. S. He, Nanjing University, in Journal of Computational Mathematics, 1996
 
-tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KMatrix & M, const KMatrix & q,
-                                               function<KMatrix(const KMatrix &)> pK,
-                                               KMatrix u0, const double eps, const unsigned int iMax) {
-  if (false) {
-    LOG(INFO) << "Received M:";
-    M.mPrintf("%+.4f  ");
-    LOG(INFO) << "Received q:";
-    trans(q).mPrintf("%+.4f  ");
-  }
-
+// The iteration needs only products with M and trans(M), so it is written
+// once for both dense and sparse M. Each iteration costs one of each.
+static tuple<KMatrix, unsigned int, KMatrix> bsHe96(function<KMatrix(const KMatrix &)> mFn,
+                                                    function<KMatrix(const KMatrix &)> mtFn,
+                                                    const KMatrix & q,
+                                                    function<KMatrix(const KMatrix &)> pK,
+                                                    const KMatrix & u0, const double eps,
+                                                    const unsigned int iMax) {
   unsigned int n = q.numR();
   assert(1 == q.numC());
-  assert(n == M.numR());
-  assert(n == M.numC());
   assert(n == u0.numR());
   assert(1 == u0.numC());
   assert(eps > 0.0);
 
   double gamma = 1.8; // any 0<gamma<2 will do. Note that 1.618034 = (1+sqrt(5))/2
-  KMatrix Mt = trans(M);
   double qMax = maxAbs(q);
   assert(qMax > 0.0);
-  KMatrix I = iMat(n);
 
   // for general VI, e(u) = u - pK(u - F(u))
   // will have e(u)=0 iff u solves the VI.
-  auto err = [&M, &q, pK](const KMatrix & u) {
-    KMatrix proj = pK(u - (M*u + q));
+  // F(u) = M*u + q is kept alongside u, as the next step needs it again.
+  auto err = [pK](const KMatrix & u, const KMatrix & f) {
+    KMatrix proj = pK(u - f);
     return (u - proj);
   };
   auto normS = [](const KMatrix & m) {
@@ -146,19 +156,23 @@ tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KMatrix & M, const KMatrix
 
 
   KMatrix u1 = pK(u0); // project onto K before first iteration
-  KMatrix e1 = err(u1);
+  KMatrix f1 = mFn(u1) + q;
+  KMatrix e1 = err(u1, f1);
   double r = maxAbs(e1) / qMax;
   unsigned int iter = 0;
 
   while (r > eps) {
-    KMatrix g1 = Mt*e1 + (M*u1 + q);
-    double rho = normS(e1) / normS((I + Mt)*e1);
+    KMatrix mte = mtFn(e1);
+    KMatrix g1 = mte + f1;
+    double rho = normS(e1) / normS(e1 + mte); // (I + Mt)*e1
     KMatrix u2 = pK(u1 - gamma*rho*g1);
-    KMatrix e2 = err(u2);
+    KMatrix f2 = mFn(u2) + q;
+    KMatrix e2 = err(u2, f2);
 
     iter++;
     assert(iter < iMax);
     u1 = u2;
+    f1 = f2;
     e1 = e2;
     r = maxAbs(e1) / qMax;
   }
@@ -166,6 +180,40 @@ tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KMatrix & M, const KMatrix
   return trpl;
 }
 
+
+tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KMatrix & M, const KMatrix & q,
+                                               function<KMatrix(const KMatrix &)> pK,
+                                               KMatrix u0, const double eps, const unsigned int iMax) {
+  if (false) {
+    LOG(INFO) << "Received M:";
+    M.mPrintf("%+.4f  ");
+    LOG(INFO) << "Received q:";
+    trans(q).mPrintf("%+.4f  ");
+  }
+
+  unsigned int n = q.numR();
+  assert(n == M.numR());
+  assert(n == M.numC());
+
+  KMatrix Mt = trans(M);
+  auto mFn = [&M](const KMatrix & x) { return M*x; };
+  auto mtFn = [&Mt](const KMatrix & x) { return Mt*x; };
+  return bsHe96(mFn, mtFn, q, pK, u0, eps, iMax);
+}
+
+
+tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KSparse & M, const KMatrix & q,
+                                               function<KMatrix(const KMatrix &)> pK,
+                                               KMatrix u0, const double eps, const unsigned int iMax) {
+  unsigned int n = q.numR();
+  assert(n == M.numR());
+  assert(n == M.numC());
+
+  auto mFn = [&M](const KMatrix & x) { return M.mult(x); };
+  auto mtFn = [&M](const KMatrix & x) { return M.multT(x); };
+  return bsHe96(mFn, mtFn, q, pK, u0, eps, iMax);
+}
+
 }; // namespace
 
 
@@ -34,6 +34,7 @@
 
 #include "kutils.h"
 #include "kmatrix.h"
+#include "ksparse.h"
 #include "prng.h"
 
 namespace KBase {
@@ -52,10 +53,23 @@ tuple<KMatrix, unsigned int, KMatrix> viABG(const KMatrix & xInit,
                                             double beta, double thresh, unsigned int iMax,
                                             bool extra);
 
+// Linear VI with a sparse operator, F(x) = M*x + q.
+// Like the dense forms, xInit (or u0) may be a warm start,
+// e.g. the solution of a nearby problem.
+tuple<KMatrix, unsigned int, KMatrix> viABG(const KMatrix & xInit,
+                                            const KSparse & M, const KMatrix & q,
+                                            function<KMatrix(const KMatrix & x)> P,
+                                            double beta, double thresh, unsigned int iMax,
+                                            bool extra);
+
 tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KMatrix & M, const KMatrix & q,
                                                function<KMatrix(const KMatrix &)> pK,
                                                KMatrix u0, const double eps, const unsigned int iMax);
 
+tuple<KMatrix, unsigned int, KMatrix> viBSHe96(const KSparse & M, const KMatrix & q,
+                                               function<KMatrix(const KMatrix &)> pK,
+                                               KMatrix u0, const double eps, const unsigned int iMax);
+
 }; // namespace
 
 // -------------------------------------------------
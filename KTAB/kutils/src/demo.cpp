@@ -953,6 +953,90 @@ void demoAntiLemke(PRNG* rng, unsigned int n) {
 }
 
 
+// Check KSparse against dense KMatrix arithmetic on random, mostly-zero
+// matrices built with duplicate and zero triplets, then solve an LVI
+// with sparse and dense M.
+void demoSparse(PRNG* rng) {
+    using KBase::KSparse;
+    using KBase::Triplet;
+    using KBase::maxAbs;
+    const double tol = 1E-12;
+
+    for (unsigned int t = 0; t < 20; t++) {
+        const unsigned int nr = 1 + ((unsigned int)rng->uniform(0.0, 40.0));
+        const unsigned int nc = 1 + ((unsigned int)rng->uniform(0.0, 40.0));
+        auto dense = KMatrix(nr, nc);
+        auto ts = vector<Triplet>();
+        const unsigned int nt = 1 + (nr * nc) / 5;
+        for (unsigned int n = 0; n < nt; n++) {
+            const unsigned int i = (unsigned int)rng->uniform(0.0, nr - 0.5);
+            const unsigned int j = (unsigned int)rng->uniform(0.0, nc - 0.5);
+            const double v = rng->uniform(-1.0, 1.0);
+            ts.push_back(Triplet(i, j, v));
+            dense(i, j) = dense(i, j) + v;
+            if (0 == n % 7) { // a duplicate which cancels, leaving a zero
+                ts.push_back(Triplet(i, j, -v));
+                dense(i, j) = dense(i, j) - v;
+            }
+        }
+        auto a = KSparse::fromTriplets(nr, nc, ts);
+
+        // CSR invariants: rows in order, columns strictly increasing within each, no zeros
+        unsigned int pi = 0;
+        int pj = -1;
+        for (auto tr : a.triplets()) {
+            const unsigned int i = get<0>(tr);
+            const unsigned int j = get<1>(tr);
+            assert(pi <= i);
+            if (i != pi) {
+                pi = i;
+                pj = -1;
+            }
+            assert(pj < (int)j);
+            pj = j;
+            assert(0.0 != get<2>(tr));
+        }
+
+        auto x = KMatrix::uniform(rng, nc, 2, -1.0, 1.0);
+        auto y = KMatrix::uniform(rng, nr, 2, -1.0, 1.0);
+        const double eDense = maxAbs(a.toDense() - dense);
+        const double eFrom = maxAbs(KSparse::fromDense(dense).toDense() - dense);
+        const double eMult = maxAbs(a * x - dense * x);
+        const double eMultT = maxAbs(a.multT(y) - trans(dense) * y);
+        const double eTrans = maxAbs(trans(a).toDense() - trans(dense));
+        const double eScale = maxAbs((-2.0 * a).toDense() + 2.0 * dense);
+        const double eRound = maxAbs(KSparse::fromTriplets(nr, nc, a.triplets()).toDense() - dense);
+        const double eMax = std::max({ eDense, eFrom, eMult, eMultT, eTrans, eScale, eRound });
+        LOG(INFO) << getFormattedString("%2u by %2u, %3u non-zeros, largest error %.2E",
+                                        nr, nc, a.nnz(), eMax);
+        assert(a.nnz() == KSparse::fromDense(dense).nnz());
+        assert(eMax < tol);
+    }
+
+    const unsigned int n = 25;
+    LOG(INFO) << "Solve AntiLemke LVI in" << n << "dimensions, with sparse and dense M";
+    auto al = antiLemke(n);
+    const KMatrix M = get<0>(al);
+    const KMatrix q = get<1>(al);
+    const auto sM = KSparse::fromDense(M);
+    LOG(INFO) << "M has" << sM.nnz() << "non-zeros of" << (n * n);
+    auto xInit = KMatrix::uniform(rng, n, 1, -20.0, 20.0);
+    const double eps = 1E-6;
+    const unsigned int iterLim = 10000;
+    auto rd = viBSHe96(M, q, KBase::projPos, xInit, eps, iterLim);
+    auto rs = viBSHe96(sM, q, KBase::projPos, xInit, eps, iterLim);
+    const double du = maxAbs(get<0>(rd) - get<0>(rs));
+    LOG(INFO) << getFormattedString("BSHe96: dense %u and sparse %u iterations, solutions differ by %.2E",
+                                    get<1>(rd), get<1>(rs), du);
+    assert(du < 100 * eps);
+    // starting from the answer, there is nothing left to do
+    auto rw = viBSHe96(sM, q, KBase::projPos, get<0>(rs), eps, iterLim);
+    LOG(INFO) << "Warm start from that solution takes" << get<1>(rw) << "iterations";
+    assert(0 == get<1>(rw));
+    return;
+}
+
+
 void demoEllipse(PRNG* rng) {
     unsigned int numD = 9;
     auto a = KMatrix::uniform(rng, numD, 1, 1.0, 10.0);
@@ -2083,6 +2167,7 @@ int main(int ac, char **av) {
     unsigned int vimcpN = 0;
     bool threadP = false;
     bool uiP = false;
+    bool sparseP = false;
     bool run = true;
 
     // tmp args
@@ -2116,6 +2201,8 @@ int main(int ac, char **av) {
         printf("                  1: linear VI with ellipsoidal constraints \n");
         printf("                  2: Anti-Lemke linear VI \n");
         printf("\n");
+        printf("--sparse          sparse matrices, checked against dense ones \n");
+        printf("\n");
         printf("--thread          several thread operations \n");
         printf("\n");
         printf("--seed <n>        set a 64bit seed \n");
@@ -2156,6 +2243,9 @@ int main(int ac, char **av) {
             else if (strcmp(av[i], "--ui") == 0) {
                 uiP = true;
             }
+            else if (strcmp(av[i], "--sparse") == 0) {
+                sparseP = true;
+            }
             else if (strcmp(av[i], "--vimcp") == 0) {
                 vimcpP = true;
                 i++;
@@ -2267,6 +2357,11 @@ int main(int ac, char **av) {
         UDemo::demoUIndices();
     }
 
+    if (sparseP) {
+        rng->setSeed(seed);
+        UDemo::demoSparse(rng);
+    }
+
     delete rng;
     KBase::displayProgramEnd(sTime);
     return 0;
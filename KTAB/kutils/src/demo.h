@@ -30,6 +30,7 @@
 #include "gaopt.h"
 #include "hcsearch.h"
 #include "vimcp.h"
+#include "ksparse.h"
 
 namespace UDemo {
 // avoid namespace pollution by keeping all this demo stuff in its own namespace.
@@ -45,6 +46,7 @@ KMatrix eUnitize(const KMatrix & a, const KMatrix & x);
 KMatrix projEllipse(const KMatrix & a, const KMatrix & w);
 void demoEllipseLVI(PRNG* rng, unsigned int n);
 void demoAntiLemke(PRNG* rng, unsigned int n);
+void demoSparse(PRNG* rng);
 
 
 // -------------------------------------------------
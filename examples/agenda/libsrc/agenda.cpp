@@ -23,6 +23,9 @@
 // Implement a simple agenda-object, independent of kmodel.h
 // --------------------------------------------
 #include "agenda.h"
+#include <bitset>
+#include <limits>
+#include <thread>
 #include <easylogging++.h>
 
 namespace AgendaControl {
@@ -328,9 +331,7 @@ Agenda* Agenda::makeAgenda(vector<int> xs, PartitionRule pr, PRNG* rng) {
 double Choice::eval(const KMatrix& val, unsigned int i) {
   double valL = lhs->eval(val, i);
   double valR = rhs->eval(val, i);
-  double valMin = (valL < valR) ? valL : valR;
-  double valMax = (valL > valR) ? valL : valR;
-  double ev = (4.0*valMin + 3.0*valMax) / 7.0;
+  double ev = AgendaSpace::choiceValue(valL, valR);
   //cout << "Eval " << i << " of " << *this << " = " << ev << endl << flush;
   return ev;
 };
@@ -388,6 +389,335 @@ double Terminal::eval(const KMatrix& val, unsigned int i) {
   return ev;
 };
 
+// ------------------------------------------
+
+namespace {
+unsigned int bitCount(uint32_t s) {
+  return ((unsigned int)(std::bitset<32>(s).count()));
+}
+
+unsigned int lowItem(uint32_t s) {
+  assert(0 != s);
+  unsigned int j = 0;
+  while (0 == (s & (1u << j))) {
+    j++;
+  }
+  return j;
+}
+
+uint64_t safeMult(uint64_t a, uint64_t b) {
+  if ((0 != b) && (a > std::numeric_limits<uint64_t>::max() / b)) {
+    throw KBase::KException("AgendaSpace: too many agendas to rank in 64 bits");
+  }
+  return a * b;
+}
+
+uint64_t safeAdd(uint64_t a, uint64_t b) {
+  if (a > std::numeric_limits<uint64_t>::max() - b) {
+    throw KBase::KException("AgendaSpace: too many agendas to rank in 64 bits");
+  }
+  return a + b;
+}
+
+unsigned int parChunks(unsigned int numPar) {
+  if (0 == numPar) {
+    numPar = std::thread::hardware_concurrency();
+  }
+  return (0 == numPar) ? 4 : numPar;
+}
+
+// masks of {0 ... n-1} grouped by their size
+vector<vector<uint32_t>> masksBySize(unsigned int n) {
+  auto bySize = vector<vector<uint32_t>>(n + 1);
+  const uint32_t full = (1u << n) - 1;
+  for (uint32_t s = 1; s <= full; s++) {
+    bySize[bitCount(s)].push_back(s);
+  }
+  return bySize;
+}
+}; // end of anonymous namespace
+
+
+AgendaSpace::AgendaSpace(unsigned int n, Agenda::PartitionRule pr) {
+  assert(0 < n);
+  assert(n < 32);
+  nItems = n;
+  rule = pr;
+
+  // choose(m, k) for all m <= n, from Pascal's triangle, as fact overflows past 20
+  auto binom = vector<vector<uint64_t>>(n + 1, vector<uint64_t>(n + 1, 0));
+  for (unsigned int m = 0; m <= n; m++) {
+    binom[m][0] = 1;
+    for (unsigned int k = 1; k <= m; k++) {
+      binom[m][k] = binom[m - 1][k - 1] + binom[m - 1][k];
+    }
+  }
+
+  agCount = vector<uint64_t>(n + 1, 0);
+  agCount[1] = 1;
+  for (unsigned int m = 2; m <= n; m++) {
+    uint64_t cm = 0;
+    for (unsigned int k = 1; k <= m / 2; k++) {
+      if (Agenda::balancedLR(rule, k, m - k)) {
+        // when the sides are equal, only the half of the splits
+        // whose left side holds the lowest item are canonical
+        uint64_t splits = (2 * k == m) ? binom[m][k] / 2 : binom[m][k];
+        cm = safeAdd(cm, safeMult(splits, safeMult(agCount[k], agCount[m - k])));
+      }
+    }
+    agCount[m] = cm;
+  }
+
+  if ((Agenda::PartitionRule::FreePR == rule) && (n <= 10)) {
+    assert(agCount[n] == numAgenda(n));
+  }
+}
+
+
+double AgendaSpace::choiceValue(double valL, double valR) {
+  double valMin = (valL < valR) ? valL : valR;
+  double valMax = (valL > valR) ? valL : valR;
+  double ev = (4.0*valMin + 3.0*valMax) / 7.0;
+  return ev;
+}
+
+
+uint32_t AgendaSpace::nextSplit(uint32_t s, uint32_t l) const {
+  // walk the proper, non-empty subsets of s downward from l
+  const unsigned int m = bitCount(s);
+  const uint32_t low = s & (~s + 1);
+  l = (l - 1) & s;
+  while (0 != l) {
+    const unsigned int k = bitCount(l);
+    bool canon = (2 * k < m) || ((2 * k == m) && (0 != (l & low)));
+    if (canon && Agenda::balancedLR(rule, k, m - k)) {
+      return l;
+    }
+    l = (l - 1) & s;
+  }
+  return 0;
+}
+
+
+bool AgendaSpace::decode(uint32_t s, uint64_t rank, uint32_t& l,
+                         uint64_t& lRank, uint64_t& rRank) const {
+  const unsigned int m = bitCount(s);
+  assert(rank < agCount[m]);
+  if (1 == m) {
+    return false;
+  }
+  for (l = nextSplit(s, s); 0 != l; l = nextSplit(s, l)) {
+    const unsigned int k = bitCount(l);
+    const uint64_t nR = agCount[m - k];
+    const uint64_t nLR = agCount[k] * nR;
+    if (rank < nLR) {
+      lRank = rank / nR;
+      rRank = rank % nR;
+      return true;
+    }
+    rank = rank - nLR;
+  }
+  throw KBase::KException("AgendaSpace::decode: rank beyond the splits of its subset");
+}
+
+
+double AgendaSpace::evalSub(uint32_t s, uint64_t rank, const KMatrix& val, unsigned int i) const {
+  uint32_t l = 0;
+  uint64_t lRank = 0;
+  uint64_t rRank = 0;
+  if (!decode(s, rank, l, lRank, rRank)) {
+    return val(i, lowItem(s));
+  }
+  double valL = evalSub(l, lRank, val, i);
+  double valR = evalSub(s ^ l, rRank, val, i);
+  return choiceValue(valL, valR);
+}
+
+
+double AgendaSpace::eval(uint64_t rank, const KMatrix& val, unsigned int i) const {
+  assert(nItems == val.numC());
+  return evalSub((1u << nItems) - 1, rank, val, i);
+}
+
+
+string AgendaSpace::showSub(uint32_t s, uint64_t rank) const {
+  uint32_t l = 0;
+  uint64_t lRank = 0;
+  uint64_t rRank = 0;
+  if (!decode(s, rank, l, lRank, rRank)) {
+    return std::to_string(lowItem(s));
+  }
+  return "[" + showSub(l, lRank) + ":" + showSub(s ^ l, rRank) + "]";
+}
+
+
+string AgendaSpace::show(uint64_t rank) const {
+  return showSub((1u << nItems) - 1, rank);
+}
+
+
+vector<tuple<uint64_t, double>> AgendaSpace::bestAgendas(const KMatrix& val, unsigned int i,
+                                                         unsigned int k, unsigned int numPar) const {
+  assert(0 < k);
+  assert(nItems == val.numC());
+  typedef tuple<double, uint64_t> VR;
+  const unsigned int numChunks = parChunks(numPar);
+  const auto bySize = masksBySize(nItems);
+
+  // best[s] holds the k best (value, rank) of the agendas over s, best first
+  auto best = vector<vector<VR>>(1u << nItems);
+  auto bestOf = [this, &best, &val, i, k](uint32_t s) {
+    const unsigned int m = bitCount(s);
+    if (1 == m) {
+      best[s] = { VR(val(i, lowItem(s)), 0) };
+      return;
+    }
+    vector<VR> cands = {};
+    uint64_t off = 0;
+    for (uint32_t l = nextSplit(s, s); 0 != l; l = nextSplit(s, l)) {
+      const auto& bl = best[l];
+      const auto& br = best[s ^ l];
+      const uint64_t nR = agCount[m - bitCount(l)];
+      // the pair (a,b) is beaten by every (a',b') with a'<=a and b'<=b,
+      // so only pairs with (a+1)(b+1) <= k can make the list
+      for (unsigned int a = 0; a < bl.size(); a++) {
+        for (unsigned int b = 0; (b < br.size()) && ((a + 1)*(b + 1) <= k); b++) {
+          double v = choiceValue(std::get<0>(bl[a]), std::get<0>(br[b]));
+          uint64_t r = off + std::get<1>(bl[a])*nR + std::get<1>(br[b]);
+          cands.push_back(VR(v, r));
+        }
+      }
+      off = off + agCount[bitCount(l)] * nR;
+    }
+    auto better = [](const VR& x, const VR& y) {
+      if (std::get<0>(x) != std::get<0>(y)) {
+        return std::get<0>(x) > std::get<0>(y);
+      }
+      return std::get<1>(x) < std::get<1>(y);
+    };
+    const unsigned int nk = (cands.size() < k) ? cands.size() : k;
+    std::partial_sort(cands.begin(), cands.begin() + nk, cands.end(), better);
+    cands.resize(nk);
+    best[s] = cands;
+    return;
+  };
+
+  // subsets of one size depend only on smaller ones, so each layer runs in parallel
+  for (unsigned int m = 1; m <= nItems; m++) {
+    const auto& layer = bySize[m];
+    auto chunk = [&layer, &bestOf, numChunks](unsigned int c) {
+      for (unsigned int j = c; j < layer.size(); j += numChunks) {
+        bestOf(layer[j]);
+      }
+      return;
+    };
+    KBase::groupThreads(chunk, 0, numChunks - 1, numChunks);
+  }
+
+  auto rslt = vector<tuple<uint64_t, double>>();
+  for (auto vr : best[(1u << nItems) - 1]) {
+    rslt.push_back(tuple<uint64_t, double>(std::get<1>(vr), std::get<0>(vr)));
+  }
+  return rslt;
+}
+
+
+void AgendaSpace::walk(uint32_t s, const KMatrix& val, unsigned int i,
+                       const vector<vector<double>>& memo,
+                       const function<void(uint64_t rank, double v)>& fn) const {
+  const unsigned int m = bitCount(s);
+  if (1 == m) {
+    fn(0, val(i, lowItem(s)));
+    return;
+  }
+  if (!memo[s].empty()) {
+    for (uint64_t r = 0; r < memo[s].size(); r++) {
+      fn(r, memo[s][r]);
+    }
+    return;
+  }
+  uint64_t off = 0;
+  for (uint32_t l = nextSplit(s, s); 0 != l; l = nextSplit(s, l)) {
+    const uint32_t r = s ^ l;
+    const uint64_t nR = agCount[m - bitCount(l)];
+    walk(l, val, i, memo, [&](uint64_t rl, double vl) {
+      walk(r, val, i, memo, [&](uint64_t rr, double vr) {
+        fn(off + rl*nR + rr, choiceValue(vl, vr));
+      });
+    });
+    off = off + agCount[bitCount(l)] * nR;
+  }
+  return;
+}
+
+
+void AgendaSpace::streamAgendas(const KMatrix& val, unsigned int i, unsigned int numChunks,
+                                function<void(unsigned int c, uint64_t rank, double v)> fn) const {
+  assert(nItems == val.numC());
+  numChunks = parChunks(numChunks);
+  const uint32_t full = (1u << nItems) - 1;
+  if (1 == nItems) {
+    fn(0, 0, val(i, 0));
+    return;
+  }
+
+  // Hold the values of every sub-agenda over subsets of up to memoSize items,
+  // the largest size for which they all fit in memoBudget.
+  const auto bySize = masksBySize(nItems);
+  unsigned int memoSize = 1;
+  uint64_t memoUsed = 0;
+  for (unsigned int m = 2; m < nItems; m++) {
+    uint64_t mUse = bySize[m].size() * agCount[m];
+    if ((mUse / bySize[m].size() != agCount[m]) || (memoBudget < memoUsed + mUse)) {
+      break;
+    }
+    memoUsed = memoUsed + mUse;
+    memoSize = m;
+  }
+  auto memo = vector<vector<double>>(full + 1);
+  for (unsigned int m = 2; m <= memoSize; m++) {
+    const auto& layer = bySize[m];
+    auto chunk = [this, &layer, &memo, &val, i, numChunks](unsigned int c) {
+      for (unsigned int j = c; j < layer.size(); j += numChunks) {
+        const uint32_t s = layer[j];
+        auto vs = vector<double>(agCount[bitCount(s)], 0.0);
+        walk(s, val, i, memo, [&vs](uint64_t r, double v) {
+          vs[r] = v;
+        });
+        memo[s] = vs;
+      }
+      return;
+    };
+    KBase::groupThreads(chunk, 0, numChunks - 1, numChunks);
+  }
+
+  // deal the top-level splits out to the chunks
+  auto splits = vector<tuple<uint32_t, uint64_t>>();
+  uint64_t off = 0;
+  for (uint32_t l = nextSplit(full, full); 0 != l; l = nextSplit(full, l)) {
+    splits.push_back(tuple<uint32_t, uint64_t>(l, off));
+    off = off + agCount[bitCount(l)] * agCount[nItems - bitCount(l)];
+  }
+  assert(off == agCount[nItems]);
+
+  auto chunk = [this, &splits, &memo, &val, i, numChunks, full, &fn](unsigned int c) {
+    for (unsigned int j = c; j < splits.size(); j += numChunks) {
+      const uint32_t l = std::get<0>(splits[j]);
+      const uint64_t lOff = std::get<1>(splits[j]);
+      const uint32_t r = full ^ l;
+      const uint64_t nR = agCount[bitCount(r)];
+      walk(l, val, i, memo, [&](uint64_t rl, double vl) {
+        walk(r, val, i, memo, [&](uint64_t rr, double vr) {
+          fn(c, lOff + rl*nR + rr, choiceValue(vl, vr));
+        });
+      });
+    }
+    return;
+  };
+  KBase::groupThreads(chunk, 0, numChunks - 1, numChunks);
+  return;
+}
+
 }; // end of namespace
 
 // ------------------------------------------
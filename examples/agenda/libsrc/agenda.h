@@ -26,6 +26,9 @@
 #define AGENDA_H
 
 #include <algorithm>
+#include <functional>
+#include <string>
+#include <tuple>
 #include <vector>
 #include <iterator>
 
@@ -39,6 +42,7 @@
 namespace AgendaControl {
 using std::function;
 using std::ostream;
+using std::string;
 using std::vector;
 using std::tuple;
 using KBase::KMatrix;
@@ -50,6 +54,7 @@ using KBase::Position;
 class Agenda;
 class Choice;
 class Terminal;
+class AgendaSpace;
 
 uint64_t fact(unsigned int n);
 uint64_t numSets(unsigned int n, unsigned int m);
@@ -125,6 +130,68 @@ protected:
 };
 
 
+// A compact encoding of all the agendas of one type over n items.
+// A sub-agenda is an item bitmask plus its rank among the agendas over
+// that subset; ranks follow the canonical splits of the subset (smaller
+// side on the left, or the side holding the lowest item when equal).
+// As the partition rules depend only on sizes, the counts are per-size,
+// so no trees are built and sub-agenda values are shared by every agenda
+// that contains them.
+class AgendaSpace {
+public:
+  AgendaSpace(unsigned int n, Agenda::PartitionRule pr);
+  virtual ~AgendaSpace() {};
+
+  unsigned int numItems() const { return nItems; }
+  Agenda::PartitionRule partitionRule() const { return rule; }
+
+  // number of agendas over all n items, and over any m of them
+  uint64_t numAgendas() const { return agCount[nItems]; }
+  uint64_t numAgendas(unsigned int m) const { return agCount[m]; }
+
+  // print the agenda of the given rank, as Agenda would
+  string show(uint64_t rank) const;
+
+  // value of the agenda of the given rank to actor i
+  double eval(uint64_t rank, const KMatrix& val, unsigned int i) const;
+
+  // The k best agendas for actor i, best first, as (rank, value).
+  // Because a choice is worth more as either side is worth more, only
+  // the k best sub-agendas of each subset are kept, layer by layer.
+  vector<tuple<uint64_t, double>> bestAgendas(const KMatrix& val, unsigned int i,
+                                              unsigned int k, unsigned int numPar = 0) const;
+
+  // Call fn(c, rank, value) once for every agenda, where c is the chunk doing it;
+  // chunks run in parallel, so fn must be safe to call from each of them.
+  void streamAgendas(const KMatrix& val, unsigned int i, unsigned int numChunks,
+                     function<void(unsigned int c, uint64_t rank, double v)> fn) const;
+
+  // value of a choice between two sub-agendas of the given values
+  static double choiceValue(double valL, double valR);
+
+  // most sub-agenda values streamAgendas will hold in memory
+  static const uint64_t memoBudget = 1 << 22;
+
+protected:
+  // the canonical split of subset s after l, or 0 when there are no more
+  uint32_t nextSplit(uint32_t s, uint32_t l) const;
+
+  // find the split of s holding the given rank; false if s is a single item
+  bool decode(uint32_t s, uint64_t rank, uint32_t& l, uint64_t& lRank, uint64_t& rRank) const;
+
+  double evalSub(uint32_t s, uint64_t rank, const KMatrix& val, unsigned int i) const;
+  string showSub(uint32_t s, uint64_t rank) const;
+
+  void walk(uint32_t s, const KMatrix& val, unsigned int i, const vector<vector<double>>& memo,
+            const function<void(uint64_t rank, double v)>& fn) const;
+
+private:
+  unsigned int nItems = 0;
+  Agenda::PartitionRule rule = Agenda::PartitionRule::FreePR;
+  vector<uint64_t> agCount = {};
+};
+
+
 }; // end of namespace
 
 
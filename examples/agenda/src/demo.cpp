@@ -81,28 +81,33 @@ void setupScenario1(unsigned int &numActor, unsigned int &numItems,
   return;
 }
 
-void bestAgendaChair(vector<Agenda*> ars, const KMatrix& vals, const KMatrix& caps) {
-  unsigned int bestK = 0;
-  double bestV = -1.0;
-  const double sigDiff = 1E-5; // utility is on [0,1] scale, differences less than this are insignificant
-  unsigned int numAgenda = ars.size();
-  for (unsigned int ai = 0; ai < numAgenda; ai++) {
-    auto ar = ars[ai];
-    ars.push_back(ar);
-    double v0 = ar->eval(vals, 0); //
-    assert(0.0 <= v0);
-    assert(v0 <= 1.0);
-
-    if (bestV + sigDiff < v0) {
-      bestV = v0;
-      bestK = ai;
-    }
+void bestAgendaChair(const AgendaSpace& as, const KMatrix& vals, const KMatrix& caps) {
+  const unsigned int topK = 3;
+  const uint64_t maxStream = 1 << 24; // cross-check by exhaustive streaming only up to this many
+  auto best = as.bestAgendas(vals, 0, topK);
+  assert(0 < best.size());
+  for (unsigned int k = 0; k < best.size(); k++) {
+    uint64_t bestK = std::get<0>(best[k]);
+    double bestV = std::get<1>(best[k]);
+    assert(0.0 <= bestV);
+    assert(bestV <= 1.0);
+    LOG(INFO)
+      << KBase::getFormattedString(
+        "Option %u for agenda-setting actor 0 is %llu with value %.4f  is ", k, (unsigned long long)bestK, bestV)
+      << as.show(bestK);
+  }
+
+  if (as.numAgendas() <= maxStream) {
+    const unsigned int numChunks = 4;
+    auto chunkV = vector<double>(numChunks, -1.0);
+    as.streamAgendas(vals, 0, numChunks, [&chunkV](unsigned int c, uint64_t, double v) {
+      if (chunkV[c] < v) {
+        chunkV[c] = v;
+      }
+    });
+    double bestV = *std::max_element(chunkV.begin(), chunkV.end());
+    assert(fabs(bestV - std::get<1>(best[0])) < 1E-10);
   }
-  LOG(INFO)
-    << KBase::getFormattedString(
-      "Best option for agenda-setting actor 0 is %u with value %.4f  is", bestK, bestV)
-    << *(ars[bestK]);
-  //ars[bestK]->showProbs(1.0);
   return;
 }
 
@@ -150,6 +155,7 @@ void demoCounting(unsigned int numI, unsigned int maxU, unsigned int maxS, unsig
     if (Agenda::PartitionRule::FreePR == pr) {
       assert(testA.size() == AgendaControl::numAgenda(numI));
     }
+    assert(testA.size() == AgendaSpace(numI, pr).numAgendas());
     return;
   };
 
@@ -173,6 +179,7 @@ int main(int ac, char **av) {
   using std::function;
   using KBase::dSeed;
   using AgendaControl::Agenda;
+  using AgendaControl::AgendaSpace;
   using AgendaControl::Choice;
   using AgendaControl::Terminal;
 
@@ -262,13 +269,9 @@ int main(int ac, char **av) {
 
   auto enumA = [numItems, vals, caps](Agenda::PartitionRule pr, std::string name) {
     LOG(INFO) << "Enumerating all agendas ("<<name<<") over " << numItems << " items ... ";
-    auto ars = Agenda::enumerateAgendas(numItems, pr);
-    LOG(INFO) << "found" << ars.size() << "agendas";
-    AgendaControl::bestAgendaChair(ars, vals, caps);
-    for (auto ar : ars) {
-      delete ar;
-      ar = nullptr;
-    }
+    auto as = AgendaSpace(numItems, pr);
+    LOG(INFO) << "found " << as.numAgendas() << " agendas";
+    AgendaControl::bestAgendaChair(as, vals, caps);
     return;
   };
 
@@ -32,6 +32,8 @@
 #include "smp.h"
 #include "comsel.h"
 #include "hcsearch.h"
+#include <limits>
+#include <thread>
 #include <easylogging++.h>
 
 namespace ComSelLib {
@@ -84,10 +86,6 @@ namespace ComSelLib {
 
 
   CSModel::~CSModel() {
-    if (nullptr != actorCSPstnUtil) {
-      delete actorCSPstnUtil;
-      actorCSPstnUtil = nullptr;
-    }
     if (nullptr != actorSpPstnUtil) {
       delete actorSpPstnUtil;
       actorSpPstnUtil = nullptr;
@@ -112,13 +110,28 @@ namespace ComSelLib {
 
 
   double CSModel::getActorCSPstnUtil(unsigned int ai, unsigned int pj) {
-    if (nullptr == actorCSPstnUtil) {
+    if (csUtilMin.empty()) {
       setActorSpPstnUtil();
       setActorCSPstnUtil();
     }
-    assert(ai < actorCSPstnUtil->numR());
-    assert(pj < actorCSPstnUtil->numC());
-    double uij = (*actorCSPstnUtil)(ai, pj);
+    assert(ai < numAct);
+    assert(pj < (((unsigned int)1) << numAct));
+
+    double rawU = 0.0;
+    {
+      std::lock_guard<std::mutex> lk(csUtilLock);
+      auto cu = csUtilCache.find(pj);
+      if (csUtilCache.end() == cu) {
+        cu = csUtilCache.insert({ pj, oneCSPstnUtil(intToVB(pj, numAct)) }).first;
+      }
+      rawU = (cu->second)(ai, 0);
+    }
+
+    // von Neumann utility scale, as rescaleRows would give
+    double uij = (rawU - csUtilMin[ai]) / (csUtilMax[ai] - csUtilMin[ai]);
+    // fix tiny round-off errors
+    uij = (uij < 0.0) ? 0.0 : uij;
+    uij = (1.0 < uij) ? 1.0 : uij;
     return uij;
   }
 
@@ -195,21 +208,113 @@ namespace ComSelLib {
 
   void CSModel::setActorCSPstnUtil() {
     assert(actorSpPstnUtil != nullptr); // prerequisite data must be provided
-    assert(actorCSPstnUtil == nullptr);
+    assert(csUtilMin.empty());
     assert(nullptr != rng);
-    auto numPos = ((unsigned int)(0.5 + exp2(numAct)));
-    auto rawUij = KMatrix(numAct, numPos);
-    for (unsigned int j = 0; j < numPos; j++) {
-      const VUI vbj = intToVB(j, numAct);
-      const KMatrix euj = oneCSPstnUtil(vbj);
-      assert(numAct == euj.numR());
-      assert(1 == euj.numC());
+
+    // the range of each actor's utility over all committees, one per chunk, then merged
+    const unsigned int hwc = std::thread::hardware_concurrency();
+    const unsigned int numChunks = (0 == hwc) ? 4 : hwc;
+    const double inf = std::numeric_limits<double>::infinity();
+    auto cMin = vector<vector<double>>(numChunks, vector<double>(numAct, +inf));
+    auto cMax = vector<vector<double>>(numChunks, vector<double>(numAct, -inf));
+    streamCSPstnUtils(numChunks, [this, &cMin, &cMax](unsigned int c, unsigned int, const KMatrix & euj) {
+      for (unsigned int i = 0; i < numAct; i++) {
+        cMin[c][i] = std::min(cMin[c][i], euj(i, 0));
+        cMax[c][i] = std::max(cMax[c][i], euj(i, 0));
+      }
+    });
+
+    auto uMin = vector<double>(numAct, +inf);
+    auto uMax = vector<double>(numAct, -inf);
+    for (unsigned int c = 0; c < numChunks; c++) {
       for (unsigned int i = 0; i < numAct; i++) {
-        rawUij(i, j) = euj(i, 0);
+        uMin[i] = std::min(uMin[i], cMin[c][i]);
+        uMax[i] = std::max(uMax[i], cMax[c][i]);
       }
     }
-    auto uij = KBase::rescaleRows(rawUij, 0.0, 1.0); // von Neumann utility scale
-    actorCSPstnUtil = new KMatrix(uij);
+    for (unsigned int i = 0; i < numAct; i++) {
+      assert(uMin[i] < uMax[i]);
+    }
+    csUtilMin = uMin;
+    csUtilMax = uMax;
+    return;
+  }
+
+  void CSModel::streamCSPstnUtils(unsigned int numChunks,
+                                  std::function<void(unsigned int c, unsigned int j, const KMatrix & euj)> fn) const {
+    assert(actorSpPstnUtil != nullptr); // prerequisite data must be provided
+    assert(numAct < 32); // committees are bit-vectors in an unsigned int
+    assert(1.0 < nonCommDivisor);
+    assert(0 < numChunks);
+    const unsigned int na = numAct;
+    const unsigned int numPos = ((unsigned int)1) << na;
+    const KMatrix & uSp = *actorSpPstnUtil;
+
+    // vote_k(i:j) of each actor, on the committee (full strength) or off it,
+    // exactly as oneCSPstnUtil computes them
+    auto vOn = vector<KMatrix>();
+    auto vOff = vector<KMatrix>();
+    for (unsigned int k = 0; k < na; k++) {
+      auto ak = (const CSActor*)(actrs[k]);
+      auto vfn = [ak, k, &uSp](double sk) {
+        return KMatrix::map([ak, k, sk, &uSp](unsigned int i, unsigned int j) {
+          return Model::vote(ak->vr, sk, uSp(k, i), uSp(k, j));
+        }, uSp.numC(), uSp.numC());
+      };
+      vOn.push_back(vfn(ak->sCap));
+      vOff.push_back(vfn(ak->sCap / nonCommDivisor));
+    }
+
+    // the coalitions for committee x, from scratch
+    auto cltns = [na, &vOn, &vOff](unsigned int x) {
+      auto vkij = [x, &vOn, &vOff](unsigned int k, unsigned int i, unsigned int j) {
+        return (1 == ((x >> k) & 1)) ? vOn[k](i, j) : vOff[k](i, j);
+      };
+      return Model::coalitions(vkij, na, na);
+    };
+
+    // actor k has just joined (or left) the committee: replace its contributions to c
+    auto flip = [na, &vOn, &vOff](KMatrix & c, unsigned int k, bool joined) {
+      const KMatrix & vNew = joined ? vOn[k] : vOff[k];
+      const KMatrix & vOld = joined ? vOff[k] : vOn[k];
+      for (unsigned int i = 0; i < na; i++) {
+        for (unsigned int j = 0; j < i; j++) {
+          const double vn = vNew(i, j);
+          const double vo = vOld(i, j);
+          c(i, j) = c(i, j) + std::max(0.0, vn) - std::max(0.0, vo);
+          c(j, i) = c(j, i) + std::max(0.0, -vn) - std::max(0.0, -vo);
+        }
+      }
+      return;
+    };
+
+    auto chunk = [this, numChunks, numPos, &uSp, &cltns, &flip, &fn](unsigned int ci) {
+      // Gray codes g0 <= g < g1; successive codes differ in the lowest set bit of g
+      const unsigned int g0 = (unsigned int)((((uint64_t)numPos) * ci) / numChunks);
+      const unsigned int g1 = (unsigned int)((((uint64_t)numPos) * (ci + 1)) / numChunks);
+      unsigned int x = 0;
+      KMatrix c;
+      for (unsigned int g = g0; g < g1; g++) {
+        if ((g == g0) || (0 == (g - g0) % csRefreshSteps)) {
+          x = g ^ (g >> 1);
+          c = cltns(x);
+        }
+        else {
+          unsigned int k = 0;
+          while (0 == ((g >> k) & 1)) {
+            k++;
+          }
+          x = x ^ (((unsigned int)1) << k);
+          flip(c, k, (1 == ((x >> k) & 1)));
+        }
+        const auto ppv = Model::probCE2(pcem, vpm, c);
+        const KMatrix eu = uSp * get<0>(ppv); // column of expected utilities to each actor
+        fn(ci, x, eu);
+      }
+      return;
+    };
+
+    KBase::groupThreads(chunk, 0, numChunks - 1, numChunks);
     return;
   }
 
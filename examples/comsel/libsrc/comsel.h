@@ -34,6 +34,9 @@
 #include "kmodel.h"
 
 #include "smp.h"
+#include <functional>
+#include <map>
+#include <mutex>
 
 namespace ComSelLib {
   // namespace to which KBase has no access
@@ -95,17 +98,33 @@ namespace ComSelLib {
 
     // get [0,1] normalized utility to each actor of each CSposition
     double getActorCSPstnUtil(unsigned int ai, unsigned int pj); 
-    
+
+    // Call fn(c, j, euj) for every committee j, with euj the column of actors' expected
+    // utilities (as from oneCSPstnUtil). The committees are split into numChunks runs of
+    // Gray-code order, each on its own thread as chunk c, so that each step flips one
+    // actor and updates the coalitions incrementally. Calls from different chunks overlap.
+    void streamCSPstnUtils(unsigned int numChunks,
+                           std::function<void(unsigned int c, unsigned int j, const KMatrix & euj)> fn) const;
+
   protected:
     unsigned int numDims = 0;
     
-    // normalized [0,1] utility to each actor (row) of each CS position (column)
-    KMatrix * actorCSPstnUtil = nullptr; 
-    
+    // The utility to actor i of committee j is normalized into [0,1] with the range of
+    // row i over all 2^numAct committees. Only those ranges are kept, not the whole
+    // numAct-by-2^numAct matrix; the raw columns of committees in use are cached.
+    vector<double> csUtilMin = {};
+    vector<double> csUtilMax = {};
+    std::map<unsigned int, KMatrix> csUtilCache = {};
+    std::mutex csUtilLock;
+
     void setActorCSPstnUtil();
     
     // return the clm-vector of actors' expected utility for this particular committee
     KMatrix oneCSPstnUtil(const VUI& vb) const;
+
+    // steps between recomputing the coalitions from scratch in streamCSPstnUtils,
+    // so that round-off in the incremental updates cannot accumulate
+    static const unsigned int csRefreshSteps = 256;
     
     // normalized [0,1] utility to each actor (row) of each spatial position (column)
     KMatrix * actorSpPstnUtil = nullptr; 
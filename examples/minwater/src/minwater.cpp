@@ -359,6 +359,82 @@ RsrcMinLP* RsrcMinLP::makeRMLP(PRNG* rng,
     return rmlp;
 }
 
+
+tuple<KSparse, KMatrix> RsrcMinLP::makeAb() const {
+    using KBase::Triplet;
+    const unsigned int N = numProd;
+    const unsigned int K1 = numPortC;
+    const unsigned int K2 = numSpplyC;
+    const unsigned int M = (K1 + K2) + (2 * N);
+    auto ts = vector<Triplet>();
+    auto matB = KMatrix(M, 1);
+
+    // portfolio values cannot fall below (1-r) of their initial values
+    auto initPV = portWghts * xInit;
+    for (unsigned int i = 0; i < K1; i++) {
+        for (unsigned int j = 0; j < N; j++) {
+            ts.push_back(Triplet(i, j, portWghts(i, j)));
+        }
+        matB(i, 0) = initPV(i, 0)*(1 - portRed(i, 0));
+    }
+
+    // supply/demand ratios cannot fall: dot(s - r*d, x) >= 0
+    auto initS = spplyWghts * xInit;
+    auto initD = dmndWghts * xInit;
+    for (unsigned int i = 0; i < K2; i++) {
+        const double sdRatio = initS(i, 0) / initD(i, 0);
+        for (unsigned int j = 0; j < N; j++) {
+            double sdij = spplyWghts(i, j) - (sdRatio * dmndWghts(i, j));
+            ts.push_back(Triplet(K1 + i, j, sdij));
+        }
+    }
+
+    // new value >= lower bound, and
+    // -(new value) >= -(upper bound)
+    for (unsigned int j = 0; j < N; j++) {
+        double xj = xInit(j, 0);
+        assert(0.0 <= xj);
+        double rj = bounds(j, 0);
+        assert(0.0 <= rj);
+        assert(rj <= 1.10); // 100% reduction is OK, but not 110% (that would be negative)
+        double gj = bounds(j, 1);
+        assert(-1.0 <= gj); // can force up to 100% reduction
+        assert(1.0 - rj <= 1.0 + gj);
+        ts.push_back(Triplet(K1 + K2 + j, j, 1.0));
+        matB(K1 + K2 + j, 0) = (1.0 - rj)*xj;
+        ts.push_back(Triplet(K1 + K2 + N + j, j, -1.0));
+        matB(K1 + K2 + N + j, 0) = -(1.0 + gj)*xj;
+    }
+
+    auto matA = KSparse::fromTriplets(M, N, ts);
+    return tuple<KSparse, KMatrix>(matA, matB);
+}
+
+
+tuple<KSparse, KMatrix> RsrcMinLP::makeMq() const {
+    using KBase::Triplet;
+    KSparse matA;
+    KMatrix matB;
+    std::tie(matA, matB) = makeAb();
+    const unsigned int N = matA.numC();
+    const unsigned int M = matA.numR();
+
+    // A goes in the lower-left block, -A' in the upper-right
+    auto ts = vector<Triplet>();
+    ts.reserve(2 * matA.nnz());
+    for (const auto & t : matA.triplets()) {
+        const unsigned int i = get<0>(t);
+        const unsigned int j = get<1>(t);
+        const double aij = get<2>(t);
+        ts.push_back(Triplet(N + i, j, aij));
+        ts.push_back(Triplet(j, N + i, -aij));
+    }
+    auto matM = KSparse::fromTriplets(N + M, N + M, ts);
+
+    auto matQ = joinV(rCosts, -1.0 * matB);
+    return tuple<KSparse, KMatrix>(matM, matQ);
+}
+
 void waterMin() {
 
     setUInit(scenQuant);
@@ -376,7 +452,7 @@ void waterMin() {
     return;
 }
 
-void demoRMLP(PRNG* rng) {
+void demoRMLP(PRNG* rng, unsigned int numP) {
 
 
     auto pfn = [](string lbl, string f, KMatrix m) {
@@ -385,102 +461,37 @@ void demoRMLP(PRNG* rng) {
         return;
     };
 
-    const unsigned int numP = 20;
-    const unsigned int numC = numP / 5;
-    const unsigned int numS = numP / 5;
+    // full vectors and matrices are only worth printing for small problems
+    const bool showAll = (numP <= 20);
+    const unsigned int numC = (numP < 5) ? 1 : numP / 5;
+    const unsigned int numS = (numP < 5) ? 1 : numP / 5;
     const unsigned int iterLim = 100 * 1000;
 
     auto rmlp = RsrcMinLP::makeRMLP(rng, numP, numC, numS);
     LOG(INFO) << "Number of products:" << rmlp->numProd;
-    pfn("Initial X: ", "%.2f ", rmlp->xInit);
-    pfn("Resource costs: ", "%.2f ", rmlp->rCosts);
     const double rsrc0 = dot(rmlp->xInit, rmlp->rCosts);
     LOG(INFO) << KBase::getFormattedString("Initial cost: %.2f", rsrc0);
-
-    pfn("Fractional reduction / growth bounds: ", "%8.4f ", rmlp->bounds);
-
-    auto rBounds = KMatrix(rmlp->numProd, 1);
-    auto gBounds = KMatrix(rmlp->numProd, 1);
-    for (unsigned int i = 0; i < rmlp->numProd; i++) {
-        double xi = rmlp->xInit(i, 0);
-        assert(0.0 <= xi);
-        double ri = rmlp->bounds(i, 0);
-        assert(0.0 <= ri);
-        assert(ri <= 1.10); // 100% reduction is OK, but not 110% (that would be negative)
-        double gi = rmlp->bounds(i, 1);
-        assert(-1.0 <= gi); // can force up to 100% reduction
-        assert(1.0 - ri <= 1.0 + gi);
-        rBounds(i, 0) = (1.0 - ri)*xi;
-        gBounds(i, 0) = (1.0 + gi)*xi;
-    }
-
-    pfn("Reduction bounds: ", "%7.2f ", rBounds);
-    pfn("Growth bounds: ", "%7.2f ", gBounds);
-
     LOG(INFO) << "Number of portfolios:" << rmlp->numPortC;
-    pfn("Portfolio weights: ", "%.3f ", rmlp->portWghts);
-    pfn("Portfolio reductions: ", "%.3f ", rmlp->portRed);
-
-    auto initPV = rmlp->portWghts * rmlp->xInit;
-    pfn("Initial portfolio values: ", "%8.2f", initPV);
-    auto portFn = [initPV, rmlp](unsigned int i, unsigned int j) {
-        double bij = initPV(i, j)*(1 - rmlp->portRed(i, j));
-        return bij;
-    };
-    auto minPV = KMatrix::map(portFn, initPV.numR(), initPV.numC());
-    pfn("Minimum portfolio values: ", "%8.2f", minPV);
-
     LOG(INFO) << "Number of supply/demand ratio constraints:" << rmlp->numSpplyC;
-
-    auto initS = rmlp->spplyWghts * rmlp->xInit;
-    assert(1 == initS.numC());
-    assert(initS.numR() == rmlp->numSpplyC);
-    auto initD = rmlp->dmndWghts * rmlp->xInit;
-    assert(1 == initD.numC());
-    assert(initD.numR() == rmlp->numSpplyC);
-    pfn("Initial supply values: ", "%8.2f", initS);
-    pfn("Initial demand values: ", "%8.2f", initD);
-
-    auto ratFn = [initS, initD](unsigned int i, unsigned int j) {
-        double rij = initS(i, j) / initD(i, j);
-        return rij;
-    };
-    auto sdRatio = KMatrix::map(ratFn, initS.numR(), initS.numC());
-    assert(1 == sdRatio.numC());
-    assert(sdRatio.numR() == rmlp->numSpplyC);
-    pfn("S/D ratios: ", "%8.4f", sdRatio);
-
-    auto sdFn = [rmlp, sdRatio](unsigned int i, unsigned int j) {
-        double sdij = rmlp->spplyWghts(i, j) - (sdRatio(i, 0) * rmlp->dmndWghts(i, j));
-        return sdij;
-    };
-    auto sdMat = KMatrix::map(sdFn, rmlp->numSpplyC, rmlp->numProd);
+    if (showAll) {
+        pfn("Initial X: ", "%.2f ", rmlp->xInit);
+        pfn("Resource costs: ", "%.2f ", rmlp->rCosts);
+        pfn("Fractional reduction / growth bounds: ", "%8.4f ", rmlp->bounds);
+        pfn("Portfolio weights: ", "%.3f ", rmlp->portWghts);
+        pfn("Portfolio reductions: ", "%.3f ", rmlp->portRed);
+    }
 
     // assemble all the above into a problem like
     // min c*x
     // Ax >= b
     // x >= 0
-
-    // start with portfolio constraints
-    auto matA = rmlp->portWghts;
-    auto matB = minPV;
-
-    matA = joinV(matA, sdMat);
-    matB = joinV(matB, KMatrix(rmlp->numSpplyC, 1)); // zero-filled
-
-    auto ident = KBase::iMat(rmlp->numProd);
-
-    // new value >= lower bound
-    matA = joinV(matA, ident);
-    matB = joinV(matB, rBounds);
-
-    // new value <= upper bound, or
-    // -(new value) >= -(upper bound)
-    matA = joinV(matA, -1.0 * ident);
-    matB = joinV(matB, -1.0 * gBounds);
-
-    pfn("Full A-matrix: ", "%+.3f ", matA);
-    pfn("Full b-vector: ", "%+.3f ", matB);
+    KSparse matA;
+    KMatrix matB;
+    std::tie(matA, matB) = rmlp->makeAb();
+    if (showAll) {
+        pfn("Full A-matrix: ", "%+.3f ", matA.toDense());
+        pfn("Full b-vector: ", "%+.3f ", matB);
+    }
 
     const unsigned int N = rmlp->numProd;
     const unsigned int K1 = rmlp->numPortC;
@@ -491,17 +502,18 @@ void demoRMLP(PRNG* rng) {
     assert(M == matB.numR());
     assert(1 == matB.numC());
 
-    auto topMat = joinH(KMatrix(N, N), -1.0*trans(matA));
-    auto botMat = joinH(matA, KMatrix(M, M));
-
-    auto matM = joinV(topMat, botMat);
-    auto matQ = joinV(rmlp->rCosts, -1.0 * matB);
+    KSparse matM;
+    KMatrix matQ;
+    std::tie(matM, matQ) = rmlp->makeMq();
 
     // reaffirm that everything is structured as expected
     assert(3 * N + (K1 + K2) == matM.numR());
     assert(3 * N + (K1 + K2) == matM.numC());
     assert(3 * N + (K1 + K2) == matQ.numR());
     assert(1 == matQ.numC());
+    LOG(INFO) << KBase::getFormattedString("M is %u by %u, with %u non-zeros (%.2f%%)",
+                                           matM.numR(), matM.numC(), matM.nnz(),
+                                           (100.0 * matM.nnz()) / (double(matM.numR()) * matM.numC()));
 
     const double eps = 1E-6;
 
@@ -510,16 +522,18 @@ void demoRMLP(PRNG* rng) {
         return (2 * norm(x - y)) / (norm(x) + norm(y));
     };
 
-    auto processRslt = [N, sfe, matM, matQ, eps]
+    auto processRslt = [N, sfe, &matM, &matQ, eps, showAll]
     (tuple<KMatrix, unsigned int, KMatrix> r) {
         KMatrix u = get<0>(r);
         unsigned int iter = get<1>(r);
         KMatrix res = get<2>(r);
         LOG(INFO) << "After" << iter << "iterations";
-        LOG(INFO) << "  LCP solution u:  ";
-        trans(u).mPrintf(" %+.3f ");
-        LOG(INFO) << "  LCP residual r:  ";
-        trans(res).mPrintf(" %+.3f ");
+        if (showAll) {
+            LOG(INFO) << "  LCP solution u:  ";
+            trans(u).mPrintf(" %+.3f ");
+            LOG(INFO) << "  LCP residual r:  ";
+            trans(res).mPrintf(" %+.3f ");
+        }
         LOG(INFO) << "Dimensions: " << res.numR();
         KMatrix v = matM*u + matQ;
         double tol = 100 * eps;
@@ -533,15 +547,14 @@ void demoRMLP(PRNG* rng) {
             return u(i, 0);
         };
         auto x = KMatrix::map(sFn, N, 1);
-        LOG(INFO) << "  LP solution x:  ";
-        trans(x).mPrintf(" %+.3f ");
+        if (showAll) {
+            LOG(INFO) << "  LP solution x:  ";
+            trans(x).mPrintf(" %+.3f ");
+        }
         return x;
     };
 
     auto start = joinV(rmlp->xInit, KMatrix(M, 1));
-    auto F = [matM, matQ](const KMatrix & x) {
-        return (matM*x + matQ);
-    };
 
     if (true) {
         try {
@@ -553,6 +566,14 @@ void demoRMLP(PRNG* rng) {
             const double rsrc1 = dot(x1, rmlp->rCosts);
             LOG(INFO) << KBase::getFormattedString("Minimized resource usage: %10.2f", rsrc1);
             LOG(INFO) << KBase::getFormattedString("Percentage change %+.3f", (100.0*(rsrc1 - rsrc0) / rsrc0));
+
+            // raise the cost of the first product by 10%, then re-solve
+            // from the previous solution rather than from scratch
+            auto matQ2 = matQ;
+            matQ2(0, 0) = 1.10 * matQ(0, 0);
+            auto rw = viBSHe96(matM, matQ2, KBase::projPos, get<0>(r1), eps, iterLim);
+            LOG(INFO) << KBase::getFormattedString("With 10%% higher cost for product 0, warm start took %u iterations",
+                                                   get<1>(rw));
         }
         catch (...) {
             LOG(INFO) << "Caught exception";
@@ -562,7 +583,7 @@ void demoRMLP(PRNG* rng) {
     if (true) {
         try {
             LOG(INFO) << "Solve via AEG";
-            auto r2 = viABG(start, F, KBase::projPos, 0.5, eps, iterLim, true);
+            auto r2 = viABG(start, matM, matQ, KBase::projPos, 0.5, eps, iterLim, true);
             auto x2 = processRslt(r2);
             LOG(INFO) << KBase::getFormattedString("Initial resource usage:   %10.2f", rsrc0);
             const double rsrc2 = dot(x2, rmlp->rCosts);
@@ -577,7 +598,7 @@ void demoRMLP(PRNG* rng) {
     if (true) { //  exceeds the iteration limit much more often than BSHe96
         try {
             LOG(INFO) << "Solve via ABG";
-            auto r2 = viABG(start, F, KBase::projPos, 0.5, eps, iterLim, false);
+            auto r2 = viABG(start, matM, matQ, KBase::projPos, 0.5, eps, iterLim, false);
             auto x2 = processRslt(r2);
             LOG(INFO) << KBase::getFormattedString("Initial resource usage:   %10.2f", rsrc0);
             const double rsrc2 = dot(x2, rmlp->rCosts);
@@ -608,6 +629,7 @@ int main(int ac, char **av) {
 
     bool waterMinP = false;
     bool rmlpP = false;
+    unsigned int numProd = 20;
     uint64_t seed = dSeed;
     bool run = true;
 
@@ -619,6 +641,7 @@ int main(int ac, char **av) {
         printf("Usage: specify one or more of these options\n");
         printf("--waterMin   minimize RMS error in probabilities\n");
         printf("--rmlp       demo resource-minimizing linear program\n");
+        printf("--numProd <n> number of products in the --rmlp demo; default 20\n");
         printf("--help       print this message\n");
         printf("--seed <n>   set a 64bit seed\n");
         printf("             0 means truly random\n");
@@ -637,6 +660,10 @@ int main(int ac, char **av) {
             else if (strcmp(av[i], "--rmlp") == 0) {
                 rmlpP = true;
             }
+            else if (strcmp(av[i], "--numProd") == 0) {
+                i++;
+                numProd = std::stoul(av[i]);
+            }
             else if (strcmp(av[i], "--help") == 0) {
                 run = false;
             }
@@ -661,7 +688,7 @@ int main(int ac, char **av) {
         DemoWaterMin::waterMin();
     }
     if (rmlpP) {
-        DemoWaterMin::demoRMLP(rng);
+        DemoWaterMin::demoRMLP(rng, numProd);
     }
 
     delete rng;
@@ -36,6 +36,7 @@
 #include "kutils.h"
 #include "prng.h"
 #include "kmatrix.h"
+#include "ksparse.h"
 #include "gaopt.h"
 #include "hcsearch.h"
 #include "kmodel.h"
@@ -48,6 +49,7 @@ using std::tuple;
 using std::vector;
 
 using KBase::KMatrix;
+using KBase::KSparse;
 using KBase::PRNG;
 
 using KBase::Actor;
@@ -136,7 +138,11 @@ public:
   RsrcMinLP();
   virtual ~RsrcMinLP();
   static RsrcMinLP* makeRMLP(PRNG* rng, unsigned int numPd, unsigned int numPt, unsigned int numSD);
-  tuple<KMatrix, KMatrix> makeMq() const;
+  // constraints as A*x >= b, x >= 0, with one row per constraint of types 1-3
+  tuple<KSparse, KMatrix> makeAb() const;
+  // the LP as a linear complementarity problem on [x; y],
+  // M = [0, -A'; A, 0] and q = [c; -b], which is mostly zeros
+  tuple<KSparse, KMatrix> makeMq() const;
 
   unsigned int numProd = 0; // number of products
   KMatrix xInit = KMatrix();
@@ -130,6 +130,11 @@ void PMatrixModel::setPMatrix(const KMatrix & pm0) {
   // if all OK, set it
   polUtilMat = pm0;
 
+  // states already made may have indexed the old utilities
+  for (auto s : history) {
+    ((const EState<unsigned int>*)s)->clearSimilarityIndex();
+  }
+
   return;
 }
 
@@ -454,7 +459,7 @@ EState<unsigned int>* PMatrixState::makeNewEState() const {
 
 VUI PMatrixState::similarPol(unsigned int ti, unsigned int nSim) const {
   auto pmm = (const PMatrixModel*)(eMod);
-  auto uMat = pmm->getPolUtilMat();
+  const auto& uMat = pmm->getPolUtilMat();
   VUI sdk = powerWeightedSimilarity(uMat,  ti,  nSim);
   return sdk;
   /*
@@ -472,7 +477,7 @@ vector<double> PMatrixState::actorUtilVectFn(int h, int tj) const {
   // no difference in perspective for this demo
   const unsigned int na = eMod->numAct;
   const auto pMod = (const PMatrixModel*)eMod;
-  const auto pMat = pMod->getPolUtilMat();
+  const auto& pMat = pMod->getPolUtilMat();
   assert(na == pMat.numR());
   assert(0 <= tj);
   assert(tj < pMat.numC());
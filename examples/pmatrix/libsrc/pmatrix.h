@@ -87,7 +87,7 @@ public:
     return wghtVect; // row vector
   };
 
-  KMatrix getPolUtilMat() const {
+  const KMatrix& getPolUtilMat() const {
     return polUtilMat; // rectangular
   };
 
@@ -293,6 +293,11 @@ void RP2Model::setRP2(const KMatrix & pm0) {
   // if all OK, set it
   polUtilMat = pm0;
 
+  // states already made may have indexed the old utilities
+  for (auto s : history) {
+    ((const EState<unsigned int>*)s)->clearSimilarityIndex();
+  }
+
   return;
 }
 
@@ -366,7 +371,7 @@ RP2State::~RP2State() {
 
 VUI RP2State::similarPol(unsigned int ti, unsigned int nSim) const {
   auto rp2m = (const RP2Model*)(eMod);
-  auto uMat = rp2m->getPolUtilMat();
+  const auto& uMat = rp2m->getPolUtilMat();
   VUI sdk = powerWeightedSimilarity(uMat,  ti,  nSim);
   return sdk;
 }
@@ -383,7 +388,7 @@ vector<double> RP2State::actorUtilVectFn(int h, int tj) const {
   // no difference in perspective for this demo
   const unsigned int na = eMod->numAct;
   const auto pMod = (const RP2Model*)eMod;
-  const auto pMat = pMod->getPolUtilMat();
+  const auto& pMat = pMod->getPolUtilMat();
   assert(na == pMat.numR());
   assert(0 <= tj);
   assert(tj < pMat.numC());
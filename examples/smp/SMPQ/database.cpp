@@ -22,6 +22,7 @@
 // -------------------------------------------------
 
 #include "database.h"
+#include <cmath>
 
 Database::Database()
 {
@@ -44,6 +45,8 @@ Database::Database()
 
 Database::~Database()
 {
+    dropScenarioCache();
+    reapCacheLoaders(true);
     if(qry != nullptr) {
         delete qry;
         qry = nullptr;
@@ -73,9 +76,12 @@ void Database::openDB(QString dbPath, QString dbType, QString connectionString,
 {
     if(dbType == "QSQLITE")
     {
+        dropScenarioCache();
         addDatabase(dbType);
         db->setDatabaseName(dbPath);
         dbName=dbPath;
+        dbUser.clear();
+        dbPwd.clear();
 
         if(!db->open())
         {
@@ -87,6 +93,7 @@ void Database::openDB(QString dbPath, QString dbType, QString connectionString,
         {
             // Scenarios list in db
             getScenarioList(run);
+            loadScenarioCache(scenarioM);
 
             getActorsDescriptionDB();
 
@@ -104,6 +111,7 @@ void Database::openDB(QString dbPath, QString dbType, QString connectionString,
     }
     else if (dbType == "QPSQL")
     {
+        dropScenarioCache();
         addDatabase(dbType);
         db->setDatabaseName(dbPath);
         dbName=dbPath;
@@ -148,9 +156,12 @@ void Database::openDB(QString dbPath, QString dbType, QString connectionString,
             else
             {
                 qry = new QSqlQuery(*db);
+                dbUser = uId;
+                dbPwd = pwd;
 
                 // Scenarios list in db
                 getScenarioList(run);
+                loadScenarioCache(scenarioM);
 
                 getActorsDescriptionDB();
 
@@ -244,6 +255,7 @@ void Database::checkPostgresDB(QString connectionString, bool imp)
 void Database::getScenarioData(int turn, QString scenario,int dim)
 {
     scenarioM=scenario;
+    loadScenarioCache(scenarioM);
     //model parameters for current scenario
     getModelParameters();
 
@@ -280,7 +292,19 @@ void Database::getActorsDescriptionDB()
     actorNameList.clear();
     actorDescList.clear();
 
-    QString query= QString("select Name,'DESC' from ActorDescription  where ScenarioId = '%1' ").arg(scenarioM);
+    const ScenarioCache * sc = cacheFor(scenarioM);
+    if(nullptr != sc)
+    {
+        for(int a = 0; a < sc->numActors; ++a)
+        {
+            actorNameList.append(sc->actorNames.at(a));
+            actorDescList.append(sc->actorDescs.at(a));
+        }
+        emit actorsNameDesc(actorNameList , actorDescList);
+        return;
+    }
+
+    QString query= QString("select Name, \"Desc\" from ActorDescription where ScenarioId = '%1' order by Act_i").arg(scenarioM);
 
     qry->exec(query);
 
@@ -297,6 +321,21 @@ void Database::getInfluenceDB(int turn)
 {
     actorInfluence.clear();
 
+    const ScenarioCache * sc = cacheFor(scenarioM);
+    if(nullptr != sc && turn < sc->numTurns)
+    {
+        for(int a = 0; a < sc->numActors; ++a)
+        {
+            const double c = sc->capability(turn, a);
+            if(!std::isnan(c))
+            {
+                actorInfluence.append(QVariant(c).toString());
+            }
+        }
+        emit actorsInflu(actorInfluence);
+        return;
+    }
+
     //qDebug()<<scenario_m << "turn" << turn ;
     QString query= QString(" select SpatialCapability.Cap from SpatialCapability,ActorDescription where "
                            " ActorDescription.Act_i = SpatialCapability.Act_i "
@@ -319,6 +358,21 @@ void Database::getInfluenceDB(int turn)
 void Database::getPositionDB(int dim, int turn)
 {
     actorPosition.clear();
+
+    const ScenarioCache * sc = cacheFor(scenarioM);
+    if(nullptr != sc && turn < sc->numTurns && dim < sc->numDims)
+    {
+        for(int a = 0; a < sc->numActors; ++a)
+        {
+            if(sc->hasPosition(turn, a, dim))
+            {
+                actorPosition.append(QVariant(sc->position(turn, a, dim)).toString());
+            }
+        }
+        if(actorPosition.length()>0)
+            emit actorsPostn(actorPosition,dim);
+        return;
+    }
     //qDebug()<<scenario_m;
 
     QString query= QString(" select VectorPosition.Pos_Coord from VectorPosition,ActorDescription where"
@@ -343,6 +397,21 @@ void Database::getPositionDB(int dim, int turn)
 void Database::getSalienceDB(int dim, int turn)
 {
     actorSalience.clear();
+
+    const ScenarioCache * sc = cacheFor(scenarioM);
+    if(nullptr != sc && turn < sc->numTurns && dim < sc->numDims)
+    {
+        for(int a = 0; a < sc->numActors; ++a)
+        {
+            const double s = sc->salience(turn, a, dim);
+            if(!std::isnan(s))
+            {
+                actorSalience.append(QVariant(s).toString());
+            }
+        }
+        emit actorsSalnce(actorSalience,dim);
+        return;
+    }
     //qDebug()<<scenario_m;
 
     QString query= QString(" select SpatialSalience.Sal from SpatialSalience,ActorDescription where"
@@ -390,6 +459,29 @@ void Database::getActorsInRangeFromDB(double lowerRng, double higherRng, int dim
     actorSalienceList.clear();
     actorCapabilityList.clear();
 
+    const ScenarioCache * sc = cacheFor(scenarioM);
+    if(nullptr != sc && turn < sc->numTurns && dim < sc->numDims)
+    {
+        for(int a = 0; a < sc->numActors; ++a)
+        {
+            if(!sc->hasPosition(turn, a, dim))
+                continue;
+            const double p = sc->position(turn, a, dim);
+            if(p >= lwr && p < upr)
+            {
+                actorIdsList.append(a);
+                const double s = sc->salience(turn, a, dim);
+                if(!std::isnan(s))
+                    actorSalienceList.append(s);
+                const double c = sc->capability(turn, a);
+                if(!std::isnan(c))
+                    actorCapabilityList.append(c);
+            }
+        }
+        emit listActorsSalienceCapability(actorIdsList,actorSalienceList,actorCapabilityList,lwr,upr);
+        return;
+    }
+
     QString query= QString(" select Act_i from VectorPosition where"
                            " Pos_Coord >= '%1'  AND Pos_Coord < '%2' AND "
                            " Dim_k='%3' AND ScenarioId='%4' "
@@ -476,6 +568,7 @@ void Database::getUtilChlgAndSQvalues(QVector<int> VHAxisValues)
 
 void Database::releaseDB()
 {
+    dropScenarioCache();
     if(db != nullptr) {
         if(db->open()) {
             db->close();
@@ -540,6 +633,25 @@ void Database::getVectorPosition(int actor, int dim, int turn, QString scenario)
     int i =0;
     QVector<double> x(numStates+1), y(numStates+1);
 
+    const ScenarioCache * sc = cacheFor(scenario);
+    if(nullptr != sc)
+    {
+        for(int t = 0; t <= turn && t < sc->numTurns && i < x.size(); ++t)
+        {
+            if(sc->hasPosition(t, actor, dim))
+            {
+                x[i]=t;
+                y[i]=sc->position(t, actor, dim);// y scales from 0 to 100
+                ++i;
+            }
+        }
+        QString actorName;
+        if(0 <= actor && actor < sc->numActors)
+            actorName = sc->actorNames.at(actor);
+        emit vectorPosition(x,y,actorName,turn);
+        return;
+    }
+
     query= QString("select * from VectorPosition where Act_i='%1' and Dim_k='%2' and Turn_t<='%3' and  ScenarioId = '%4' ")
             .arg(actor).arg(dim).arg(turn).arg(scenario);
 
@@ -579,13 +691,30 @@ void Database::readVectorPositionTable(int turn, QString scenario, int dim)
     sqlmodel = new QStandardItemModel(this);
     QString query;
 
-    query= QString("select * from VectorPosition where Turn_t='%1' and Dim_k='%2' and ScenarioId='%3'")
-            .arg(turn).arg(dim).arg(scenario);
+    int rowindex =0;
+    const ScenarioCache * sc = cacheFor(scenario);
+    if(nullptr != sc)
+    {
+        // the same (ScenarioId, Turn_t) rows the query below returns
+        for(int a = 0; a < sc->numActors; ++a)
+        {
+            if(sc->hasPosition(turn, a, dim))
+            {
+                sqlmodel->setItem(rowindex,0,new QStandardItem(scenario.trimmed()));
+                sqlmodel->setItem(rowindex,1,new QStandardItem(QString::number(turn)));
+                ++rowindex;
+            }
+        }
+    }
+    else
+    {
+        query= QString("select * from VectorPosition where Turn_t='%1' and Dim_k='%2' and ScenarioId='%3'")
+                .arg(turn).arg(dim).arg(scenario);
 
-    qry->exec(query);
+        qry->exec(query);
+    }
 
-    int rowindex =0;
-    while(qry->next())
+    while(nullptr == sc && qry->next())
     {
         QString value = qry->value(0).toString();
         QString value1 = qry->value(1).toString();
@@ -643,6 +772,14 @@ void Database::getDatabaseList(bool imp, QString &connectionName)
 
 void Database::getNumActors()
 {
+    const ScenarioCache * sc = cacheFor(scenarioM);
+    if(nullptr != sc)
+    {
+        numActors = sc->numActors - 1; // the last Act_i
+        emit actorCount(numActors);
+        return;
+    }
+
     QString query= QString("select Act_i from ActorDescription where ScenarioId='%1'" )
             .arg(scenarioM);
 
@@ -658,6 +795,14 @@ void Database::getNumActors()
 
 void Database::getNumStates()
 {
+    const ScenarioCache * sc = cacheFor(scenarioM);
+    if(nullptr != sc)
+    {
+        numStates = sc->numTurns - 1; // the last Turn_t
+        emit statesCount(numStates);
+        return;
+    }
+
     QString query= QString("select DISTINCT Turn_t from VectorPosition where ScenarioId='%1'" )
             .arg(scenarioM);
 
@@ -712,6 +857,117 @@ void Database::getScenarioList(bool run)
 
 }
 
+void Database::loadScenarioCache(QString scenario)
+{
+    if(db == nullptr || !db->isOpen() || scenario.isEmpty())
+    {
+        return;
+    }
+    if(scenario == cacheScenario)
+    {
+        return; // loaded, or on its way
+    }
+    reapCacheLoaders(false);
+    cacheScenario = scenario;
+    unsigned int gen = 0;
+    {
+        std::lock_guard<std::mutex> lk(cacheLock);
+        gen = ++cacheGen;
+    }
+
+    // Qt connections belong to the thread that opens them, so the loader
+    // opens its own one with the same settings
+    const QString driver = db->driverName();
+    const QString dbN = db->databaseName();
+    const QString host = db->hostName();
+    const int port = db->port();
+    const QString user = dbUser;
+    const QString pwd = dbPwd;
+
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    auto loader = std::thread([this, gen, scenario, driver, dbN, host, port, user, pwd, done]()
+    {
+        auto sc = std::make_shared<ScenarioCache>();
+        bool ok = false;
+        const QString cn = QString("guiDbCache%1").arg(gen);
+        {
+            QSqlDatabase cdb = QSqlDatabase::addDatabase(driver, cn);
+            cdb.setDatabaseName(dbN);
+            if(!host.isEmpty())
+                cdb.setHostName(host);
+            if(0 < port)
+                cdb.setPort(port);
+            if(user.isEmpty() ? cdb.open() : cdb.open(user, pwd))
+            {
+                ok = sc->load(cdb, scenario);
+                cdb.close();
+            }
+        }
+        QSqlDatabase::removeDatabase(cn);
+
+        if(ok)
+        {
+            std::lock_guard<std::mutex> lk(cacheLock);
+            if(gen == cacheGen)
+                pendingCache = sc;
+        }
+        QMetaObject::invokeMethod(this, "installCache", Qt::QueuedConnection);
+        done->store(true);
+    });
+    cacheLoaders.push_back(CacheLoader{std::move(loader), done});
+}
+
+void Database::reapCacheLoaders(bool wait)
+{
+    auto running = std::vector<CacheLoader>();
+    for(auto &cl : cacheLoaders)
+    {
+        if(wait || cl.done->load())
+        {
+            cl.thread.join(); // immediate, unless waiting
+        }
+        else
+        {
+            running.push_back(std::move(cl));
+        }
+    }
+    cacheLoaders = std::move(running);
+}
+
+void Database::installCache()
+{
+    std::shared_ptr<const ScenarioCache> sc;
+    {
+        std::lock_guard<std::mutex> lk(cacheLock);
+        sc = pendingCache;
+        pendingCache.reset();
+    }
+    if(sc != nullptr && sc->scenario == scenarioM)
+    {
+        cache = sc;
+        emit scenarioCached(sc->scenario);
+    }
+}
+
+void Database::dropScenarioCache()
+{
+    reapCacheLoaders(false);
+    std::lock_guard<std::mutex> lk(cacheLock);
+    ++cacheGen;
+    pendingCache.reset();
+    cache.reset();
+    cacheScenario.clear();
+}
+
+const ScenarioCache * Database::cacheFor(const QString &scenario) const
+{
+    if(cache != nullptr && cache->scenario == scenario)
+    {
+        return cache.get();
+    }
+    return nullptr;
+}
+
 void Database::getModelParameters()
 {
     scenarioModelParam.clear();
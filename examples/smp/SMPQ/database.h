@@ -31,6 +31,12 @@
 #include <QMessageBox>
 #include <QSqlError>
 #include <QStandardItemModel>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "scenariocache.h"
 
 class Database : public QObject
 {
@@ -98,6 +104,13 @@ signals:
 
     //ActorMoved
     void actorMovedInfo(QStandardItemModel *);
+
+    //Scenario cache loaded and in use
+    void scenarioCached(QString scenario);
+
+private slots:
+    void installCache();
+
 private:
     QSqlDatabase *db = nullptr;
     QString dbName;
@@ -145,6 +158,31 @@ private:
 
     void getVectorPosition(int actor, int dim, int turn, QString scenario);
 
+    // In-memory copy of the current scenario, loaded on a background thread
+    // with its own connection; until it arrives, everything reads from db.
+    std::shared_ptr<const ScenarioCache> cache;
+    std::shared_ptr<const ScenarioCache> pendingCache;
+    std::mutex cacheLock;
+    unsigned int cacheGen = 0;
+    // Loaders are never waited for on the GUI thread: a stale one runs to the
+    // end in the background (its result is discarded by cacheGen), and is joined
+    // once finished, or in the destructor.
+    struct CacheLoader
+    {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::vector<CacheLoader> cacheLoaders;
+    void reapCacheLoaders(bool wait);
+    QString cacheScenario;
+    QString dbUser;
+    QString dbPwd;
+
+    void loadScenarioCache(QString scenario);
+    void dropScenarioCache();
+    // the cache, if it is loaded and for this scenario
+    const ScenarioCache * cacheFor(const QString &scenario) const;
+
     //Default read Turn_t=0
     void readVectorPositionTable(int state, QString scenario, int dim);
 
@@ -178,6 +178,7 @@ MainWindow::MainWindow()
 
 MainWindow::~MainWindow()
 {
+    deleteAsyncRun();
     if(dbObj != nullptr) {
         delete dbObj;
     }
@@ -42,6 +42,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <chrono>
 #include <fstream>
 #include <string>
 #include <QDateTime>
@@ -57,6 +58,10 @@
 #include <QtGlobal>
 #include <easylogging++.h>
 
+namespace SMPLib {
+class SMPAsyncRun;
+}
+
 class QAction;
 class QVectorWidget;
 class QMenu;
@@ -414,9 +419,18 @@ private :
     void getParametersValues();
     //    QStandardItemModel *initializeComboBox(int rows, QStringList items);
 
+    // a model run in progress; its turns are drawn on the line plot as they arrive
+    SMPLib::SMPAsyncRun * asyncRun = nullptr;
+    QTimer * runPollTimer = nullptr;
+    QString runFileName;
+    std::chrono::time_point<std::chrono::system_clock> runStartTime;
+    void plotRunTurn(unsigned int turn, const QVector<double> &pos);
+    void deleteAsyncRun();
+
 private slots :
     void runPushButtonClicked(bool bl);
     void runModel(QString conStr,QString fileName =0);
+    void pollModelRun();
     void smpDBPath(QString smpdbPath);
     void disableRunButton(QTableWidgetItem * itm);
 
@@ -331,6 +331,11 @@ void MainWindow::getUtilChlgHorizontalVerticalAxisData(int turn)
     deltaUtilV.clear();
     deltaUtilH.clear();
 
+    if(asyncRun != nullptr) // md0 belongs to the running model
+    {
+        return;
+    }
+
     int affK=0;
     int estH=0;
     int initI=0;
@@ -343,108 +348,72 @@ void MainWindow::getUtilChlgHorizontalVerticalAxisData(int turn)
         initiatorTip=initI;
     }
 
+    // all the checked receivers are computed together, one slice of PosUtil per redraw
+    std::vector<size_t> rcvrs;
     for(int recdJ =0; recdJ < actorsName.length(); ++recdJ)
     {
         if(true==quadMapReceiversCheckBoxList.at(recdJ)->isChecked()
                 && true == quadMapReceiversCheckBoxList.at(recdJ)->isVisible())
         {
-            if(0==perspectiveComboBox->currentIndex()) // initiators
-            {
-                VHAxisValues.clear();
-                estH=affK=initI;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-
-                estH=initI;
-                affK=recdJ;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-            }
-            else if(1==perspectiveComboBox->currentIndex()) // receivers
-            {
-                VHAxisValues.clear();
-                affK=initI;
-                estH=recdJ;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-
-                estH=affK=recdJ;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-            }
-            else if(2==perspectiveComboBox->currentIndex()) //objective
-            {
-                VHAxisValues.clear();
-                estH=affK=initI;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-
-                estH=affK=recdJ;
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-            }
-            else //others
-            {
-                VHAxisValues.clear();
+            rcvrs.push_back(recdJ);
+        }
+    }
+    if(rcvrs.empty())
+        return;
+
+    // (estimator, affected) for the vertical and horizontal axes;
+    // quadMapRcvr stands for each receiver in turn
+    const size_t rcvr = SMPLib::SMPModel::quadMapRcvr;
+    size_t estHV, affKV, estHH, affKH;
+    if(0==perspectiveComboBox->currentIndex()) // initiators
+    {
+        estHV=affKV=initI;
+        estHH=initI;
+        affKH=rcvr;
+    }
+    else if(1==perspectiveComboBox->currentIndex()) // receivers
+    {
+        affKV=initI;
+        estHV=rcvr;
+        estHH=affKH=rcvr;
+    }
+    else if(2==perspectiveComboBox->currentIndex()) //objective
+    {
+        estHV=affKV=initI;
+        estHH=affKH=rcvr;
+    }
+    else //others
+    {
+        affK=initI;
+        estH=vComboBox->currentIndex()-1; // -1, actors index starts from 1 not zero, only here.
 
-                affK=initI;
-                estH=vComboBox->currentIndex()-1; // -1, actors index starts from 1 not zero, only here.
+        if(estH<0)
+            return;
 
-                if(estH<0)
-                    return;
+        estHV=estHH=estH;
+        affKV=affKH=affK;
+    }
 
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
+    std::vector<size_t> estHs = SMPLib::SMPModel::quadMapEstimators(estHV, rcvrs);
+    for(size_t h : SMPLib::SMPModel::quadMapEstimators(estHH, rcvrs))
+        estHs.push_back(h);
 
-                VHAxisValues.append(turn);
-                VHAxisValues.append(estH);
-                VHAxisValues.append(affK);
-                VHAxisValues.append(initI);
-                VHAxisValues.append(recdJ);
-            }
-            //            emit getUtilChlgAndUtilSQfromDB(VHAxisValues);
-            double x,y;
-            if(useHistory)
-            {
-                y =SMPLib::SMPModel::getQuadMapPoint(VHAxisValues.at(0),VHAxisValues.at(1),VHAxisValues.at(2),
-                                                     VHAxisValues.at(3),VHAxisValues.at(4));
-                x =SMPLib::SMPModel::getQuadMapPoint(VHAxisValues.at(5),VHAxisValues.at(6),VHAxisValues.at(7),
-                                                     VHAxisValues.at(8),VHAxisValues.at(9));
-            }
-            else
-            {
-                QString connectionName = dbObj->getConnectionName();
-                y =SMPLib::SMPModel::getQuadMapPoint(connectionName,scenarioBox.toStdString(),VHAxisValues.at(0),
-                                                     VHAxisValues.at(1),VHAxisValues.at(2),VHAxisValues.at(3),
-                                                     VHAxisValues.at(4));
-                x =SMPLib::SMPModel::getQuadMapPoint(connectionName,scenarioBox.toStdString(),VHAxisValues.at(5),
-                                                     VHAxisValues.at(6),VHAxisValues.at(7),VHAxisValues.at(8),
-                                                     VHAxisValues.at(9));
-            }
+    SMPLib::QuadMapSlice qs;
+    if(useHistory)
+    {
+        qs = SMPLib::SMPModel::quadMapSlice(turn, estHs);
+    }
+    else
+    {
+        QString connectionName = dbObj->getConnectionName();
+        qs = SMPLib::SMPModel::quadMapSlice(connectionName, scenarioBox.toStdString(), turn, estHs);
+    }
+    const std::vector<double> y = SMPLib::SMPModel::quadMapPoints(qs, estHV, affKV, initI, rcvrs);
+    const std::vector<double> x = SMPLib::SMPModel::quadMapPoints(qs, estHH, affKH, initI, rcvrs);
 
-            quadMapUtilChlgandSQValues(VHAxisValues.at(0),x,y,VHAxisValues.at(4));
-        }
+    for(size_t n = 0; n < rcvrs.size(); ++n)
+    {
+        quadMapUtilChlgandSQValues(turn,x[n],y[n],rcvrs[n]);
     }
 }
 
@@ -232,6 +232,13 @@ void MainWindow::dbDonePushButtonClicked(bool bl)
 void MainWindow::runPushButtonClicked(bool bl)
 {
     Q_UNUSED(bl)
+    if(asyncRun != nullptr) // the button reads STOP while a model runs
+    {
+        asyncRun->cancel();
+        runButton->setEnabled(false);
+        statusBar()->showMessage("Stopping SMP after the current turn ....");
+        return;
+    }
     importedDBFile=false;
     if(connectionString.isEmpty())
     {
@@ -312,16 +319,13 @@ void MainWindow::runModel(QString conStr, QString fileName)
 
         statusBar()->showMessage(" Please wait !! Executing SMP ....  This may take a while ....");
 
-        QApplication::setOverrideCursor(QCursor(QPixmap("://images/hourglass.png")));
-        QApplication::processEvents();
-
         //get parameters from GUI
         getParametersValues();
 
         // A code snippet from Demosmp.cpp to run the model
 
         using KBase::dSeed;
-        auto sTime = KBase::displayProgramStart(DemoSMP::appName, DemoSMP::appVersion);
+        runStartTime = KBase::displayProgramStart(DemoSMP::appName, DemoSMP::appVersion);
         uint64_t seed = dSeed;
 
         //Collect flags and Data from GUI
@@ -361,37 +365,31 @@ void MainWindow::runModel(QString conStr, QString fileName)
         //        printf("Using PRNG seed:  %020llu \n", seed);
         //        printf("Same seed in hex:   0x%016llX \n", seed);
 
-        if(savedAsXml==true)
-        {
-            //            currentScenarioId =QString::fromStdString(SMPLib::SMPModel::runModel
-            //                                                      (sqlFlags, dbFilePath.toStdString(),
-            //                                                       xmlPath.toStdString(),seed,false,parameters));
-            SMPLib::SMPModel::loginCredentials(connectDBString.toStdString());
-
-            currentScenarioId =QString::fromStdString(SMPLib::SMPModel::runModel
-                                                      (sqlFlags,
-                                                       xmlPath.toStdString(),seed,false,parameters));
-        }
-        else
-        {
-            //            currentScenarioId =QString::fromStdString(SMPLib::SMPModel::runModel
-            //                                                      (sqlFlags, dbFilePath.toStdString(),
-            //                                                       csvPath.toStdString(),seed,false,parameters));
-
-            SMPLib::SMPModel::loginCredentials(connectDBString.toStdString());
+        SMPLib::SMPModel::loginCredentials(connectDBString.toStdString());
 
-            currentScenarioId =QString::fromStdString(SMPLib::SMPModel::runModel
-                                                      (sqlFlags,
-                                                       csvPath.toStdString(),seed,false,parameters));
-        }
+        // the model runs on a worker thread, and pollModelRun draws each turn as it
+        // arrives, so the window stays live and the run can be stopped early
+        QString inputPath = (savedAsXml==true) ? xmlPath : csvPath;
+        runFileName = fileName;
 
-        KBase::displayProgramEnd(sTime);
+        // the worker replaces md0 and grows its history, so nothing may read them
+        // until pollModelRun has joined it
+        useHistory=false;
+        quadMapDock->setEnabled(false);
 
-        QApplication::restoreOverrideCursor();
+        asyncRun = new SMPLib::SMPAsyncRun();
+        asyncRun->start(sqlFlags, inputPath.toStdString(), seed, parameters);
 
-        statusBar()->showMessage(" Process Completed !! ");
+        runButton->setText("STOP");
+        runButton->setToolTip("Stop the model after the current turn");
+        runButton->setEnabled(true);
 
-        smpDBPath(fileName);
+        if(runPollTimer == nullptr)
+        {
+            runPollTimer = new QTimer(this);
+            connect(runPollTimer,SIGNAL(timeout()),this,SLOT(pollModelRun()));
+        }
+        runPollTimer->start(100);
     }
     else
     {
@@ -403,6 +401,98 @@ void MainWindow::runModel(QString conStr, QString fileName)
     }
 }
 
+void MainWindow::pollModelRun()
+{
+    if(asyncRun == nullptr)
+    {
+        return;
+    }
+
+    // check first, so that no snapshot can arrive after the final drain
+    const bool done = asyncRun->isDone();
+
+    SMPLib::TurnSnapshot ts;
+    bool newTurns = false;
+    while(asyncRun->nextSnapshot(ts))
+    {
+        const int dim = (lineGraphDimensionComboBox->currentIndex() >= 0 &&
+                         lineGraphDimensionComboBox->currentIndex() < int(ts.pstns.numC()))
+                ? lineGraphDimensionComboBox->currentIndex() : 0;
+        QVector<double> pos;
+        double maxProb = 0.0;
+        for(unsigned int i = 0; i < ts.pstns.numR(); ++i)
+        {
+            pos.append(ts.pstns(i, dim) * 100.0);
+            maxProb = (ts.prob(i, 0) > maxProb) ? ts.prob(i, 0) : maxProb;
+        }
+        plotRunTurn(ts.turn, pos);
+        newTurns = true;
+
+        QString msg = QString("Executing SMP .... turn %1, highest win probability %2")
+                .arg(ts.turn).arg(maxProb, 0, 'f', 4);
+        if(ts.last)
+        {
+            msg = QString("SMP stopped at turn %1 (%2), saving results ....")
+                    .arg(ts.turn).arg(QString::fromStdString(ts.stopReason));
+        }
+        statusBar()->showMessage(msg);
+    }
+    if(newTurns)
+    {
+        lineCustomGraph->rescaleAxes();
+        lineCustomGraph->replot();
+    }
+
+    if(done)
+    {
+        runPollTimer->stop();
+        const bool cancelled = asyncRun->isCancelled();
+        asyncRun->join();
+        currentScenarioId = QString::fromStdString(asyncRun->scenarioId());
+        deleteAsyncRun();
+        quadMapDock->setEnabled(true);
+
+        KBase::displayProgramEnd(runStartTime);
+
+        runButton->setText("RUN");
+        runButton->setToolTip("Run the model");
+        runButton->setEnabled(false);
+
+        statusBar()->showMessage(cancelled ? " Process Stopped !! " : " Process Completed !! ");
+
+        smpDBPath(runFileName);
+    }
+}
+
+void MainWindow::plotRunTurn(unsigned int turn, const QVector<double> &pos)
+{
+    if(turn == 0)
+    {
+        lineCustomGraph->clearGraphs();
+        for(int i = 0; i < pos.length(); ++i)
+        {
+            lineCustomGraph->addGraph();
+            if(i < colorsList.length())
+            {
+                lineCustomGraph->graph(i)->setPen(QPen(colorsList.at(i)));
+            }
+        }
+    }
+    for(int i = 0; i < pos.length() && i < lineCustomGraph->graphCount(); ++i)
+    {
+        lineCustomGraph->graph(i)->addData(turn, pos.at(i));
+    }
+}
+
+void MainWindow::deleteAsyncRun()
+{
+    if(asyncRun != nullptr)
+    {
+        delete asyncRun; // cancels an unfinished run and waits for it
+        asyncRun = nullptr;
+    }
+}
+
 void MainWindow::smpDBPath(QString smpdbPath)
 {
     useHistory=true;
@@ -818,6 +908,12 @@ void MainWindow::setDefaultParameters()
 
 void MainWindow::saveTurnHistoryToCSV()
 {
+    if(asyncRun != nullptr) // md0 belongs to the running model
+    {
+        statusBar()->showMessage("Turn History can be exported once the model run ends",2000);
+        return;
+    }
+
     SMPLib::SMPModel::loginCredentials(connectionString.toStdString());
 
     QString csvFileNameLocation = QFileDialog::getSaveFileName(
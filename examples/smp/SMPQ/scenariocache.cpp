@@ -0,0 +1,176 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+
+#include "scenariocache.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+struct CacheRow
+{
+    int turn;
+    int actor;
+    int dim;
+    double value;
+};
+
+// read (Turn_t, Act_i, [Dim_k,] value) rows, tracking the largest indices seen
+bool readRows(QSqlQuery &qry, const QString &query, bool withDim, QVector<CacheRow> &rows,
+              int &maxTurn, int &maxActor, int &maxDim)
+{
+    qry.setForwardOnly(true);
+    if(!qry.exec(query))
+    {
+        return false;
+    }
+    while(qry.next())
+    {
+        CacheRow r;
+        r.turn = qry.value(0).toInt();
+        r.actor = qry.value(1).toInt();
+        r.dim = withDim ? qry.value(2).toInt() : 0;
+        r.value = qry.value(withDim ? 3 : 2).toDouble();
+        if(r.turn < 0 || r.actor < 0 || r.dim < 0)
+        {
+            continue;
+        }
+        maxTurn = std::max(maxTurn, r.turn);
+        maxActor = std::max(maxActor, r.actor);
+        maxDim = std::max(maxDim, r.dim);
+        rows.append(r);
+    }
+    return true;
+}
+}
+
+bool ScenarioCache::load(QSqlDatabase db, const QString &scenarioId)
+{
+    scenario = scenarioId;
+    QSqlQuery qry(db);
+
+    int maxTurn = -1;
+    int maxActor = -1;
+    int maxDim = -1;
+
+    actorNames.clear();
+    actorDescs.clear();
+    qry.setForwardOnly(true);
+    if(!qry.exec(QString("select Act_i, Name, \"Desc\" from ActorDescription where ScenarioId='%1' order by Act_i")
+                 .arg(scenarioId)))
+    {
+        return false;
+    }
+    while(qry.next())
+    {
+        const int a = qry.value(0).toInt();
+        if(a < 0)
+        {
+            continue;
+        }
+        if(actorNames.size() <= a)
+        {
+            actorNames.resize(a + 1);
+            actorDescs.resize(a + 1);
+        }
+        actorNames[a] = qry.value(1).toString();
+        actorDescs[a] = qry.value(2).toString();
+        maxActor = std::max(maxActor, a);
+    }
+
+    QVector<CacheRow> posRows;
+    QVector<CacheRow> salRows;
+    QVector<CacheRow> capRows;
+    int capDim = -1; // capability has no dimension
+    if(!readRows(qry, QString("select Turn_t, Act_i, Dim_k, Pos_Coord from VectorPosition where ScenarioId='%1'")
+                 .arg(scenarioId), true, posRows, maxTurn, maxActor, maxDim)
+            || !readRows(qry, QString("select Turn_t, Act_i, Dim_k, Sal from SpatialSalience where ScenarioId='%1'")
+                         .arg(scenarioId), true, salRows, maxTurn, maxActor, maxDim)
+            || !readRows(qry, QString("select Turn_t, Act_i, Cap from SpatialCapability where ScenarioId='%1'")
+                         .arg(scenarioId), false, capRows, maxTurn, maxActor, capDim))
+    {
+        return false;
+    }
+
+    numTurns = maxTurn + 1;
+    numActors = maxActor + 1;
+    numDims = maxDim + 1;
+    actorNames.resize(numActors);
+    actorDescs.resize(numActors);
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    pos.fill(nan, numTurns * numActors * numDims);
+    sal.fill(nan, numTurns * numActors * numDims);
+    cap.fill(nan, numTurns * numActors);
+    for(const CacheRow &r : posRows)
+    {
+        pos[ndx(r.turn, r.actor, r.dim)] = r.value;
+    }
+    for(const CacheRow &r : salRows)
+    {
+        sal[ndx(r.turn, r.actor, r.dim)] = r.value;
+    }
+    for(const CacheRow &r : capRows)
+    {
+        cap[r.turn * numActors + r.actor] = r.value;
+    }
+    return true;
+}
+
+int ScenarioCache::ndx(int turn, int actor, int dim) const
+{
+    Q_ASSERT(0 <= turn && turn < numTurns);
+    Q_ASSERT(0 <= actor && actor < numActors);
+    Q_ASSERT(0 <= dim && dim < numDims);
+    return (turn * numActors + actor) * numDims + dim;
+}
+
+bool ScenarioCache::hasPosition(int turn, int actor, int dim) const
+{
+    if(turn < 0 || turn >= numTurns || actor < 0 || actor >= numActors || dim < 0 || dim >= numDims)
+    {
+        return false;
+    }
+    return !std::isnan(pos[ndx(turn, actor, dim)]);
+}
+
+double ScenarioCache::position(int turn, int actor, int dim) const
+{
+    return pos[ndx(turn, actor, dim)];
+}
+
+double ScenarioCache::salience(int turn, int actor, int dim) const
+{
+    return sal[ndx(turn, actor, dim)];
+}
+
+double ScenarioCache::capability(int turn, int actor) const
+{
+    Q_ASSERT(0 <= turn && turn < numTurns);
+    Q_ASSERT(0 <= actor && actor < numActors);
+    return cap[turn * numActors + actor];
+}
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
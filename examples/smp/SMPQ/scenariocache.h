@@ -0,0 +1,66 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// -------------------------------------------------
+
+#ifndef SCENARIOCACHE_H
+#define SCENARIOCACHE_H
+
+#include <QtSql>
+#include <QSqlQuery>
+#include <QVector>
+#include <QString>
+
+// All the per-turn actor data of one scenario, read with one query per table.
+// Values are indexed by (turn, actor, dim), or (turn, actor) for capability;
+// entries with no row in the database are NaN.
+class ScenarioCache
+{
+public:
+    // run the four table queries on db, which must be open on the calling thread
+    bool load(QSqlDatabase db, const QString &scenarioId);
+
+    QString scenario;
+    int numTurns = 0;
+    int numActors = 0;
+    int numDims = 0;
+
+    QVector<QString> actorNames;
+    QVector<QString> actorDescs;
+
+    bool hasPosition(int turn, int actor, int dim) const;
+    double position(int turn, int actor, int dim) const;
+    double salience(int turn, int actor, int dim) const;
+    double capability(int turn, int actor) const;
+
+private:
+    QVector<double> pos; // VectorPosition.Pos_Coord
+    QVector<double> sal; // SpatialSalience.Sal
+    QVector<double> cap; // SpatialCapability.Cap
+
+    int ndx(int turn, int actor, int dim) const;
+};
+
+#endif // SCENARIOCACHE_H
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
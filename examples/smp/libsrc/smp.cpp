@@ -26,10 +26,15 @@
 // --------------------------------------------
 
 #include "smp.h"
+#include <atomic>
+#include <chrono>
+#ifdef KTAB_QT_SQL
+#include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QVariant>
 #include <QSqlError>
 #include <QSqlRecord>
+#endif
 
 extern "C" {
   void configLogger(const char *cfgFile) {
@@ -44,6 +49,10 @@ extern "C" {
     }
   }
 
+  void profileTurns(const char *jsonFile) {
+    KBase::Model::profileTurns(std::string(nullptr != jsonFile ? jsonFile : ""));
+  }
+
   uint runSmpModel(char * buffer, const unsigned int buffsize, unsigned int sqlLogFlags[5], const char* inputDataFile,
     unsigned int seed, unsigned int saveHistory, int modelParams[9] = 0) {
 
@@ -102,6 +111,53 @@ using KBase::StateTransMode;
 using KBase::VotingRule;
 using KBase::PCEModel;
 using KBase::ReportingLevel;
+using KBase::FixVec;
+
+
+// --------------------------------------------
+// Fixed-dimension kernels. Each has a FixVec<N> form for 1 <= N <= maxFixDim,
+// chosen by a switch on the runtime dimension, and the callers keep
+// a general loop for higher dimensions. All of them accumulate in the
+// same order as the general loops, so results do not depend on the path.
+
+// weighted distance from r to p; asserts are left to the callers
+template <unsigned int N>
+double bvDiffFix(const double * r, const double * s, const double * p) {
+    const FixVec<N> rv(r);
+    const FixVec<N> sv(s);
+    return sqrt(rv.wDiffSqr(p, sv) / sv.sqrNorm());
+}
+
+// row i of dm = distances from row i of ref to each row of pts, weighted by row i of sal
+template <unsigned int N>
+void bvDiffRows(const double * r0, const double * s0, const double * p0,
+                unsigned int na, unsigned int np, const vector<double> & ssSqr, double * d0) {
+    for (unsigned int i = 0; i < na; i++) {
+        const FixVec<N> ri(r0 + i*N);
+        const FixVec<N> si(s0 + i*N);
+        double * di = d0 + i*np;
+        for (unsigned int j = 0; j < np; j++) {
+            di[j] = sqrt(ri.wDiffSqr(p0 + j*N, si) / ssSqr[i]);
+        }
+    }
+    return;
+}
+
+// row i of n0 = sum_j acc(i,j) * row j of p0, plus lag[i] * row i of i0
+template <unsigned int N>
+void blendRows(const double * a0, const double * p0, const double * i0,
+               const vector<double> & lag, unsigned int na, double * n0) {
+    for (unsigned int i = 0; i < na; i++) {
+        auto ni = FixVec<N>();
+        const double * ai = a0 + i*na;
+        for (unsigned int j = 0; j < na; j++) {
+            ni.addScaled(ai[j], p0 + j*N);
+        }
+        ni.addScaled(lag[i], i0 + i*N);
+        ni.copyTo(n0 + i*N);
+    }
+    return;
+}
 
 
 // --------------------------------------------
@@ -114,6 +170,18 @@ std::vector<string> SMPModel::dbFieldVals;
 // big enough buffer to build all desired SQLite statements
 const unsigned int sqlBuffSize = 250;
 
+// stopping criteria shared by configExec and ensembleExec
+const unsigned int stopMinIter = 2;
+const unsigned int stopMaxIter = 100;
+const double stopMinDeltaRatio = 0.02;
+// suppose that, on a [0,100] scale, the first move was the most extreme possible,
+// i.e. 100 points. One fiftieth of that is just 2, which seems to about the limit
+// of what people consider significant.
+const double stopMinSigDelta = 1E-4;
+// typical first shifts are on the order of numAct/10, so this is low
+// enough not to affect anything while guarding against the theoretical
+// possiblity of 0/0 errors
+
 // --------------------------------------------
 
 // this binds the given parameters and returns the λ-fn necessary to stop the SMP appropriately
@@ -178,12 +246,15 @@ double SMPActor::posUtil(const Position * ap1, const SMPState* as) const {
     int ai = as->model->actrNdx(this);
     double ri = as->aNRA(ai); //as->nra(ai, 0);
     assert(0 <= ai);
-    const VctrPstn actorIdeal = as->getIdeal(ai);
-    const VctrPstn* p0 = &actorIdeal;
-    assert(nullptr != p0);
     auto p1 = ((const VctrPstn*)ap1);
     assert(nullptr != p1);
-    double u1 = SMPModel::bvUtil((*p0) - (*p1), vSal, ri);
+    const KMatrix & iBlk = as->idealBlock();
+    const unsigned int nd = iBlk.numC();
+    assert(nd == p1->numR());
+    assert(nd == vSal.numR());
+    const double * idl = &(*iBlk.begin()) + ai*nd;
+    const double sd = SMPModel::bvDiffPt(idl, &(*vSal.begin()), &(*p1->begin()), nd);
+    double u1 = SMPModel::bsUtil(sd, ri);
     return u1;
 }
 
@@ -260,39 +331,72 @@ void SMPActor::interpBrgnS2PMax(double tik, double sik, double prbI,
 }
 
 
-BargainSMP* SMPActor::interpolateBrgn(const SMPActor* ai, const SMPActor* aj,
-                                      const VctrPstn* posI, const VctrPstn * posJ,
-                                      double prbI, double prbJ, InterVecBrgn ivb) {
-    assert((1 == posI->numC()) && (1 == posJ->numC()));
-    unsigned int numD = posI->numR();
-    assert(numD == posJ->numR());
-    auto brgnI = VctrPstn(numD, 1);
-    auto brgnJ = VctrPstn(numD, 1);
-
-    for (unsigned int k = 0; k < numD; k++) {
-        double tik = (*posI)(k, 0);
-        double sik = ai->vSal(k, 0);
-
-        double tjk = (*posJ)(k, 0);
-        double sjk = aj->vSal(k, 0);
+template <unsigned int N>
+void SMPActor::interpVecs(const double * ti, const double * si, double prbI,
+                          const double * tj, const double * sj, double prbJ,
+                          InterVecBrgn ivb, double * bi, double * bj, unsigned int nd) {
+    const unsigned int n = (0 < N) ? N : nd; // a constant trip count when N is given
+    for (unsigned int k = 0; k < n; k++) {
+        double tik = ti[k];
+        double tjk = tj[k];
         double & bik = tik;
         double & bjk = tjk;
         switch (ivb) {
         case InterVecBrgn::S1P1:
-            interpBrgnSnPm(1, 1, tik, sik, prbI, tjk, sjk, prbJ, bik, bjk);
+            interpBrgnSnPm(1, 1, tik, si[k], prbI, tjk, sj[k], prbJ, bik, bjk);
             break;
         case InterVecBrgn::S2P2:
-            interpBrgnSnPm(2, 2, tik, sik, prbI, tjk, sjk, prbJ, bik, bjk);
+            interpBrgnSnPm(2, 2, tik, si[k], prbI, tjk, sj[k], prbJ, bik, bjk);
             break;
         case InterVecBrgn::S2PMax:
-            interpBrgnS2PMax(tik, sik, prbI, tjk, sjk, prbJ, bik, bjk);
+            interpBrgnS2PMax(tik, si[k], prbI, tjk, sj[k], prbJ, bik, bjk);
             break;
         default:
             throw KException("interpolateBrgn: unrecognized InterVecBrgn value");
             break;
         }
-        brgnI(k, 0) = bik;
-        brgnJ(k, 0) = bjk;
+        bi[k] = bik;
+        bj[k] = bjk;
+    }
+    return;
+}
+
+BargainSMP* SMPActor::interpolateBrgn(const SMPActor* ai, const SMPActor* aj,
+                                      const VctrPstn* posI, const VctrPstn * posJ,
+                                      double prbI, double prbJ, InterVecBrgn ivb) {
+    assert((1 == posI->numC()) && (1 == posJ->numC()));
+    unsigned int numD = posI->numR();
+    assert(numD == posJ->numR());
+    assert(numD == ai->vSal.numR());
+    assert(numD == aj->vSal.numR());
+    auto brgnI = VctrPstn(numD, 1);
+    auto brgnJ = VctrPstn(numD, 1);
+
+    const double * ti = &(*posI->begin());
+    const double * si = &(*ai->vSal.begin());
+    const double * tj = &(*posJ->begin());
+    const double * sj = &(*aj->vSal.begin());
+    double * bi = &(*brgnI.begin());
+    double * bj = &(*brgnJ.begin());
+    switch (numD) {
+    case 1:
+        interpVecs<1>(ti, si, prbI, tj, sj, prbJ, ivb, bi, bj, numD);
+        break;
+    case 2:
+        interpVecs<2>(ti, si, prbI, tj, sj, prbJ, ivb, bi, bj, numD);
+        break;
+    case 3:
+        interpVecs<3>(ti, si, prbI, tj, sj, prbJ, ivb, bi, bj, numD);
+        break;
+    case 4:
+        interpVecs<4>(ti, si, prbI, tj, sj, prbJ, ivb, bi, bj, numD);
+        break;
+    case 5:
+        interpVecs<5>(ti, si, prbI, tj, sj, prbJ, ivb, bi, bj, numD);
+        break;
+    default:
+        interpVecs<0>(ti, si, prbI, tj, sj, prbJ, ivb, bi, bj, numD);
+        break;
     }
 
     auto brgn = new BargainSMP(ai, aj, brgnI, brgnJ);
@@ -305,39 +409,102 @@ SMPState::SMPState(Model * m) : State(m), turn(m->history.size()) {
 }
 
 
+SMPState* SMPState::cloneFor(Model* m) const {
+    assert(nullptr != m);
+    assert(0 == m->history.size());
+    assert(model->numAct == m->numAct);
+    auto s = new SMPState(m);
+    for (unsigned int i = 0; i < pstns.size(); i++) {
+        s->pstns[i] = new VctrPstn(*((const VctrPstn*)(pstns[i])));
+    }
+    s->aUtil = aUtil;
+    s->uIndices = uIndices;
+    s->eIndices = eIndices;
+    s->uProb = uProb;
+    s->vDiff = vDiff;
+    s->pstnDup = pstnDup;
+    s->rnProb = rnProb;
+    s->nra = nra;
+    s->setIdeals(ideals);
+    s->accomodate = accomodate;
+    s->identAccMat = identAccMat;
+    s->step = [s]() {
+        return s->stepBCN();
+    };
+    return s;
+}
+
 SMPState::~SMPState() {
     nra = KMatrix();
-    ideals = {};
+    setIdeals({});
     accomodate = KMatrix();
 }
 
 void SMPState::setVDiff(const vector<VctrPstn> & vPos) {
-    auto dfn = [vPos, this](unsigned int i, unsigned int j) {
-        auto ai = ((const SMPActor*)(model->actrs[i]));
-        KMatrix si = ai->vSal;
-        auto posJ = ((const VctrPstn*)(pstns[j]));
-        double dij = 0.0;
-        if (0 == vPos.size()) {
-            auto posI = ((const VctrPstn*)(pstns[i]));
-            auto idlI = ideals[i];
-            //dij = SMPModel::bvDiff((*posI) - (*posJ), si);
-            dij = SMPModel::bvDiff(idlI - (*posJ), si);
-        }
-        else {
-            auto vpi = vPos[i];
-            dij = SMPModel::bvDiff(vpi - (*posJ), si);
-        }
-        return dij;
-    };
-
     const unsigned int na = model->numAct;
+    const unsigned int nd = ((const SMPModel*)model)->numDim;
     assert(na == ideals.size());
     assert(na == accomodate.numR());
     assert(na == accomodate.numC());
-    vDiff = KMatrix::map(dfn, na, na);
+
+    auto ref = KMatrix();
+    if (0 == vPos.size()) {
+        ref = idealBlock();
+    }
+    else {
+        assert(na == vPos.size());
+        ref = KMatrix(na, nd);
+        for (unsigned int i = 0; i < na; i++) {
+            assert(nd == vPos[i].numR());
+            for (unsigned int k = 0; k < nd; k++) {
+                ref(i, k) = vPos[i](k, 0);
+            }
+        }
+    }
+    vDiff = SMPModel::bvDiffAll(ref, salBlock(), pstnBlock());
+    return;
+}
+
+void SMPState::setPstnDup() {
+    const unsigned int na = model->numAct;
+    pstnDup = VUI(na);
+    for (unsigned int j = 0; j < na; j++) {
+        auto pj = ((const VctrPstn*)(pstns[j]));
+        pstnDup[j] = j;
+        for (unsigned int k = 0; k < j; k++) {
+            if (pstnDup[k] != k) {
+                continue; // only compare with the first of each group
+            }
+            auto pk = ((const VctrPstn*)(pstns[k]));
+            bool sameP = (pk->numR() == pj->numR()) && (pk->numC() == pj->numC());
+            for (unsigned int n = 0; sameP && (n < pj->numR()); n++) {
+                sameP = ((*pk)(n, 0) == (*pj)(n, 0));
+            }
+            if (sameP) {
+                pstnDup[j] = k;
+                break;
+            }
+        }
+    }
     return;
 }
 
+KMatrix SMPState::mapPstnCols(function<double(unsigned int i, unsigned int j)> f) const {
+    const unsigned int na = model->numAct;
+    if (0 == pstnDup.size()) {
+        return KMatrix::map(f, na, na);
+    }
+    assert(na == pstnDup.size());
+    auto m = KMatrix(na, na);
+    for (unsigned int j = 0; j < na; j++) {
+        const unsigned int k = pstnDup[j];
+        for (unsigned int i = 0; i < na; i++) {
+            m(i, j) = (k == j) ? f(i, j) : m(i, k); // k < j was already filled in
+        }
+    }
+    return m;
+}
+
 double SMPState::estNRA(unsigned int h, unsigned int i, BigRAdjust ra) const {
     double rh = nra(h, 0);
     double ri = nra(i, 0);
@@ -369,6 +536,13 @@ void SMPState::setAllAUtil(ReportingLevel rl) {
     assert(0 < uIndices.size());
     assert(uIndices.size() <= na);
 
+    if (smod->collapsePstns) {
+        setPstnDup();
+    }
+    else {
+        pstnDup = {};
+    }
+
     auto w_j = actrCaps();
     setVDiff();
     nra = KMatrix(na, 1); // zero-filled, i.e. risk neutral
@@ -376,7 +550,7 @@ void SMPState::setAllAUtil(ReportingLevel rl) {
         return  SMPModel::bsUtil(vDiff(i, j), nra(i, 0));
     };
 
-    auto rnUtil_ij = KMatrix::map(uFn1, na, na);
+    auto rnUtil_ij = mapPstnCols(uFn1);
 
     if (ReportingLevel::Silent < rl) {
         LOG(INFO) << "Raw actor-pos value matrix (risk neutral)";
@@ -399,7 +573,7 @@ void SMPState::setAllAUtil(ReportingLevel rl) {
         nra.mPrintf(" %+.3f ");
     }
 
-    auto raUtil_ij = KMatrix::map(uFn1, na, na);
+    auto raUtil_ij = mapPstnCols(uFn1);
 
     if (ReportingLevel::Silent < rl) {
         LOG(INFO) << "Risk-aware actor-pos utility matrix (objective):";
@@ -437,14 +611,27 @@ void SMPState::setAllAUtil(ReportingLevel rl) {
 
     aUtil = vector<KMatrix>();
     for (unsigned int h = 0; h < na; h++) {
-        auto u_h_ij = KMatrix(na, na);
-        for (unsigned int i = 0; i < na; i++) {
-            double rhi = estNRA(h, i, ra);
-            for (unsigned int j = 0; j < na; j++) {
-                double dij = vDiff(i, j);
-                u_h_ij(i, j) = SMPModel::bsUtil(dij, rhi);
+        // h's estimates depend on h only through h's own risk attitude
+        int sameH = -1;
+        for (unsigned int g = 0; smod->collapsePstns && (sameH < 0) && (g < h); g++) {
+            if (nra(g, 0) == nra(h, 0)) {
+                sameH = g;
             }
         }
+        auto u_h_ij = KMatrix();
+        if (0 <= sameH) {
+            u_h_ij = aUtil[sameH];
+        }
+        else {
+            auto rh_i = KMatrix(na, 1);
+            for (unsigned int i = 0; i < na; i++) {
+                rh_i(i, 0) = estNRA(h, i, ra);
+            }
+            auto uFnH = [this, &rh_i](unsigned int i, unsigned int j) {
+                return SMPModel::bsUtil(vDiff(i, j), rh_i(i, 0));
+            };
+            u_h_ij = mapPstnCols(uFnH);
+        }
         aUtil.push_back(u_h_ij);
 
 
@@ -535,6 +722,75 @@ VctrPstn SMPState::getIdeal(unsigned int n) const
 {
     return ideals[n];
 }
+
+void SMPState::setIdeals(const vector<VctrPstn> & idls) {
+    ideals = idls;
+    const unsigned int ni = ideals.size();
+    if (0 == ni) {
+        idlBlk = KMatrix();
+        return;
+    }
+    const unsigned int nd = ideals[0].numR();
+    idlBlk = KMatrix(ni, nd);
+    for (unsigned int i = 0; i < ni; i++) {
+        assert(nd == ideals[i].numR());
+        assert(1 == ideals[i].numC());
+        for (unsigned int k = 0; k < nd; k++) {
+            idlBlk(i, k) = ideals[i](k, 0);
+        }
+    }
+    return;
+}
+
+const KMatrix & SMPState::idealBlock() const {
+    assert(model->numAct == idlBlk.numR());
+    return idlBlk;
+}
+
+const KMatrix & SMPState::pstnBlock() const {
+    std::lock_guard<std::mutex> lk(posBlkLock);
+    const unsigned int na = model->numAct;
+    if (na == posBlk.numR()) {
+        return posBlk;
+    }
+    const unsigned int nd = ((const SMPModel*)model)->numDim;
+    assert(na == pstns.size());
+    auto blk = KMatrix(na, nd);
+    for (unsigned int j = 0; j < na; j++) {
+        auto pj = ((const VctrPstn*)(pstns[j]));
+        assert(nullptr != pj);
+        assert(nd == pj->numR());
+        for (unsigned int k = 0; k < nd; k++) {
+            blk(j, k) = (*pj)(k, 0);
+        }
+    }
+    posBlk = blk;
+    return posBlk;
+}
+
+KMatrix SMPState::salBlock() const {
+    const unsigned int na = model->numAct;
+    const unsigned int nd = ((const SMPModel*)model)->numDim;
+    auto blk = KMatrix(na, nd);
+    for (unsigned int i = 0; i < na; i++) {
+        auto ai = ((const SMPActor*)(model->actrs[i]));
+        assert(nd == ai->vSal.numR());
+        for (unsigned int k = 0; k < nd; k++) {
+            blk(i, k) = ai->vSal(k, 0);
+        }
+    }
+    return blk;
+}
+
+KMatrix SMPState::posUtils(const VctrPstn & p, const KMatrix & iBlk, const KMatrix & sBlk) const {
+    const unsigned int na = model->numAct;
+    assert(na == nra.numR());
+    auto u = SMPModel::bvDiffOne(iBlk, sBlk, p);
+    for (unsigned int i = 0; i < na; i++) {
+        u(i, 0) = SMPModel::bsUtil(u(i, 0), nra(i, 0));
+    }
+    return u;
+}
 void SMPState::pushPstn(Position* ap) {
     auto sp = (VctrPstn*)ap;
     auto sm = (SMPModel*)model;
@@ -542,6 +798,8 @@ void SMPState::pushPstn(Position* ap) {
     assert(sm->numDim == sp->numR());
 
     State::pushPstn(ap);
+    std::lock_guard<std::mutex> lk(posBlkLock);
+    posBlk = KMatrix();
     return;
 }
 
@@ -558,6 +816,15 @@ bool SMPState::equivNdx(unsigned int i, unsigned int j) const {
 }
 
 
+uint64_t SMPState::fingerprint(double quantum) const {
+    uint64_t fp = State::fingerprint(quantum);
+    for (const auto & idl : ideals) {
+        fp = KBase::hashCombine(fp, idl.fingerprint(quantum));
+    }
+    return fp;
+}
+
+
 // set the diff matrix, do probCE for risk neutral,
 // estimate Ri, and set all the aUtil[h] matrices
 SMPState* SMPState::stepBCN() {
@@ -570,20 +837,29 @@ SMPState* SMPState::stepBCN() {
         }
         return;
     };
+    KBase::ScopedTimer tmr("SMPState::stepBCN");
     gSetup(this);
 
     // JAH 20160802 toggle population of PosUtil, PosEquiv, PosVote, and PosBrob
     // en masse based on value at index 1 of the sqlFlags vector
     // VectorPosition, which is in this same group, is handled separately
-    if (model->sqlFlags[1])
-    {
+    // Each table's log policy may then skip this turn.
+    if (model->logTurn("PosEquiv", turn)) {
         model->sqlPosEquiv(turn);
+    }
+    if (model->logTurn("PosProb", turn)) {
         model->sqlPosProb(turn);
+    }
+    if (model->logTurn("PosVote", turn)) {
         model->sqlPosVote(turn);
     }
     // That gets recorded upon the next state - but it
     // therefore misses the very last state.
-    auto s2 = doBCN();
+    SMPState* s2 = nullptr;
+    {
+        KBase::ScopedTimer tmrBCN("SMPState::doBCN");
+        s2 = doBCN();
+    }
     gSetup(s2);
     s2->step = [s2]() {
         return s2->stepBCN();
@@ -592,6 +868,7 @@ SMPState* SMPState::stepBCN() {
 }
 
 void SMPState::newIdeals() {
+    KBase::ScopedTimer tmr("SMPState::newIdeals");
     const unsigned int na = model->numAct;
     const double tol = 1E-10;
 
@@ -605,26 +882,19 @@ void SMPState::newIdeals() {
 
     const unsigned int nDim = ((SMPModel*)model)->numDim;
 
-    vector<VctrPstn> nIdeals = {};
-
-    auto posK = [this](unsigned int k) {
-        auto ppK = ((const VctrPstn*)(pstns[k]));
-        const KMatrix pK = KMatrix(*ppK);
-        return pK;
-    };
-
+    // each new ideal is the accomodation-weighted sum of positions,
+    // plus the unaccomodated share of the old ideal
+    const KMatrix & pBlk = pstnBlock();
+    const KMatrix & iBlk = idealBlock();
+    auto lag = vector<double>(na, 0.0);
     for (unsigned int i = 0; i < na; i++) {
         double si = 0.0;
-        auto pI = posK(i);
-        auto newIP = KMatrix(nDim, 1); // new ideal point
         for (unsigned int j = 0; j < na; j++) {
             const double aij = accomodate(i, j); // save typing
             assert(0 <= aij);
             assert(aij <= 1.0);
             si = si + aij;
             assert(si <= 1.0 + tol); // cannot be more than slightly above at any point
-            auto pJ = posK(j);
-            newIP = newIP + (aij * pJ);
 
             // very temporary!!
             if (identP && (i == j)) {
@@ -638,14 +908,55 @@ void SMPState::newIdeals() {
         if (identP) {
             assert(fabs(lagI) < tol);
         }
-        newIP = newIP + (lagI * ideals[i]);
-        if (identP) {
-            assert(KBase::norm(newIP - pI) < tol);
+        lag[i] = lagI;
+    }
+
+    auto nBlk = KMatrix(na, nDim);
+    const double * a0 = &(*accomodate.begin());
+    const double * p0 = &(*pBlk.begin());
+    const double * i0 = &(*iBlk.begin());
+    double * n0 = &(*nBlk.begin());
+    switch (nDim) {
+    case 1:
+        blendRows<1>(a0, p0, i0, lag, na, n0);
+        break;
+    case 2:
+        blendRows<2>(a0, p0, i0, lag, na, n0);
+        break;
+    case 3:
+        blendRows<3>(a0, p0, i0, lag, na, n0);
+        break;
+    case 4:
+        blendRows<4>(a0, p0, i0, lag, na, n0);
+        break;
+    case 5:
+        blendRows<5>(a0, p0, i0, lag, na, n0);
+        break;
+    default:
+        nBlk = accomodate * pBlk;
+        for (unsigned int i = 0; i < na; i++) {
+            for (unsigned int k = 0; k < nDim; k++) {
+                nBlk(i, k) = nBlk(i, k) + (lag[i] * iBlk(i, k));
+            }
         }
-        nIdeals.push_back(VctrPstn(newIP));
+        break;
     }
 
-    ideals = nIdeals;
+    vector<VctrPstn> nIdeals = {};
+    for (unsigned int i = 0; i < na; i++) {
+        auto newIP = VctrPstn(nDim, 1); // new ideal point
+        double dSqr = 0.0;
+        for (unsigned int k = 0; k < nDim; k++) {
+            newIP(k, 0) = nBlk(i, k);
+            const double dk = nBlk(i, k) - pBlk(i, k);
+            dSqr = dSqr + (dk * dk);
+        }
+        if (identP) {
+            assert(sqrt(dSqr) < tol);
+        }
+        nIdeals.push_back(newIP);
+    }
+    setIdeals(nIdeals);
 
     if (identP) {
         assert(posIdealDist() < tol);
@@ -662,19 +973,19 @@ void SMPState::idealsFromPstns(const vector<VctrPstn> &  ps) {
     const bool givenP = (na == ps.size());
     assert(givenP || (0 == ps.size()));
 
-    ideals = {};
+    vector<VctrPstn> idls = {};
 
     for (unsigned int i = 0; i < na; i++) {
         if (givenP) {
-            ideals.push_back(ps[i]);
+            idls.push_back(ps[i]);
         }
         else {
             auto ppJ = ((const VctrPstn*)(pstns[i]));
-            auto newIP = VctrPstn(*ppJ);
-            ideals.push_back(VctrPstn(newIP));
+            idls.push_back(VctrPstn(*ppJ));
         }
     }
 
+    setIdeals(idls);
     return;
 }
 
@@ -805,13 +1116,17 @@ void SMPModel::addDim(string dn) {
 }
 
 double SMPModel::stateDist(const SMPState* s1, const SMPState* s2) {
-    unsigned int n = s1->pstns.size();
-    assert(n == s2->pstns.size());
+    const KMatrix & pb1 = s1->pstnBlock();
+    const KMatrix & pb2 = s2->pstnBlock();
+    assert(KBase::sameShape(pb1, pb2));
     double dSum = 0;
-    for (unsigned int i = 0; i < n; i++) {
-        auto vp1i = ((const VctrPstn*)(s1->pstns[i]));
-        auto vp2i = ((const VctrPstn*)(s2->pstns[i]));
-        dSum = dSum + KBase::norm((*vp1i) - (*vp2i));
+    for (unsigned int i = 0; i < pb1.numR(); i++) {
+        double dSqr = 0;
+        for (unsigned int k = 0; k < pb1.numC(); k++) {
+            const double dk = pb1(i, k) - pb2(i, k);
+            dSqr = dSqr + (dk*dk);
+        }
+        dSum = dSum + sqrt(dSqr);
     }
     return dSum;
 }
@@ -833,6 +1148,17 @@ double SMPModel::bsUtil(double sd, double R) {
 
 double SMPModel::bvDiff(const  KMatrix & vd, const  KMatrix & vs) {
     assert(KBase::sameShape(vd, vs));
+    const unsigned int nd = vd.numR();
+    if ((1 == vd.numC()) && (0 < nd) && (nd <= KBase::maxFixDim)) {
+        const double * d0 = &(*vd.begin());
+        const double * s0 = &(*vs.begin());
+        for (unsigned int k = 0; k < nd; k++) {
+            assert(0 <= s0[k]);
+        }
+        const double z[KBase::maxFixDim] = {}; // vd is already the difference
+        const double sd = bvDiffPt(d0, s0, z, nd);
+        return sd;
+    }
     double dsSqr = 0;
     double ssSqr = 0;
     for (unsigned int i = 0; i < vd.numR(); i++) {
@@ -851,6 +1177,108 @@ double SMPModel::bvDiff(const  KMatrix & vd, const  KMatrix & vs) {
     return sd;
 };
 
+// Same summation order as bvDiff, so the results are bit-identical.
+// Shapes and saliences are checked once, not per pair.
+KMatrix SMPModel::bvDiffAll(const KMatrix & ref, const KMatrix & sal, const KMatrix & pts) {
+    assert(KBase::sameShape(ref, sal));
+    assert(ref.numC() == pts.numC());
+    const unsigned int na = ref.numR();
+    const unsigned int np = pts.numR();
+    const unsigned int nd = ref.numC();
+    const double * r0 = &(*ref.begin());
+    const double * s0 = &(*sal.begin());
+    const double * p0 = &(*pts.begin());
+
+    auto ssSqr = vector<double>(na, 0.0);
+    for (unsigned int i = 0; i < na; i++) {
+        const double * si = s0 + i*nd;
+        for (unsigned int k = 0; k < nd; k++) {
+            assert(0 <= si[k]);
+            ssSqr[i] = ssSqr[i] + (si[k] * si[k]);
+        }
+        assert(0 < ssSqr[i]);
+    }
+
+    auto dm = KMatrix(na, np);
+    double * d0 = &(*dm.begin());
+    switch (nd) {
+    case 1:
+        bvDiffRows<1>(r0, s0, p0, na, np, ssSqr, d0);
+        return dm;
+    case 2:
+        bvDiffRows<2>(r0, s0, p0, na, np, ssSqr, d0);
+        return dm;
+    case 3:
+        bvDiffRows<3>(r0, s0, p0, na, np, ssSqr, d0);
+        return dm;
+    case 4:
+        bvDiffRows<4>(r0, s0, p0, na, np, ssSqr, d0);
+        return dm;
+    case 5:
+        bvDiffRows<5>(r0, s0, p0, na, np, ssSqr, d0);
+        return dm;
+    default:
+        break;
+    }
+    for (unsigned int i = 0; i < na; i++) {
+        const double * ri = r0 + i*nd;
+        const double * si = s0 + i*nd;
+        double * di = d0 + i*np;
+        for (unsigned int j = 0; j < np; j++) {
+            const double * pj = p0 + j*nd;
+            double dsSqr = 0;
+            for (unsigned int k = 0; k < nd; k++) {
+                const double ds = (ri[k] - pj[k]) * si[k];
+                dsSqr = dsSqr + (ds*ds);
+            }
+            di[j] = sqrt(dsSqr / ssSqr[i]);
+        }
+    }
+    return dm;
+}
+
+double SMPModel::bvDiffPt(const double * r, const double * s, const double * p, unsigned int nd) {
+    double sd = 0.0;
+    switch (nd) {
+    case 1:
+        sd = bvDiffFix<1>(r, s, p);
+        break;
+    case 2:
+        sd = bvDiffFix<2>(r, s, p);
+        break;
+    case 3:
+        sd = bvDiffFix<3>(r, s, p);
+        break;
+    case 4:
+        sd = bvDiffFix<4>(r, s, p);
+        break;
+    case 5:
+        sd = bvDiffFix<5>(r, s, p);
+        break;
+    default: {
+        double dsSqr = 0;
+        double ssSqr = 0;
+        for (unsigned int k = 0; k < nd; k++) {
+            const double ds = (r[k] - p[k]) * s[k];
+            dsSqr = dsSqr + (ds*ds);
+            ssSqr = ssSqr + (s[k] * s[k]);
+        }
+        assert(0 < ssSqr);
+        sd = sqrt(dsSqr / ssSqr);
+        break;
+    }
+    }
+    return sd;
+}
+
+KMatrix SMPModel::bvDiffOne(const KMatrix & ref, const KMatrix & sal, const KMatrix & pt) {
+    assert(1 == pt.numC());
+    // an nD-by-1 column has the same storage as a 1-by-nD row
+    auto row = KMatrix(1, pt.numR());
+    std::copy(pt.begin(), pt.end(), row.begin());
+    return bvDiffAll(ref, sal, row);
+}
+
 double SMPModel::bvUtil(const  KMatrix & vd, const  KMatrix & vs, double R) {
     const double sd = bvDiff(vd, vs);
     const double u = bsUtil(sd, R);
@@ -900,7 +1328,7 @@ void SMPModel::sankeyOutput(string outputFile) const {
     fclose(f1);
     f1 = nullptr;
     LOG(INFO) << "done";
-    delete epName;
+    delete[] epName;
     epName = nullptr;
 
     const char* appendPosLog = "_posLog.csv";
@@ -909,15 +1337,18 @@ void SMPModel::sankeyOutput(string outputFile) const {
     LOG(INFO) << "Record 1D positions over time, without dimension-name in" << plName << "...";
     FILE* f2 = fopen(plName, "w");
     fprintf(f2,"%s\n",headLine);
+    auto pBlks = vector<const KMatrix*>();
+    for (auto st : history) {
+        const KMatrix & pBlk = ((const SMPState*)st)->pstnBlock();
+        assert(numAct == pBlk.numR());
+        assert(numDim == pBlk.numC());
+        pBlks.push_back(&pBlk);
+    }
     for (unsigned int i = 0; i < numAct; i++) {
         fprintf(f2, "%s", actrs[i]->name.c_str());
         for (unsigned int k = 0; k<numDim; k++) {
-            for (unsigned int t = 0; t < history.size(); t++) {
-                auto st = history[t];
-                auto pit = st->pstns[i];
-                auto vpit = (const VctrPstn*)pit;
-                assert(numDim == vpit->numR());
-                fprintf(f2, ",%5.2f", 100 * (*vpit)(k, 0)); // have to print "100.0" sometimes
+            for (auto pBlk : pBlks) {
+                fprintf(f2, ",%5.2f", 100 * (*pBlk)(i, k)); // have to print "100.0" sometimes
             }
         }
         fprintf(f2, "\n");
@@ -925,9 +1356,9 @@ void SMPModel::sankeyOutput(string outputFile) const {
     fclose(f2);
     f2 = nullptr;
     LOG(INFO) << "done";
-    delete plName;
+    delete[] plName;
     plName = nullptr;
-    delete headLine;
+    delete[] headLine;
     headLine = nullptr;
 
     return;
@@ -935,253 +1366,208 @@ void SMPModel::sankeyOutput(string outputFile) const {
 
 void SMPModel::sankeyOutput(string outputFile, string dbName, string scenarioId)
 {
-    QSqlDatabase qdb = QSqlDatabase::addDatabase(dbDriver, QString("sankey"));
-    qdb.setDatabaseName(QString::fromStdString(dbName));
-    if (0 == dbDriver.compare("QPSQL")) {
-      qdb.setHostName(server);
-      qdb.setPort(port);
-
-      if(!qdb.open(userName, password)) {
-        LOG(INFO) << "Could not connect with postgres DB.";
-        LOG(INFO) << qdb.lastError().text().toStdString();
-        assert(false);
-      }
-    }
-    else if (0 == dbDriver.compare("QSQLITE")) {
-      if (!qdb.open()) {
-        LOG(INFO) << "Could not connect with sqlite DB.";
-        LOG(INFO) << qdb.lastError().text().toStdString();
-        assert(false);
-      }
-    }
-    else {
+    // each call has its own connection, so that several scenarios can be exported at once
+    std::unique_ptr<KBase::DBConn> qdb(KBase::DBConn::create(dbDriver));
+    if (nullptr == qdb) {
       LOG(INFO) << "Invalid DB driver name";
       assert(false);
+      return;
+    }
+    if (!qdb->open(dbName, server, port, userName, password)) {
+      LOG(INFO) << "Could not connect with DB" << dbName;
+      LOG(INFO) << qdb->lastError();
+      assert(false);
+      return;
     }
 
-    QSqlQuery qtQry = QSqlQuery(qdb);
-
-    auto getScenarioData = [](string scenarioID) {
-        string query = string("SELECT * from ScenarioDesc WHERE ") +
-                " ScenarioId = \'" + scenarioID + "\'";
-        return query;
-    };
-
-    auto getSpatialCapabilityData = [](string scenarioID) {
-        string query = string("SELECT Cap from SpatialCapability WHERE ") +
-                " ScenarioId = \'" + scenarioID + "\'";
-        return query;
-    };
-
-    map <size_t, string> actorList;
-    auto getActor = [](string scenarioID) {
-      string query = "SELECT Act_i, Name FROM ActorDescription WHERE ScenarioId = \'" + scenarioID + "\'";
-      return query;
-    };
+    // Rows are streamed to the files as they arrive, in the order the query sorts them,
+    // so memory does not grow with the number of turns or actors.
+    KBase::DBQuery qtQry(qdb.get());
+    const string & scenId = scenarioId;
 
-    if (qtQry.exec(getActor(scenarioId).c_str())) {
-      while (qtQry.next()) {
-        actorList[qtQry.value(0).toUInt()] = qtQry.value(1).toString().toStdString();
+    vector<string> scenarioData;
+    qtQry.prepare("SELECT * from ScenarioDesc WHERE ScenarioId = :scen");
+    qtQry.bindValue(":scen", scenId);
+    if (qtQry.exec() && qtQry.next()) {
+      const int colCount = qtQry.numCols();
+      for (int colIndex = 0; colIndex < colCount; ++colIndex) {
+        scenarioData.push_back(qtQry.value(colIndex).toString());
       }
     }
-
-    string getDimCount = "SELECT COUNT(0) from DimensionDescription WHERE ScenarioId = '" + scenarioId + "'";
-    int numDims;
-    if (qtQry.exec(getDimCount.c_str())) {
-      if (qtQry.first()) {
-        numDims = qtQry.value(0).toInt();
-      }
+    if (scenarioData.size() < 13) {
+      LOG(INFO) << "No model parameters for scenario" << scenarioId;
+      qtQry.finish();
+      qdb->close();
     }
-
-    auto getSalience = string("SELECT SpatialSalience.Sal from SpatialSalience, ActorDescription WHERE ") +
-        " ActorDescription.Act_i = SpatialSalience.Act_i " +
-        " and SpatialSalience.ScenarioId = \'" + scenarioId + "\'" +
-        " and ActorDescription.ScenarioId = \'" + scenarioId + "\'" +
-        " and SpatialSalience.Turn_t = 0" +
-        " and SpatialSalience.dim_k = :dim_k";
-
-    vector<vector<double>> salienceData;
-    qtQry.prepare(getSalience.c_str());
-    for (int dims = 0; dims < numDims; ++dims)
-    {
-      vector<double> salienceDataPerDim;
-      qtQry.bindValue(":dim_k", dims);
-      if (qtQry.exec()) {
+    else {
+      // first prepare the header line
+      char* headLine = newChars(300);
+      sprintf(headLine,
+              "PRNG Seed:%s;VictoryProbModel:%s;VotingRule:%s;PCEModel:%s;StateTransitions:%s;BigRRange:%s;BigRAdjust:%s;ThirdPartyCommit:%s;InterVecBrgn:%s;BargnModel:%s",
+              scenarioData.at(3).c_str(),
+              KBase::VPModelNames[std::stoi(scenarioData.at(4))].c_str(),
+              KBase::VotingRuleNames[std::stoi(scenarioData.at(7))].c_str(),
+              KBase::PCEModelNames[std::stoi(scenarioData.at(5))].c_str(),
+              KBase::StateTransModeNames[std::stoi(scenarioData.at(6))].c_str(),
+              KBase::BigRRangeNames[std::stoi(scenarioData.at(9))].c_str(),
+              KBase::BigRAdjustNames[std::stoi(scenarioData.at(8))].c_str(),
+              KBase::ThirdPartyCommitNames[std::stoi(scenarioData.at(10))].c_str(),
+              InterVecBrgnNames[std::stoi(scenarioData.at(11))].c_str(),
+              SMPBargnModelNames[std::stoi(scenarioData.at(12))].c_str());
+
+      // write one row per actor from a query sorted by actor; fn gives the value for each column
+      auto streamRows = [&qtQry](FILE* f, function<double()> fn) {
+        bool first = true;
+        int lastAct = -1;
         while (qtQry.next()) {
-          salienceDataPerDim.push_back(qtQry.value(0).toDouble());
+          const int act = qtQry.value(0).toInt();
+          if (first || (act != lastAct)) {
+            if (!first) {
+              fprintf(f, "\n");
+            }
+            fprintf(f, "%s", qtQry.value(1).toString().c_str());
+            lastAct = act;
+            first = false;
+          }
+          fprintf(f, ",%5.2f", fn());
         }
-        salienceData.push_back(salienceDataPerDim);
-      }
-    }
-
-    vector<string > scenarioData; // 3D
-    if (qtQry.exec(getScenarioData(scenarioId).c_str())) {
-      QSqlRecord rec = qtQry.record();
-      int colCount = rec.count();
-      while (qtQry.next()) {
-        int colIndex = 0;
-        while (colIndex < colCount) {
-          scenarioData.push_back(qtQry.value(colIndex).toString().toStdString());
-          ++colIndex;
+        if (!first) {
+          fprintf(f, "\n");
         }
+      };
+
+      string effPowDump = outputFile + "_effPow.csv";
+      FILE* f1 = fopen(effPowDump.c_str(), "w");
+      fprintf(f1, "%s\n", headLine);
+
+      LOG(INFO) << "Record effective power in " << effPowDump << "  ...  ";
+      qtQry.prepare("SELECT A.Act_i, A.Name, S.Sal, C.Cap FROM ActorDescription A"
+                    " INNER JOIN SpatialSalience S ON S.ScenarioId = A.ScenarioId AND S.Act_i = A.Act_i"
+                    " INNER JOIN SpatialCapability C ON C.ScenarioId = A.ScenarioId AND C.Act_i = A.Act_i"
+                    " AND C.Turn_t = S.Turn_t"
+                    " WHERE A.ScenarioId = :scen AND S.Turn_t = 0"
+                    " ORDER BY A.Act_i, S.Dim_k");
+      qtQry.bindValue(":scen", scenId);
+      if (qtQry.exec()) {
+        // increased precision since we divided by 100 when the saliences were imported
+        streamRows(f1, [&qtQry]() { return qtQry.value(2).toDouble() * qtQry.value(3).toDouble(); });
       }
-    }
-
-    vector<double> capabilityData; // 3D
-    if (qtQry.exec(getSpatialCapabilityData(scenarioId).c_str())) {
-      while (qtQry.next()) {
-        capabilityData.push_back(qtQry.value(0).toDouble());
+      fclose(f1);
+      f1 = nullptr;
+
+      string posVectDump = outputFile + "_posLog.csv";
+      FILE* f2 = fopen(posVectDump.c_str(), "w");
+      fprintf(f2, "%s\n", headLine);
+
+      LOG(INFO) << "Record 1D positions over time, without dimension-name in " << posVectDump << "  ...  ";
+      // each actor's row is dimension-major: every turn of the first dimension, then of the next
+      qtQry.prepare("SELECT A.Act_i, A.Name, V.Pos_Coord FROM ActorDescription A"
+                    " INNER JOIN VectorPosition V ON V.ScenarioId = A.ScenarioId AND V.Act_i = A.Act_i"
+                    " WHERE A.ScenarioId = :scen"
+                    " ORDER BY A.Act_i, V.Dim_k, V.Turn_t");
+      qtQry.bindValue(":scen", scenId);
+      if (qtQry.exec()) {
+        streamRows(f2, [&qtQry]() { return qtQry.value(2).toDouble(); });
       }
-    }
+      fclose(f2);
+      f2 = nullptr;
+      delete[] headLine;
+      headLine = nullptr;
 
-    // first prepare the header line
-    char* headLine = newChars(300);
-    sprintf(headLine,
-            "PRNG Seed:%s;VictoryProbModel:%s;VotingRule:%s;PCEModel:%s;StateTransitions:%s;BigRRange:%s;BigRAdjust:%s;ThirdPartyCommit:%s;InterVecBrgn:%s;BargnModel:%s",
-            scenarioData.at(3).c_str(),
-            KBase::VPModelNames[std::stoi(scenarioData.at(4))].c_str(),
-            KBase::VotingRuleNames[std::stoi(scenarioData.at(7))].c_str(),
-            KBase::PCEModelNames[std::stoi(scenarioData.at(5))].c_str(),
-            KBase::StateTransModeNames[std::stoi(scenarioData.at(6))].c_str(),
-            KBase::BigRRangeNames[std::stoi(scenarioData.at(9))].c_str(),
-            KBase::BigRAdjustNames[std::stoi(scenarioData.at(8))].c_str(),
-            KBase::ThirdPartyCommitNames[std::stoi(scenarioData.at(10))].c_str(),
-            InterVecBrgnNames[std::stoi(scenarioData.at(11))].c_str(),
-            SMPBargnModelNames[std::stoi(scenarioData.at(12))].c_str());
-
-
-    string effPowDump = outputFile + "_effPow.csv";
-    FILE* f1 = fopen(effPowDump.c_str(), "w");
-    fprintf(f1, "%s\n", headLine);
-
-    LOG(INFO) << "Record effective power in " << effPowDump << "  ...  ";
-    for (auto actor : actorList) {
-      fprintf(f1, "%s", actor.second.c_str());
-      for (size_t dim = 0; dim < numDims; ++dim) {
-        // increased precision since we divided by 100 when the saliences were imported
-        fprintf(f1, ",%5.2f", salienceData[dim].at(actor.first) * capabilityData.at(actor.first));
-      }
-      fprintf(f1, "\n");
+      qtQry.finish();
+      qdb->close();
     }
+    return;
+}
 
-    fclose(f1);
-    f1 = nullptr;
-
-    string posVectDump = outputFile + "_posLog.csv";
-    FILE* f2 = fopen(posVectDump.c_str(), "w");
-    fprintf(f2, "%s\n", headLine);
-
-    string getPosCoord = string("SELECT Pos_Coord from VectorPosition WHERE ") +
-      " Act_i = :act_i and  ScenarioId = '" + scenarioId + "'";
-
-    qtQry.prepare(getPosCoord.c_str());
-
-    LOG(INFO) << "Record 1D positions over time, without dimension-name in " << posVectDump << "  ...  ";
-    for (auto actor : actorList) {
-      fprintf(f2, "%s", actor.second.c_str());
-
-      qtQry.bindValue(":act_i", (uint)actor.first);
-      if (qtQry.exec()) {
-        while (qtQry.next()) {
-          fprintf(f2, ",%5.2f", qtQry.value(0).toDouble());
+void SMPModel::sankeyOutputAll(string outputPrefix, string dbName, vector<string> scenarioIds, unsigned int numPar)
+{
+    if (dbName.empty()) {
+        dbName = databaseName;
+    }
+    if (0 == scenarioIds.size()) {
+        std::unique_ptr<KBase::DBConn> qdb(KBase::DBConn::create(dbDriver));
+        if ((nullptr == qdb) || !qdb->open(dbName, server, port, userName, password)) {
+            LOG(INFO) << "Could not open" << dbName;
+            LOG(INFO) << ((nullptr == qdb) ? "no driver " + dbDriver : qdb->lastError());
+        }
+        else {
+            KBase::DBQuery qtQry(qdb.get());
+            if (qtQry.exec("SELECT ScenarioId FROM ScenarioDesc")) {
+                while (qtQry.next()) {
+                    scenarioIds.push_back(qtQry.value(0).toString());
+                }
+            }
+            qtQry.finish();
+            qdb->close();
         }
-      }
-      fprintf(f2, "\n");
     }
 
-    fclose(f2);
-    f2 = nullptr;
-
-    qtQry.finish();
-    qtQry.clear();
-    qdb.close();
-    qdb = QSqlDatabase();
-    QSqlDatabase::removeDatabase(QString("sankey"));
+    LOG(INFO) << "Exporting Sankey files for" << scenarioIds.size() << "scenarios";
+    auto exportOne = [outputPrefix, dbName, scenarioIds](unsigned int n) {
+        sankeyOutput(outputPrefix + "_" + scenarioIds[n], dbName, scenarioIds[n]);
+        return;
+    };
+    if (0 < scenarioIds.size()) {
+        KBase::groupThreads(exportOne, 0, scenarioIds.size() - 1, numPar);
+    }
     return;
 }
 
 // JAH 20160801 changed to refer to model sqlFlags vector to decide
 // whether or not to populate the table
 void SMPModel::showVPHistory() const {
+    KBase::ScopedTimer tmr("SMPModel::showVPHistory");
     assert(numAct == actrs.size());
     assert(numDim == dimName.size());
 
-    // first need to get the group ID for this table
-    // so then we can get the flag to populate the table or not
-    // note the implicit assumption that there will never be 43+ groups :-)
-    unsigned int grpID = 42;
-    for (unsigned int t = 0; t<KTables.size(); t++)
-    {
-        if (KTables[t]->tabName == "VectorPosition")
-        {
-            grpID = KTables[t]->tabGrpID;
-            break;
-        }
-    }
-    // be sure that it found this table
-    assert(grpID != 42);
-    assert(grpID < sqlFlags.size());
-
     // JAH 20160801 only populate the table if this group is turned on
-    if (sqlFlags[grpID])
+    if (tabFlag("VectorPosition"))
     {
-        string sql = "INSERT INTO VectorPosition "
-          "(ScenarioId, Turn_t, Act_i, Dim_k, Pos_Coord, Idl_Coord, Mover_BargnId)"
-          "VALUES ('" + scenId + "', :turn_t, :act_i, :dim_k, :pos_coord, :idl_coord, :mover_bgnId)";
-
-        query.prepare(QString::fromStdString(sql));
-
         // Prepared statements cache the execution plan for a query after the query optimizer has
         // found the best plan, so there is no big gain with simple insertions.
         // What makes a huge difference is bundling a few hundred into one atomic "transaction".
         // For this case, runtime droped from 62-65 seconds to 0.5-0.6 (vs. 0.30-0.33 with no SQL at all).
 
-        qtDB->transaction();
+        bulkBegin("VectorPosition", { "Turn_t", "Act_i", "Dim_k", "Pos_Coord", "Idl_Coord", "Mover_BargnId" });
 
         LOG(INFO) << "History of actor positions over time:";
         string actorPosHistory;
+        const KBase::LogPolicy & lp = logPolicy("VectorPosition");
 
         // show positions over time
         for (unsigned int i = 0; i < numAct; i++) {
             for (unsigned int k = 0; k < numDim; k++) {
                 actorPosHistory += actrs[i]->name + ", " + dimName[k] + ":";
                 for (unsigned int t = 0; t < history.size(); t++) {
-                    auto st = history[t];
-                    auto pit = st->pstns[i];
-                    auto vpit = (const VctrPstn*)pit;
-                    auto sst = ((const SMPState*)st);
-                    auto vidl = sst->getIdeal(i);
-                    assert(1 == vpit->numC());
-                    assert(numDim == vpit->numR());
-                    const double pCoord = (*vpit)(k, 0) * 100.0; // Use the scale of [0,100]
+                    auto sst = ((const SMPState*)(history[t]));
+                    const KMatrix & pBlk = sst->pstnBlock();
+                    const KMatrix & iBlk = sst->idealBlock();
+                    assert(numDim == pBlk.numC());
+                    const double pCoord = pBlk(i, k) * 100.0; // Use the scale of [0,100]
                     // have to print "100.0" sometimes
                     actorPosHistory += KBase::getFormattedString(" %5.1f", pCoord);
-                    query.bindValue(":turn_t", t);
-                    query.bindValue(":act_i", i);
-                    query.bindValue(":dim_k", k);
-                    query.bindValue(":pos_coord", pCoord);
-                    const double iCoord = vidl(k, 0) * 100.0; // Log at the scale of [0,100];
-                    query.bindValue(":idl_coord", iCoord);
+                    if (!lp.actorP(i) || !lp.turnP(t, lastLogTurn)) {
+                        continue;
+                    }
+                    const double iCoord = iBlk(i, k) * 100.0; // Log at the scale of [0,100];
 
                     // This try block is necessary to make sure there is a bargin which caused the move
+                    KBase::DBValue mover; // NULL
                     try {
-                      query.bindValue(":mover_bgnId",  (qulonglong)(sst->getPosMoverBargain(i)));
+                      mover = (unsigned long long)(sst->getPosMoverBargain(i));
                     }
                     catch (const std::out_of_range& oor) { // exception thrown by std::map::at() method
                       // do nothing
-                      query.bindValue(":mover_bgnId", QVariant(QVariant::Int));
-                    }
-                    if (!query.exec()) {
-                      LOG(INFO) << query.lastError().text().toStdString();
-                      assert(false);
                     }
+                    bulkRow({ t, i, k, pCoord, iCoord, mover });
                 }
                 LOG(INFO) << actorPosHistory;
                 actorPosHistory.clear();
             }
         }
 
-        qtDB->commit();
+        bulkEnd();
     }
 
     // show probabilities over time.
@@ -1282,8 +1668,8 @@ void SMPModel::displayModelParams(SMPModel *md0)
     LOG(INFO) << "BargnModel:" << md0->brgnMod;
 }
 
-string SMPModel::runModel(vector<bool> sqlFlags,
-                          string inputDataFile, uint64_t seed, bool saveHist, vector<int> modelParams) {
+SMPModel * SMPModel::readInput(string inputDataFile, uint64_t seed, vector<bool> sqlFlags,
+                               vector<int> modelParams) {
     if (md0 != nullptr) {
         delete md0;
         md0 = nullptr;
@@ -1294,7 +1680,6 @@ string SMPModel::runModel(vector<bool> sqlFlags,
     assert(dotPos != string::npos); // A file name without extension
 
     string fileExt = inputDataFile.substr(dotPos+1);
-    string fileName= inputDataFile.substr(0,dotPos);
 
     // convert to all lower case for easy comparison
     std::transform(fileExt.begin(), fileExt.end(), fileExt.begin(), ::tolower);
@@ -1322,9 +1707,29 @@ string SMPModel::runModel(vector<bool> sqlFlags,
     if (!modelParams.empty()) {
         SMPModel::updateModelParameters(md0, modelParams);
     }
+    return md0;
+}
+
+string SMPModel::runModel(vector<bool> sqlFlags,
+                          string inputDataFile, uint64_t seed, bool saveHist, vector<int> modelParams,
+                          function<void(unsigned int iter, const State* s)> turnObs,
+                          const std::atomic<bool> * cancel) {
+    md0 = readInput(inputDataFile, seed, sqlFlags, modelParams);
+    string fileName = inputDataFile.substr(0, inputDataFile.find_last_of("."));
 
     displayModelParams(md0);
+    if (nullptr != turnObs) {
+        // the observer reads win probabilities from turn 0, so set its utilities
+        // now, just as the first step would
+        auto s0 = ((SMPState*)(md0->history[0]));
+        s0->setUENdx();
+        s0->setAUtil(-1, ReportingLevel::Low);
+    }
+    md0->turnObserver = turnObs;
+    md0->cancelFlag = cancel;
     configExec(md0);
+    md0->turnObserver = nullptr;
+    md0->cancelFlag = nullptr;
     md0->releaseDB();
     if (saveHist)
     {
@@ -1333,6 +1738,173 @@ string SMPModel::runModel(vector<bool> sqlFlags,
     return md0->getScenarioID();
 }
 
+SMPAsyncRun::SMPAsyncRun(unsigned int queueCap) : snaps(queueCap), cancelP(false), doneP(false) {
+}
+
+SMPAsyncRun::~SMPAsyncRun() {
+    cancel();
+    join();
+}
+
+void SMPAsyncRun::start(vector<bool> sqlFlags, string inputDataFile, uint64_t seed,
+                        vector<int> modelParams) {
+    assert(!worker.joinable()); // one run per object
+    cancelP = false;
+    doneP = false;
+    prevExclusive = Model::sqliteExclusive;
+    prevJournal = Model::sqliteJournal;
+    Model::sqliteExclusive = false;
+    Model::sqliteJournal = "WAL";
+    auto obs = [this](unsigned int iter, const State* s) {
+        publish(iter, s);
+        return;
+    };
+    worker = std::thread([this, sqlFlags, inputDataFile, seed, modelParams, obs]() {
+        scenId = SMPModel::runModel(sqlFlags, inputDataFile, seed, false, modelParams, obs, &cancelP);
+        doneP = true;
+        return;
+    });
+    return;
+}
+
+void SMPAsyncRun::cancel() {
+    cancelP = true;
+    return;
+}
+
+bool SMPAsyncRun::isCancelled() const {
+    return cancelP.load();
+}
+
+bool SMPAsyncRun::nextSnapshot(TurnSnapshot & ts) {
+    return snaps.pop(ts);
+}
+
+bool SMPAsyncRun::isDone() const {
+    return doneP.load();
+}
+
+void SMPAsyncRun::join() {
+    if (worker.joinable()) {
+        worker.join();
+        Model::sqliteExclusive = prevExclusive;
+        Model::sqliteJournal = prevJournal;
+    }
+    return;
+}
+
+string SMPAsyncRun::scenarioId() const {
+    assert(isDone());
+    return scenId;
+}
+
+void SMPAsyncRun::publish(unsigned int iter, const State* s) {
+    auto sst = ((const SMPState*)s);
+    auto md = ((const SMPModel*)(s->model));
+    const unsigned int na = md->numAct;
+
+    auto ts = TurnSnapshot();
+    ts.turn = iter;
+    ts.pstns = sst->pstnBlock();
+    ts.prob = KMatrix(na, 1);
+    auto pn = sst->pDist(-1);
+    const KMatrix & pdt = std::get<0>(pn);
+    const VUI & unq = std::get<1>(pn);
+    for (unsigned int i = 0; i < na; i++) {
+        ts.prob(i, 0) = sst->posProb(i, unq, pdt);
+    }
+    ts.last = (0 < iter) && (iter == md->stopTurn);
+    ts.stopReason = md->stopReason;
+
+    // the reader may fall behind; wait for room rather than lose a turn,
+    // unless the run is being abandoned anyway
+    while (!snaps.push(ts)) {
+        if (cancelP.load()) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return;
+}
+
+string SMPModel::runEnsembleModel(vector<bool> sqlFlags, string inputDataFile,
+                                  uint64_t seed, unsigned int numTraj, vector<int> modelParams) {
+    md0 = readInput(inputDataFile, seed, sqlFlags, modelParams);
+    string fileName = inputDataFile.substr(0, inputDataFile.find_last_of("."));
+
+    // an ensemble of deterministic runs would be numTraj copies of one path
+    md0->stm = KBase::StateTransMode::StochasticSTM;
+    displayModelParams(md0);
+    ensembleExec(md0, numTraj, 0, fileName + "_ensemble.csv");
+    md0->releaseDB();
+    return md0->getScenarioID();
+}
+
+void SMPModel::ensembleExec(SMPModel * md0, unsigned int numTraj, unsigned int numPar, string outCSV) {
+    assert(nullptr != md0);
+    assert(1 == md0->history.size());
+
+    // the same stopping criteria as configExec
+    md0->stop = smpStopFn(stopMinIter, stopMaxIter, stopMinDeltaRatio, stopMinSigDelta);
+
+    // turn-0 utilities are computed once here, then copied into every trajectory
+    auto s0 = ((SMPState*)(md0->history[0]));
+    s0->setUENdx();
+    s0->setAUtil(-1, ReportingLevel::Silent);
+
+    auto trajectory = [md0](unsigned int k, uint64_t sk) {
+        SMPModel * mk = md0->ensembleTrajectory(sk);
+        LOG(INFO) << KBase::getFormattedString(
+          "Ensemble trajectory %u uses PRNG seed %020llu", k, sk);
+        return ((Model*)mk);
+    };
+
+    LOG(INFO) << "Starting ensemble of" << numTraj << "trajectories";
+    KBase::EnsembleStats es;
+    md0->runEnsemble(numTraj, numPar, trajectory, es);
+
+    LOG(INFO) << KBase::getFormattedString(
+      "Completed %u trajectories, with %.2f turns on average (min %.0f, max %.0f)",
+      es.numRuns(), es.lengthStat().stat().mean(),
+      es.lengthStat().stat().min(), es.lengthStat().stat().max());
+    es.writeCSV(outCSV, md0, md0->dimName, 100.0);
+    LOG(INFO) << "Ensemble summary written to" << outCSV;
+    return;
+}
+
+SMPModel * SMPModel::ensembleTrajectory(uint64_t s) const {
+    auto mk = new SMPModel(scenDesc, s, vector<bool>(sqlFlags.size(), false), scenName);
+
+    // doBCN looks up table groups even when nothing is logged
+    for (unsigned int n = 0; n < Model::NumTables + NumTables; n++) {
+        mk->KTables.push_back(createSQL(n));
+    }
+
+    mk->vpm = vpm;
+    mk->pcem = pcem;
+    mk->stm = stm;
+    mk->stop = stop;
+    mk->vrCltn = vrCltn;
+    mk->tpCommit = tpCommit;
+    mk->bigRAdj = bigRAdj;
+    mk->bigRRng = bigRRng;
+    mk->ivBrgn = ivBrgn;
+    mk->brgnMod = brgnMod;
+    mk->dimName = dimName;
+    mk->numDim = numDim;
+    mk->posTol = posTol;
+    mk->collapsePstns = collapsePstns;
+    mk->pruneChlgs = pruneChlgs;
+
+    mk->actrs = actrs;
+    mk->numAct = numAct;
+    mk->ownActors = false;
+
+    auto s0 = ((const SMPState*)(history[0]))->cloneFor(mk);
+    mk->addState(s0);
+    return mk;
+}
+
 string SMPModel::csvReadExec(uint64_t seed, string inputCSV, vector<bool> f, vector<int> par) {
     if (md0 != nullptr) {
         delete md0;
@@ -1357,23 +1929,46 @@ string SMPModel::xmlReadExec(string inputXML, vector<bool> f) {
     return md0->getScenarioID();
 }
 
+bool SMPModel::deferChlgUtils = false;
+
+void SMPModel::sqlDeferredChlgs() {
+    KBase::ScopedTimer tmr("SMPModel::sqlDeferredChlgs");
+    for (auto st : history) {
+        ((SMPState*)st)->sqlDeferredChlgs();
+    }
+    return;
+}
+
+void SMPState::sqlDeferredChlgs() {
+    if (((0 == chlgTarget.size()) && (0 == euData.size())) || chlgPols.empty()) {
+        return; // e.g. the last state, which never challenged, or a turn no policy keeps
+    }
+    calcChlgUtils();
+    model->beginDBTransaction();
+    recordProbEduChlg();
+    model->commitDBTransaction();
+
+    // recorded, so free the memory
+    chlgTarget = {};
+    tpvData.clear();
+    phijData.clear();
+    euData.clear();
+    return;
+}
+
 void SMPModel::configExec(SMPModel * md0)
 {
     // setup the stopping criteria and lambda function
-    const unsigned int minIter = 2;
-    const unsigned int maxIter = 100;
-    const double minDeltaRatio = 0.02;
-    // suppose that, on a [0,100] scale, the first move was the most extreme possible,
-    // i.e. 100 points. One fiftieth of that is just 2, which seems to about the limit
-    // of what people consider significant.
-    const double minSigDelta = 1E-4;
-    // typical first shifts are on the order of numAct/10, so this is low
-    // enough not to affect anything while guarding against the theoretical
-    // possiblity of 0/0 errors
     //md0->stop = [maxIter](unsigned int iter, const State * s) {
     //    return (maxIter <= iter);
     //};
-    md0->stop = smpStopFn(minIter, maxIter, minDeltaRatio, minSigDelta);
+    md0->stop = smpStopFn(stopMinIter, stopMaxIter, stopMinDeltaRatio, stopMinSigDelta);
+    md0->lastLogTurn = stopMaxIter; // until the run ends, for the lastK log policies
+
+    // also stop on fixed points and on short cycles, which smpStopFn alone would
+    // let run to stopMaxIter. The quantum is a tenth of the position tolerance.
+    md0->maxCyclePeriod = 3;
+    md0->fingerprintQuantum = md0->posTol / 10.0;
 
     // Drop the indices of the tables before the model run
     md0->dropTableIndices();
@@ -1391,22 +1986,30 @@ void SMPModel::configExec(SMPModel * md0)
         md0->LogInfoTables();
     }
 
-    if (md0->sqlFlags[4]) {
-        for (auto turn = 0; turn < nState; ++turn) {
+    for (unsigned int turn = 0; turn < nState; ++turn) {
+        if (md0->logTurn("PosUtil", turn)) {
             md0->sqlAUtil(turn);
         }
     }
 
+    if (md0->sqlFlags[2] && deferChlgUtils) {
+        md0->sqlDeferredChlgs();
+    }
+
     // JAH 20160802 added logging control flag for the last state
     // also added the sqlPosVote and sqlPosEquiv calls to get the final state
-    if (md0->sqlFlags[1])
-    {
-        md0->sqlPosProb(nState - 1);
-        md0->sqlPosEquiv(nState - 1);
-        md0->sqlPosVote(nState - 1);
+    const unsigned int lastTurn = nState - 1;
+    if (md0->logTurn("PosProb", lastTurn)) {
+        md0->sqlPosProb(lastTurn);
+    }
+    if (md0->logTurn("PosEquiv", lastTurn)) {
+        md0->sqlPosEquiv(lastTurn);
+    }
+    if (md0->logTurn("PosVote", lastTurn)) {
+        md0->sqlPosVote(lastTurn);
     }
 
-    LOG(INFO) << "Completed model run";
+    LOG(INFO) << "Completed model run:" << md0->stopReason << "at turn" << md0->stopTurn;
     LOG(INFO) << KBase::getFormattedString(
       "There were %u states, with %i steps between them", nState, nState - 1);
     md0->showVPHistory();
@@ -1414,6 +2017,18 @@ void SMPModel::configExec(SMPModel * md0)
     //Create indices in the tables
     md0->createTableIndices();
 
+    if (KBase::Profiler::isEnabled()) {
+        // the last entry is everything after the final turn: logging and history output
+        md0->turnTiming.push_back(KBase::Profiler::collect(true));
+        for (unsigned int t = 0; t < md0->turnTiming.size(); t++) {
+            md0->sqlTurnTiming(t);
+        }
+        if (!turnTimingFile.empty()) {
+            md0->writeTurnTiming(turnTimingFile);
+            LOG(INFO) << "Turn timings written to" << turnTimingFile;
+        }
+    }
+
     return;
 }
 
@@ -1451,80 +2066,156 @@ vector<int> SMPModel::getDefaultModelParameters()
 }
 
 double SMPModel::getQuadMapPoint(size_t t, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
-    auto smpState = md0->history[t];
-    auto autil = smpState->aUtil;
-    double uii = autil[est_h](init_i, init_i);
-    double uij = autil[est_h](init_i, rcvr_j);
-    double uji = autil[est_h](rcvr_j, init_i);
-    double ujj = autil[est_h](rcvr_j, rcvr_j);
-
-    // h's estimate of utility to k of status-quo positions of i and j
-    const double euSQ = autil[est_h](aff_k, init_i) + autil[est_h](aff_k, rcvr_j);
-    assert((0.0 <= euSQ) && (euSQ <= 2.0));
-
-    // h's estimate of utility to k of i defeating j, so j adopts i's position
-    const double uhkij = autil[est_h](aff_k, init_i) + autil[est_h](aff_k, init_i);
-    assert((0.0 <= uhkij) && (uhkij <= 2.0));
-
-    // h's estimate of utility to k of j defeating i, so i adopts j's position
-    const double uhkji = autil[est_h](aff_k, rcvr_j) + autil[est_h](aff_k, rcvr_j);
-    assert((0.0 <= uhkji) && (uhkji <= 2.0));
-
-    auto ai = ((const SMPActor*)(md0->actrs[init_i]));
-    double si = KBase::sum(ai->vSal);
-    double ci = ai->sCap;
-    auto aj = ((const SMPActor*)(md0->actrs[rcvr_j]));
-    double sj = KBase::sum(aj->vSal);
-    assert((0 < sj) && (sj <= 1));
-    double cj = aj->sCap;
-    const double minCltn = 1E-10;
-
-    auto contribs = calcContribs(md0->vrCltn, si*ci, sj*cj, tuple<double, double, double, double>(uii, uij, uji, ujj));
-
-    double chij = get<0>(contribs); // strength of complete coalition supporting i over j (initially empty)
-    double chji = get<1>(contribs); // strength of complete coalition supporting j over i (initially empty)
+    const auto qs = quadMapSlice(t, { est_h });
+    return quadMapPoints(qs, est_h, aff_k, init_i, { rcvr_j })[0];
+}
 
-    // cache those sums
-    double contrib_i_ij = chij;
-    double contrib_j_ij = chji;
+vector<size_t> SMPModel::quadMapEstimators(size_t est_h, const vector<size_t> & rcvrs) {
+    if (quadMapRcvr != est_h) {
+        return { est_h };
+    }
+    return rcvrs;
+}
 
-    // we assess the overall coalition strengths by adding up the contribution of
-    // individual actors (including i and j, above). We assess the contribution of third
-    // parties (n) by looking at little coalitions in the hypothetical (in:j) or (i:nj) contests.
+QuadMapSlice SMPModel::quadMapSlice(size_t t, const vector<size_t> & estHs) {
+    assert(nullptr != md0);
+    assert(t < md0->history.size());
+    auto smpState = ((const SMPState*)(md0->history[t]));
+    auto qs = QuadMapSlice();
+    qs.vrCltn = md0->vrCltn;
+    qs.tpCommit = md0->tpCommit;
+    qs.numAct = md0->numAct;
     for (unsigned int n = 0; n < md0->numAct; n++) {
-        if ((n != init_i) && (n != rcvr_j)) { // already got their influence-contributions
-            auto an = ((const SMPActor*)(md0->actrs[n]));
-
-            double cn = an->sCap;
-            double sn = KBase::sum(an->vSal);
-            double uni = autil[est_h](n, init_i);
-            double unj = autil[est_h](n, rcvr_j);
-            double unn = autil[est_h](n, n);
-
-            // notice that each third party starts afresh,
-            // considering only contributions of principals and itself
-            double pin = Actor::vProbLittle(md0->vrCltn, sn*cn, uni, unj, contrib_i_ij, contrib_j_ij);
-
-            assert(0.0 <= pin);
-            assert(pin <= 1.0);
-            double pjn = 1.0 - pin;
-            auto vt_uv_ul = Actor::thirdPartyVoteSU(sn*cn, md0->vrCltn, md0->tpCommit, pin, pjn, uni, unj, unn);
-            const double vnij = get<0>(vt_uv_ul);
-            chij = (vnij > 0) ? (chij + vnij) : chij;
-            assert(0 < chij);
-            chji = (vnij < 0) ? (chji - vnij) : chji;
-            assert(0 < chji);
-        }
+        auto an = ((const SMPActor*)(md0->actrs[n]));
+        qs.sal.push_back(KBase::sum(an->vSal));
+        qs.cap.push_back(an->sCap);
+    }
+    for (auto h : estHs) {
+        assert(h < smpState->aUtil.size());
+        qs.util[h] = smpState->aUtil[h];
     }
+    return qs;
+}
+
+vector<double> SMPModel::quadMapPoints(const QuadMapSlice & qs, size_t est_h, size_t aff_k,
+                                       size_t init_i, const vector<size_t> & rcvrs) {
+    const unsigned int na = qs.numAct;
+    assert(na == qs.sal.size());
+    assert(na == qs.cap.size());
+    assert(init_i < na);
+    const double si = qs.sal[init_i];
+    const double ci = qs.cap[init_i];
+
+    auto dEU = vector<double>();
+    for (auto rcvr_j : rcvrs) {
+        assert(rcvr_j < na);
+        const size_t h = (quadMapRcvr == est_h) ? rcvr_j : est_h;
+        const size_t k = (quadMapRcvr == aff_k) ? rcvr_j : aff_k;
+        assert(k < na);
+        const auto uPtr = qs.util.find(h);
+        assert(uPtr != qs.util.end());
+        const KMatrix & autil = uPtr->second;
+
+        double uii = autil(init_i, init_i);
+        double uij = autil(init_i, rcvr_j);
+        double uji = autil(rcvr_j, init_i);
+        double ujj = autil(rcvr_j, rcvr_j);
+
+        // h's estimate of utility to k of status-quo positions of i and j
+        const double euSQ = autil(k, init_i) + autil(k, rcvr_j);
+        assert((0.0 <= euSQ) && (euSQ <= 2.0));
+
+        // h's estimate of utility to k of i defeating j, so j adopts i's position
+        const double uhkij = autil(k, init_i) + autil(k, init_i);
+        assert((0.0 <= uhkij) && (uhkij <= 2.0));
+
+        // h's estimate of utility to k of j defeating i, so i adopts j's position
+        const double uhkji = autil(k, rcvr_j) + autil(k, rcvr_j);
+        assert((0.0 <= uhkji) && (uhkji <= 2.0));
+
+        const double sj = qs.sal[rcvr_j];
+        assert((0 < sj) && (sj <= 1));
+        const double cj = qs.cap[rcvr_j];
+
+        auto contribs = calcContribs(qs.vrCltn, si*ci, sj*cj, tuple<double, double, double, double>(uii, uij, uji, ujj));
+
+        double chij = get<0>(contribs); // strength of complete coalition supporting i over j (initially empty)
+        double chji = get<1>(contribs); // strength of complete coalition supporting j over i (initially empty)
+
+        // cache those sums
+        double contrib_i_ij = chij;
+        double contrib_j_ij = chji;
+
+        // we assess the overall coalition strengths by adding up the contribution of
+        // individual actors (including i and j, above). We assess the contribution of third
+        // parties (n) by looking at little coalitions in the hypothetical (in:j) or (i:nj) contests.
+        for (unsigned int n = 0; n < na; n++) {
+            if ((n != init_i) && (n != rcvr_j)) { // already got their influence-contributions
+                const double wn = qs.sal[n] * qs.cap[n];
+                double uni = autil(n, init_i);
+                double unj = autil(n, rcvr_j);
+                double unn = autil(n, n);
+
+                // notice that each third party starts afresh,
+                // considering only contributions of principals and itself
+                double pin = Actor::vProbLittle(qs.vrCltn, wn, uni, unj, contrib_i_ij, contrib_j_ij);
+
+                assert(0.0 <= pin);
+                assert(pin <= 1.0);
+                double pjn = 1.0 - pin;
+                auto vt_uv_ul = Actor::thirdPartyVoteSU(wn, qs.vrCltn, qs.tpCommit, pin, pjn, uni, unj, unn);
+                const double vnij = get<0>(vt_uv_ul);
+                chij = (vnij > 0) ? (chij + vnij) : chij;
+                assert(0 < chij);
+                chji = (vnij < 0) ? (chji - vnij) : chji;
+                assert(0 < chji);
+            }
+        }
+
+        const double phij = chij / (chij + chji); // ProbVict, for i
+        const double phji = chji / (chij + chji);
 
-    const double phij = chij / (chij + chji); // ProbVict, for i
-    const double phji = chji / (chij + chji);
+        const double euVict = uhkij;  // UtilVict
+        const double euCntst = phij*uhkij + phji*uhkji; // UtilContest,
+        const double euChlg = (1 - sj)*euVict + sj*euCntst; // UtilChlg
 
-    const double euVict = uhkij;  // UtilVict
-    const double euCntst = phij*uhkij + phji*uhkji; // UtilContest,
-    const double euChlg = (1 - sj)*euVict + sj*euCntst; // UtilChlg
+        dEU.push_back(euChlg - euSQ);
+    }
+    return dEU;
+}
+
+void SMPModel::quadMapCSV(string outputFile, size_t init_i) {
+    assert(nullptr != md0);
+    if (md0->numAct <= init_i) {
+        throw KException("SMPModel::quadMapCSV: no such initiator");
+    }
+    FILE* f = fopen(outputFile.c_str(), "w");
+    if (nullptr == f) {
+        throw KException("SMPModel::quadMapCSV: could not open " + outputFile);
+    }
+    fprintf(f, "Turn,Init_i,Rcvr_j,Rcvr_Name,Hori_Coord,Vert_Coord\n");
 
-    return (euChlg - euSQ);
+    auto rcvrs = vector<size_t>();
+    for (unsigned int j = 0; j < md0->numAct; j++) {
+        if (j != init_i) {
+            rcvrs.push_back(j);
+        }
+    }
+    // objective perspective: vertical is i's own view, horizontal is each receiver's own
+    auto estHs = rcvrs;
+    estHs.push_back(init_i);
+    for (unsigned int t = 0; t < md0->history.size(); t++) {
+        const auto qs = quadMapSlice(t, estHs);
+        const auto vert = quadMapPoints(qs, init_i, init_i, init_i, rcvrs);
+        const auto hori = quadMapPoints(qs, quadMapRcvr, quadMapRcvr, init_i, rcvrs);
+        for (unsigned int n = 0; n < rcvrs.size(); n++) {
+            fprintf(f, "%u,%u,%u,\"%s\",%.6f,%.6f\n", t, (unsigned int)init_i, (unsigned int)rcvrs[n],
+                    md0->actrs[rcvrs[n]]->name.c_str(), hori[n], vert[n]);
+        }
+    }
+    fclose(f);
+    LOG(INFO) << "Wrote quad map of actor" << init_i << "to" << outputFile;
+    return;
 }
 
 int SMPModel::callBack(void *data, int numCol, char **stringFields, char **colNames)
@@ -1553,174 +2244,85 @@ int SMPModel::sankeyCallBack(void *data, int numCol, char **stringFields, char *
 };
 
 
+#ifdef KTAB_QT_SQL
 double SMPModel::getQuadMapPoint(const QString &connectionName, const string &scenarioID,
   size_t turn, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j) {
+    const auto qs = quadMapSlice(connectionName, scenarioID, turn, { est_h });
+    return quadMapPoints(qs, est_h, aff_k, init_i, { rcvr_j })[0];
+}
 
-  QSqlDatabase qdb = QSqlDatabase::database(connectionName);
-  QSqlQuery qtQry = QSqlQuery(qdb);;
-
-    auto getUtilQuery = [scenarioID, turn, est_h](size_t initiator, size_t receiver) {
-        string query = "SELECT Util FROM PosUtil WHERE ScenarioId = \'" + scenarioID
-                + "\' AND Turn_t = " + std::to_string(turn) + " AND Est_h = " + std::to_string(est_h)
-                + " AND Act_i = " + std::to_string(initiator) + " AND Pos_j =  " + std::to_string(receiver);
-        return query;
-    };
-
-    auto getVSalQuery = [scenarioID, turn](size_t actor) {
-        string query = "SELECT SUM(Sal) FROM SpatialSalience WHERE ScenarioId=\'" + scenarioID
-                + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = " + std::to_string(actor);
-
-        return query;
-    };
-
-    auto getSCapQuery = [scenarioID, turn](size_t actor) {
-        string query = "SELECT Cap FROM SpatialCapability WHERE ScenarioId=\'" + scenarioID
-                + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = " + std::to_string(actor);
+QuadMapSlice SMPModel::quadMapSlice(const QString &connectionName, const string &scenarioID,
+  size_t turn, const vector<size_t> & estHs) {
+    QSqlDatabase qdb = QSqlDatabase::database(connectionName);
+    QSqlQuery qtQry = QSqlQuery(qdb);
+    qtQry.setForwardOnly(true);
+    const string scenTurn = "ScenarioId = \'" + scenarioID + "\' AND Turn_t = " + std::to_string(turn);
 
-        return query;
-    };
+    auto qs = QuadMapSlice();
 
-    // Get voting rule and third party commit for this scenario
+    // voting rule and third party commit for this scenario
     string query = "SELECT VotingRule, ThirdPartyCommit FROM ScenarioDesc WHERE ScenarioId=\'" + scenarioID + "\'";
-
-    //voting rule
-    int vr;
-    //third party commit
-    int tpc;
-    if (qtQry.exec(query.c_str())) {
-      if (qtQry.first()) {
-        vr = qtQry.value(0).toInt();
-        tpc = qtQry.value(1).toInt();
-      }
+    if (qtQry.exec(query.c_str()) && qtQry.next()) {
+        qs.vrCltn = static_cast<VotingRule>(qtQry.value(0).toInt());
+        qs.tpCommit = static_cast<ThirdPartyCommit>(qtQry.value(1).toInt());
     }
 
-    VotingRule vrCltn = static_cast<VotingRule>(vr);
-    ThirdPartyCommit tpCommit = static_cast<ThirdPartyCommit>(tpc);
-
-    auto getData = [&qtQry]() {
-      if (qtQry.exec()) {
-        if (qtQry.first()) {
-          return qtQry.value(0);
-        }
-      }
-    };
-
-    auto utilValue = [&qtQry, &getData](size_t initiator, size_t receiver) {
-      qtQry.bindValue(":act_i", (uint)initiator);
-      qtQry.bindValue(":pos_j", (uint)receiver);
-      return getData().toDouble();
-    };
-
-    auto spatialValue = [&qtQry, &getData](size_t initiator) {
-      qtQry.bindValue(":act_i", (uint)initiator);
-      return getData().toDouble();
-    };
-
-    string utilQry = "SELECT Util FROM PosUtil WHERE ScenarioId = \'" + scenarioID
-      + "\' AND Turn_t = " + std::to_string(turn) + " AND Est_h = " + std::to_string(est_h)
-      + " AND Act_i = :act_i AND Pos_j = :pos_j";
-
-    qtQry.prepare(utilQry.c_str());
-
-    double uii = utilValue(init_i, init_i);
-
-    double uij = utilValue(init_i, rcvr_j);
-
-    double uji = utilValue(rcvr_j, init_i);
-
-    double ujj = utilValue(rcvr_j, rcvr_j);
-
-    double uki = utilValue(aff_k, init_i);
-
-    double ukj = utilValue(aff_k, rcvr_j);
-
-    double euSQ = uki + ukj;
-
-    double uhkij = 2 * uki;
-    assert((0.0 <= uhkij) && (uhkij <= 2.0));
-
-    double uhkji = 2 * ukj;
-    assert((0.0 <= uhkji) && (uhkji <= 2.0));
-
-    string vsalQry = "SELECT SUM(Sal) FROM SpatialSalience WHERE ScenarioId=\'" + scenarioID
-      + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = :act_i";
-    qtQry.prepare(vsalQry.c_str());
-
-    double si = spatialValue(init_i);
-    assert((0 < si) && (si <= 1));
-    
-    double sj = spatialValue(rcvr_j);
-    assert((0 < sj) && (sj <= 1));
-
-    string scapQry = "SELECT Cap FROM SpatialCapability WHERE ScenarioId=\'" + scenarioID
-      + "\' AND Turn_t = " + std::to_string(turn) + " AND Act_i = :act_i";
-    qtQry.prepare(scapQry.c_str());
-
-    double ci = spatialValue(init_i);
-
-    double cj = spatialValue(rcvr_j);
-
-    auto contribs = calcContribs(vrCltn, si*ci, sj*cj, tuple<double, double, double, double>(uii, uij, uji, ujj));
-
-    double chij = get<0>(contribs); // strength of complete coalition supporting i over j (initially empty)
-    double chji = get<1>(contribs); // strength of complete coalition supporting j over i (initially empty)
-
-    // cache those sums
-    double contrib_i_ij = chij;
-    double contrib_j_ij = chji;
-
-    // Get count of actors for this scenario
+    // count of actors for this scenario
     query = "SELECT MAX(Act_i) FROM ActorDescription WHERE ScenarioId=\'" + scenarioID + "\'";
-    qtQry.prepare(query.c_str());
-    size_t numAct = getData().toUInt() + 1;
-
-    // we assess the overall coalition strengths by adding up the contribution of
-    // individual actors (including i and j, above). We assess the contribution of third
-    // parties (n) by looking at little coalitions in the hypothetical (in:j) or (i:nj) contests.
-    //for (size_t n = 0; n < numAct; n++) {
-    for (size_t n = 0; n < numAct; n++) {
-      if ((n != init_i) && (n != rcvr_j)) { // already got their influence-contributions
-
-            qtQry.prepare(vsalQry.c_str());
-            double sn = spatialValue(n);
-
-            qtQry.prepare(scapQry.c_str());
-            double cn = spatialValue(n);
-
-            qtQry.prepare(utilQry.c_str());
-            double uni = utilValue(n, init_i);
-
-            double unj = utilValue(n, rcvr_j);
+    if (qtQry.exec(query.c_str()) && qtQry.next()) {
+        qs.numAct = qtQry.value(0).toUInt() + 1;
+    }
+    const unsigned int na = qs.numAct;
+    qs.sal = vector<double>(na, 0.0);
+    qs.cap = vector<double>(na, 0.0);
 
-            double unn = utilValue(n, n);
+    query = "SELECT Act_i, SUM(Sal) FROM SpatialSalience WHERE " + scenTurn + " GROUP BY Act_i";
+    if (qtQry.exec(query.c_str())) {
+        while (qtQry.next()) {
+            const unsigned int n = qtQry.value(0).toUInt();
+            if (n < na) {
+                qs.sal[n] = qtQry.value(1).toDouble();
+            }
+        }
+    }
 
-            // notice that each third party starts afresh,
-            // considering only contributions of principals and itself
-            double pin = Actor::vProbLittle(vrCltn, sn*cn, uni, unj, contrib_i_ij, contrib_j_ij);
+    query = "SELECT Act_i, Cap FROM SpatialCapability WHERE " + scenTurn;
+    if (qtQry.exec(query.c_str())) {
+        while (qtQry.next()) {
+            const unsigned int n = qtQry.value(0).toUInt();
+            if (n < na) {
+                qs.cap[n] = qtQry.value(1).toDouble();
+            }
+        }
+    }
 
-            assert(0.0 <= pin && pin <= 1.0);
-            double pjn = 1.0 - pin;
-            auto vt_uv_ul = Actor::thirdPartyVoteSU(sn*cn, vrCltn, tpCommit, pin, pjn, uni, unj, unn);
-            const double vnij = get<0>(vt_uv_ul);
-            chij = (vnij > 0) ? (chij + vnij) : chij;
-            assert(0 < chij);
-            chji = (vnij < 0) ? (chji - vnij) : chji;
-            assert(0 < chji);
+    // the whole PosUtil slice for these estimators
+    string hList = "";
+    for (auto h : estHs) {
+        if (0 == qs.util.count(h)) {
+            qs.util[h] = KMatrix(na, na);
+            hList = hList + (hList.empty() ? "" : ",") + std::to_string(h);
+        }
+    }
+    if (!hList.empty()) {
+        query = "SELECT Est_h, Act_i, Pos_j, Util FROM PosUtil WHERE " + scenTurn + " AND Est_h IN (" + hList + ")";
+        if (qtQry.exec(query.c_str())) {
+            while (qtQry.next()) {
+                const unsigned int h = qtQry.value(0).toUInt();
+                const unsigned int i = qtQry.value(1).toUInt();
+                const unsigned int j = qtQry.value(2).toUInt();
+                if ((i < na) && (j < na) && (0 < qs.util.count(h))) {
+                    qs.util[h](i, j) = qtQry.value(3).toDouble();
+                }
+            }
         }
     }
 
     qtQry.finish();
     qtQry.clear();
-
-    const double phij = chij / (chij + chji); // ProbVict, for i
-    const double phji = chji / (chij + chji);
-
-    const double euVict = uhkij;  // UtilVict
-    const double euCntst = phij*uhkij + phji*uhkji; // UtilContest,
-    const double euChlg = (1 - sj)*euVict + sj*euCntst; // UtilChlg
-
-    return (euChlg - euSQ);
+    return qs;
 }
+#endif
 
 tuple<double, double> SMPModel::calcContribs(VotingRule vrCltn, double wi, double wj, tuple<double, double, double, double>(utils)) {
     const double minCltn = 1E-10;
@@ -1770,7 +2372,7 @@ void SMPModel::destroyModel() {
     delete md0;
 }
 
-void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f) {
+SMPModel * SMPModel::randomModel(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f) {
     // JAH 20160711 added rng seed 20160730 JAH added sql flags
     SMPModel *md0 = new SMPModel("", s, f);
     md0->sqlTest();
@@ -1797,7 +2399,7 @@ void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64
         auto buff = KBase::newChars(100);
         sprintf(buff, "SDim-%02u", i);
         md0->addDim(buff);
-        delete buff;
+        delete[] buff;
         buff = nullptr;
     }
 
@@ -1829,6 +2431,27 @@ void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64
         st0->pushPstn(iPos);
     }
 
+    auto aMat = KBase::iMat(md0->numAct);
+    if (accP) {
+        for (unsigned int i = 0; i<md0->numAct; i++) {
+            aMat(i, i) = md0->rng->uniform(0.1, 0.5); // make them lag noticably
+        }
+    }
+
+    st0->setAccomodate(aMat);
+    st0->idealsFromPstns();
+    st0->setUENdx();
+    st0->setAUtil(-1, ReportingLevel::Silent);
+    st0->setNRA(); // TODO: simple setting of NRA
+
+    return md0;
+}
+
+void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f) {
+    SMPModel *md0 = randomModel(numA, sDim, accP, s, f);
+    numA = md0->numAct;
+    auto st0 = ((SMPState*)(md0->history[0]));
+
     for (unsigned int i = 0; i < numA; i++) {
         auto ai = ((SMPActor*)(md0->actrs[i]));
         double ri = 0.0; // st0->aNRA(i);
@@ -1845,24 +2468,14 @@ void SMPModel::randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64
         LOG(INFO) << KBase::getFormattedString("Risk attitude: %+.4f", ri);
     }
 
-    auto aMat = KBase::iMat(md0->numAct);
     if (accP) {
         LOG(INFO) << "Using randomized matrix for ideal-accomodation";
-        for (unsigned int i = 0; i<md0->numAct; i++) {
-            aMat(i, i) = md0->rng->uniform(0.1, 0.5); // make them lag noticably
-        }
     }
     else {
         LOG(INFO) << "Using identity matrix for ideal-accomodation";
     }
     LOG(INFO) << "Accomodate matrix:";
-    aMat.mPrintf(" %.3f ");
-
-    st0->setAccomodate(aMat);
-    st0->idealsFromPstns();
-    st0->setUENdx();
-    st0->setAUtil(-1, ReportingLevel::Silent);
-    st0->setNRA(); // TODO: simple setting of NRA
+    st0->getAccomodate().mPrintf(" %.3f ");
 
     // with SMP actors, we can always read their ideal position.
     // with strategic voting, they might want to advocate positions
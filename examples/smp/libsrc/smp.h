@@ -24,7 +24,10 @@
 #ifndef SMP_LIB_H
 #define SMP_LIB_H
 
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <map>
 
 #include <easylogging++.h>
@@ -32,9 +35,15 @@
 #include "kutils.h"
 #include "prng.h"
 #include "kmatrix.h"
+#include "kfixvec.h"
+#include "kqueue.h"
 #include "gaopt.h"
 #include "kmodel.h"
 
+#ifdef KTAB_QT_SQL
+#include <QString>
+#endif
+
 namespace SMPLib {
 // namespace to which KBase has no access
 using std::function;
@@ -105,7 +114,7 @@ public:
   VctrPstn posRcvr = VctrPstn();
   uint64_t getID() const;
 protected:
-  static uint64_t highestBargainID;
+  static std::atomic<uint64_t> highestBargainID; // shared by concurrent trajectories
   uint64_t myBargainID = 0;
 };
 
@@ -151,6 +160,13 @@ public:
 
 
 protected:
+  // interpolate every component of the two positions into bi and bj.
+  // N is the number of dimensions, or 0 to take it from nd at runtime.
+  template <unsigned int N>
+  static void interpVecs(const double * ti, const double * si, double prbI,
+                         const double * tj, const double * sj, double prbJ,
+                         InterVecBrgn ivb, double * bi, double * bj, unsigned int nd);
+
   static void interpBrgnSnPm(unsigned int n, unsigned int m,
                              double tik, double sik, double prbI,
                              double tjk, double sjk, double prbJ,
@@ -204,6 +220,9 @@ public:
 
   virtual bool equivNdx(unsigned int i, unsigned int j) const;
 
+  // positions and ideals, as both determine the next state
+  virtual uint64_t fingerprint(double quantum) const;
+
   void setNRA(); // TODO: this just sets risk neutral, for now
   // return actor's normalized risk attitude (if set)
   double aNRA(unsigned int i) const;
@@ -222,15 +241,55 @@ public:
   void idealsFromPstns(const vector<VctrPstn> &  ps = {});
   VctrPstn getIdeal(unsigned int n) const;
 
+  // replace all the ideals at once, keeping the ideals block in synch
+  void setIdeals(const vector<VctrPstn> & idls);
+
+  // nA-by-nD blocks of the actors' ideals, current positions, and saliences.
+  // The positions block is built on first use, after which the positions
+  // of this state must not change (pushPstn resets it).
+  const KMatrix & idealBlock() const;
+  const KMatrix & pstnBlock() const;
+  KMatrix salBlock() const;
+
+  // nA-by-1 utility to every actor of the given position, i.e. posUtil for all actors
+  KMatrix posUtils(const VctrPstn & p, const KMatrix & iBlk, const KMatrix & sBlk) const;
+
   uint64_t getPosMoverBargain(unsigned int actor) const;
 
   void setPosMoverBargain(unsigned int actor, uint64_t bargainID);
 
+  // returns estimated probability k wins (given likely coaltiions), and expected delta-util of that challenge.
+  // If desired, record in SQLite.
+  tuple<double, double> probEduChlg(unsigned int h, unsigned int k, unsigned int i, unsigned int j, bool sqlP) const;
+
+  // Copy of this state as the initial state of model m, which must have no history
+  // and the same actors. Positions, ideals, and utilities are copied, not recomputed.
+  SMPState* cloneFor(Model* m) const;
+
+  // run the calcUtils stage for this turn's challenges, record all the saved
+  // challenge utilities, and free them; for SMPModel::deferChlgUtils
+  void sqlDeferredChlgs();
+
 protected:
 
 private:
 
   void calcUtils(unsigned int i, unsigned int bestJ) const;  // i == actor id
+
+  // chlgTarget[i] is the target of i's challenge this turn (-1 if none), saved
+  // only when the challenge tables are logged, for the calcUtils stage.
+  // Each initiator writes only its own entry, so no lock is needed.
+  vector<int> chlgTarget = {};
+
+  // the log policies of those challenge tables (UtilChlg, ProbVict, TPProbVictLoss)
+  // which take rows this turn, set by doBCN; empty if none do
+  vector<const KBase::LogPolicy*> chlgPols = {};
+  // does any of them want the rows of h's estimates of i's challenges?
+  bool chlgRowP(unsigned int h, unsigned int i) const;
+
+  // the calcUtils stage: every perspective on every saved challenge, in parallel.
+  // It only feeds the challenge tables, so it runs during the turn or after the run.
+  void calcChlgUtils() const;
   mutable std::mutex utilDataLock;
   mutable std::multimap<string, KMatrix> tpvData;
   mutable std::multimap<string, double>phijData;
@@ -243,6 +302,16 @@ private:
   virtual void setOneAUtil(unsigned int perspH, ReportingLevel rl);
 
   KMatrix vDiff = KMatrix(); // vDiff(i,j) = difference between idl[i] and pos[j], using actor i's saliences as weights
+
+  // pstnDup[j] is the lowest-numbered actor whose position is exactly equal to j's.
+  // It is set by setAllAUtil only if the model collapses co-located positions;
+  // otherwise it is empty. Exact equality (not posTol) keeps every result bit-identical.
+  VUI pstnDup = {};
+  void setPstnDup();
+
+  // KMatrix::map over [numAct, numAct], where f(i,j) depends on j only via j's position:
+  // columns of co-located positions are copied rather than recomputed.
+  KMatrix mapPstnCols(function<double(unsigned int i, unsigned int j)> f) const;
   KMatrix rnProb = KMatrix(); // probability of each Unique state, when actors are treated as risk-neutral
 
   // risk-aware probabilities are uProb
@@ -253,16 +322,18 @@ private:
 
   void doBCN(unsigned int i);
 
-  // returns estimated probability k wins (given likely coaltiions), and expected delta-util of that challenge.
-  // If desired, record in SQLite.
-  tuple<double, double> probEduChlg(unsigned int h, unsigned int k, unsigned int i, unsigned int j, bool sqlP) const;
-
   // return best j, p[i>j], edu[i->j]
   tuple<int, double, double> bestChallenge(eduChlgsI &eduI) const;
 
-  // the actor's ideal, against which they judge others' positions
+  // the actor's ideal, against which they judge others' positions.
+  // Change it ONLY via setIdeals, so as to keep idlBlk in synch
   vector<VctrPstn> ideals = {};
 
+  // contiguous actors-by-dims copies of ideals and of the positions in pstns
+  KMatrix idlBlk = KMatrix();
+  mutable KMatrix posBlk = KMatrix();
+  mutable std::mutex posBlkLock;
+
   // The matrix of rates at which they adjust their ideals toward positions.
   // Change it ONLY via setAccomodate, so as to keep identAccMat in synch
   KMatrix accomodate = KMatrix();
@@ -283,6 +354,13 @@ private:
    */
   eduChlgsI bestChallengeUtils(unsigned int i /* initiator actor */) const;
 
+  // expected gains at or below this are not worth a challenge
+  static const double minSigEDU;
+
+  // how many targets bestChallengeUtils pruned or evaluated this turn
+  mutable std::atomic<unsigned int> chlgsPruned{ 0 };
+  mutable std::atomic<unsigned int> chlgsEvaluated{ 0 };
+
   // Record the bargain id that caused an actor to move in each turn
   using moverBargains = std::map<
     unsigned int, // actor id
@@ -350,6 +428,19 @@ private:
   std::mutex brgnPosLock;
 };
 
+// Everything the quad map needs for one turn: the voting parameters,
+// each actor's total salience and capability, and the PosUtil matrices
+// of the estimators asked for (util[h](i,j) is h's estimate of i's utility for j's position).
+class QuadMapSlice {
+public:
+  VotingRule vrCltn = VotingRule::Proportional;
+  ThirdPartyCommit tpCommit = ThirdPartyCommit::SemiCommit;
+  unsigned int numAct = 0;
+  vector<double> sal = {};
+  vector<double> cap = {};
+  map<unsigned int, KMatrix> util = {};
+};
+
 class SMPModel : public Model {
   friend class SMPState;
 public:
@@ -362,8 +453,21 @@ public:
   static double bvDiff(const KMatrix & vd, const  KMatrix & vs);
   static double bvUtil(const KMatrix & vd, const  KMatrix & vs, double R);
 
+  // Batched forms of bvDiff on structure-of-arrays blocks, one row per actor.
+  // ref and sal are nA-by-nD (reference points and saliences), pts is nP-by-nD.
+  // bvDiffAll returns the nA-by-nP matrix of distances from ref row i to pts row j,
+  // weighted by sal row i; bvDiffOne returns the nA-by-1 distances to one nD-by-1 point.
+  // Both give exactly the same values as bvDiff, without allocating per pair.
+  static KMatrix bvDiffAll(const KMatrix & ref, const KMatrix & sal, const KMatrix & pts);
+  static KMatrix bvDiffOne(const KMatrix & ref, const KMatrix & sal, const KMatrix & pt);
+  // distance between nd-element arrays r and p, weighted by s
+  static double bvDiffPt(const double * r, const double * s, const double * p, unsigned int nd);
+
+  // turnObs and cancel, if given, become md0's turnObserver and cancelFlag for the run
   static std::string runModel(std::vector<bool> sqlFlags,
-      std::string inputDataFile, uint64_t seed, bool saveHist, std::vector<int> modelParams = std::vector<int>());
+      std::string inputDataFile, uint64_t seed, bool saveHist, std::vector<int> modelParams = std::vector<int>(),
+      function<void(unsigned int iter, const State* s)> turnObs = nullptr,
+      const std::atomic<bool> * cancel = nullptr);
 
   // this sets up a standard configuration and runs it
   static void configExec(SMPModel * md0);
@@ -377,9 +481,30 @@ public:
 
   static void randomSMP(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f);
 
+  // Run numTraj stochastic trajectories of md0, numPar at a time (0 = one per core),
+  // and write the per-turn distributions of positions and win probabilities to outCSV.
+  static void ensembleExec(SMPModel * md0, unsigned int numTraj, unsigned int numPar, string outCSV);
+
+  // read the input file as runModel does, and run it as a stochastic ensemble;
+  // the summary goes to input+'_ensemble.csv'
+  static std::string runEnsembleModel(std::vector<bool> sqlFlags, std::string inputDataFile,
+      uint64_t seed, unsigned int numTraj, std::vector<int> modelParams = std::vector<int>());
+
+  // an unrun model, without database, which shares this model's actors and
+  // turn-0 state but draws from its own PRNG stream
+  SMPModel * ensembleTrajectory(uint64_t s) const;
+
+  // build the random model used by randomSMP, with turn 0 fully set up but not run.
+  // A zero numA or sDim is randomized, as in randomSMP.
+  static SMPModel * randomModel(unsigned int numA, unsigned int sDim, bool accP, uint64_t s, vector<bool> f);
+
   static SMPModel * csvRead(string fName, uint64_t s, vector<bool> f);
   static SMPModel * xmlRead(string fName,vector<bool> f);
 
+  // read a CSV or XML input file, apply the parameters, and leave it in md0
+  static SMPModel * readInput(string inputDataFile, uint64_t seed, vector<bool> f,
+                              vector<int> modelParams);
+
   static  SMPModel * initModel(vector<string> aName, vector<string> aDesc, vector<string> dName,
 	  const KMatrix & cap, // one row per actor
 	  const KMatrix & pos, // one row per actor, one column per dimension
@@ -387,6 +512,25 @@ public:
 	  const KMatrix & accM,
 	  uint64_t s, vector<bool> f, string scenName, string scenDesc);
 
+  // Compute utilities once per distinct position and once per distinct risk attitude,
+  // and skip zero-gain challenges between co-located actors when they are not recorded.
+  // Results and logs are the same either way; late, clustered turns are much cheaper.
+  bool collapsePstns = true;
+
+  // If true, the all-perspective challenge utilities (calcUtils) are not computed
+  // during each turn but after the run, from the saved turns, by sqlDeferredChlgs.
+  // Either way, they are computed only if the challenge tables (sqlFlags[2]) are on,
+  // and only for the turns and perspectives their log policies keep.
+  static bool deferChlgUtils;
+
+  // If true, and the challenge tables are off, bestChallengeUtils skips targets
+  // whose upper bound on expected gain cannot beat the best found so far.
+  // The chosen targets are the same as with exhaustive search.
+  bool pruneChlgs = true;
+
+  // compute and record the deferred challenge utilities of every turn
+  void sqlDeferredChlgs();
+
   // print history of each actor in CSV (might want to generalize to arbitrary VctrPstn)
   void showVPHistory() const;
 
@@ -398,6 +542,17 @@ public:
   // output the two files needed to draw Sankey diagram for Database
   static void sankeyOutput(string outputFile, string dbName, std::string scenarioId) ;
 
+  // the same for several scenarios of one database, numPar at a time (0 means one per core),
+  // each to outputPrefix + "_" + scenarioId. An empty list means every scenario in the database,
+  // and an empty dbName means the Database given to loginCredentials.
+  static void sankeyOutputAll(string outputPrefix, string dbName, vector<string> scenarioIds = {},
+                              unsigned int numPar = 0);
+
+  // convert database dbName to the compact schema, printing its size and the median
+  // time, over reps repetitions, of typical SMPQ queries before and after. An empty
+  // dbName means the Database given to loginCredentials.
+  static bool migrateDB(string dbName, unsigned int reps = 5);
+
   // number of spatial dimensions in this SMP
   void addDim(string dn);
   unsigned int numDim = 0;
@@ -426,12 +581,38 @@ public:
    */
   static double getQuadMapPoint(size_t t, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j);
 
+#ifdef KTAB_QT_SQL
   /**
   * This version of getQuadMapPoint is meant to be used on a db file which contains the results
   * of at least one model run
   */
   static double getQuadMapPoint(const QString &connectionName, const string &scenarioID,
     size_t turn, size_t est_h, size_t aff_k, size_t init_i, size_t rcvr_j);
+#endif
+
+  // Set-based quad map: the points for all receivers of one initiator, in one pass.
+  // est_h or aff_k may be quadMapRcvr, meaning each receiver j itself.
+  static const size_t quadMapRcvr = ((size_t)(-1));
+
+  // load a slice for the given estimators, from the model history or from a database
+  // (one query per table, rather than several per point)
+  static QuadMapSlice quadMapSlice(size_t t, const vector<size_t> & estHs);
+#ifdef KTAB_QT_SQL
+  // on a connection the GUI opened through Qt
+  static QuadMapSlice quadMapSlice(const QString &connectionName, const string &scenarioID,
+    size_t turn, const vector<size_t> & estHs);
+#endif
+
+  // EU(challenge) - EU(status quo) for each receiver, in the order given
+  static vector<double> quadMapPoints(const QuadMapSlice & qs, size_t est_h, size_t aff_k,
+    size_t init_i, const vector<size_t> & rcvrs);
+
+  // the estimators quadMapPoints will need for these (est_h, rcvrs)
+  static vector<size_t> quadMapEstimators(size_t est_h, const vector<size_t> & rcvrs);
+
+  // write the objective-perspective quad map of initiator init_i, for every turn
+  // of the history, as CSV rows of (turn, receiver, horizontal, vertical)
+  static void quadMapCSV(string outputFile, size_t init_i);
 
   static uint getIterationCount();
 
@@ -485,6 +666,58 @@ private:
 
 
 extern SMPModel * md0 ;
+
+// What a run reports after each turn: actor positions (actors by dimensions)
+// and the probability of each actor's position winning (actors by 1).
+class TurnSnapshot {
+public:
+  unsigned int turn = 0;
+  KMatrix pstns = KMatrix();
+  KMatrix prob = KMatrix();
+  bool last = false; // the model stopped at this turn
+  string stopReason = "";
+};
+
+// Runs SMPModel::runModel on a worker thread. Each turn's snapshot is passed
+// to the caller's thread through a lock-free queue, to be read with nextSnapshot
+// while the run goes on. The caller must leave md0 alone until join().
+// Until then, SQLite output is written in WAL mode without an exclusive lock,
+// so the caller can still read the file.
+class SMPAsyncRun {
+public:
+  explicit SMPAsyncRun(unsigned int queueCap = 256);
+  virtual ~SMPAsyncRun(); // cancels, and waits for the worker
+
+  void start(vector<bool> sqlFlags, string inputDataFile, uint64_t seed,
+             vector<int> modelParams = vector<int>());
+
+  // stop after the current turn; the database is still written for the turns done
+  void cancel();
+  bool isCancelled() const;
+
+  // false if no snapshot is waiting
+  bool nextSnapshot(TurnSnapshot & ts);
+
+  // true once runModel has returned, including all database output
+  bool isDone() const;
+  void join();
+  string scenarioId() const; // valid once isDone()
+
+protected:
+  void publish(unsigned int iter, const State* s);
+
+  KBase::SPSCQueue<TurnSnapshot> snaps;
+  std::atomic<bool> cancelP;
+  std::atomic<bool> doneP;
+  std::thread worker;
+  string scenId = "";
+  bool prevExclusive = true; // Model's SQLite settings, restored by join
+  string prevJournal = "";
+};
+
+// this binds the given parameters and returns the λ-fn configExec uses to stop the SMP
+function<bool(unsigned int, const State *)>
+smpStopFn(unsigned int minIter, unsigned int maxIter, double minDeltaRatio, double minSigDelta);
 };// end of namespace
 
 // --------------------------------------------
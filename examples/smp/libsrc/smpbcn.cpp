@@ -26,9 +26,8 @@
 // --------------------------------------------
 
 #include "smp.h"
-#include <QSqlQuery>
-#include <QVariant>
-#include <QSqlError>
+#include "ktaskgraph.h"
+#include <algorithm>
 
 namespace SMPLib {
 using std::function;
@@ -54,7 +53,7 @@ using KBase::ReportingLevel;
 using KBase::nameFromEnum;
 
 // --------------------------------------------
-uint64_t BargainSMP::highestBargainID = 1000;
+std::atomic<uint64_t> BargainSMP::highestBargainID(1000);
 
 // big enough buffer to build all desired SQLite statements
 const unsigned int sqlBuffSize = 250;
@@ -104,10 +103,13 @@ uint64_t BargainSMP::getID() const {
  * combination is getting calculated and recorded in a separate method
  */
 void SMPState::calcUtils(unsigned int i, unsigned int bestJ ) const { // i == actor id
+  KBase::ScopedTimer tmr("SMPState::calcUtils");
   const unsigned int na = model->numAct;
   const bool recordTmpSQLP = true;  // Record this in SQLite
   auto pFn = [this, recordTmpSQLP](unsigned int h, unsigned int k, unsigned int i, unsigned int j) {
-    probEduChlg(h, k, i, j, recordTmpSQLP); // H's estimate of the effect on K of I->J
+    if (chlgRowP(h, i)) { // only perspectives some log policy keeps
+      probEduChlg(h, k, i, j, recordTmpSQLP); // H's estimate of the effect on K of I->J
+    }
   };
 
   auto getUtils = [this, na, pFn, i](unsigned int j) {
@@ -153,17 +155,96 @@ void SMPState::calcUtils(unsigned int i, unsigned int bestJ ) const { // i == ac
   }
 }
 
+bool SMPState::chlgRowP(unsigned int h, unsigned int i) const {
+  for (auto lp : chlgPols) {
+    if (lp->estP(h, i) && lp->actorP(i)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void SMPState::calcChlgUtils() const {
+  auto thrUtils = [this](unsigned int i) {
+    if (0 <= chlgTarget[i]) {
+      calcUtils(i, chlgTarget[i]);
+    }
+  };
+  if (0 < chlgTarget.size()) {
+    KBase::groupThreads(thrUtils, 0, chlgTarget.size() - 1);
+  }
+  return;
+}
+
 // --------------------------------------------
+// for SMP, positive expected gains on the first turn are typically in the 0.5 to 0.01 range
+// I take a fraction of the minimum.
+const double SMPState::minSigEDU = 1e-5; // TODO: 1/20 of the minimum, or 0.0005
+
 eduChlgsI SMPState::bestChallengeUtils(unsigned int i) const {
+  KBase::ScopedTimer tmr("SMPState::bestChallengeUtils");
   const unsigned int na = model->numAct;
   const bool recordTmpSQLP = true;  // Record this in SQLite
+  // A challenge between co-located actors changes nothing, so its expected gain is
+  // (up to round-off) zero and it can never be the best. Unless it is to be recorded,
+  // it need not be evaluated.
+  const bool recordP = chlgRowP(i, i);
+  const bool skipSameP = (0 < pstnDup.size()) && (!recordP);
   eduChlgsI eduI;
+  auto smod = (const SMPModel*)model;
+  if ((!smod->pruneChlgs) || recordP) {
+    for (unsigned int j = 0; j < na; j++) {
+      if (skipSameP && (pstnDup[i] == pstnDup[j])) {
+        continue;
+      }
+      if( i != j ) {
+          eduI[j] = probEduChlg(i, i, i, j, recordTmpSQLP);
+      }
+    }
+    return eduI;
+  }
+
+  // Pruned search. With D = u_ii - u_ij and s_j = sum of j's saliences,
+  // probEduChlg(i,i,i,j) reduces to duChlg = D * (1 - 2 s_j (1 - p_ij)).
+  // As 0 <= p_ij <= 1, that is at most max(D, D*(1 - 2 s_j)), plus a little
+  // slack for round-off. Evaluate targets in descending order of that bound,
+  // and stop once it cannot beat the best so far. Only targets which could not
+  // have been chosen are skipped, with the same tie-breaking as bestChallenge,
+  // so the choice matches the exhaustive search exactly.
+  const double slack = 1E-12;
+  auto bounds = vector<tuple<double, unsigned int>>();
   for (unsigned int j = 0; j < na; j++) {
-    if( i != j ) {
-        eduI[j] = probEduChlg(i, i, i, j, recordTmpSQLP);
+    if ((i == j) || (skipSameP && (pstnDup[i] == pstnDup[j]))) {
+      continue;
+    }
+    auto aj = ((const SMPActor*)(model->actrs[j]));
+    const double sj = KBase::sum(aj->vSal);
+    const double dij = aUtil[i](i, i) - aUtil[i](i, j);
+    const double ub = std::max(dij, dij * (1 - 2 * sj)) + slack;
+    bounds.push_back(tuple<double, unsigned int>(ub, j));
+  }
+  std::sort(bounds.begin(), bounds.end(),
+            [](const tuple<double, unsigned int> & b1, const tuple<double, unsigned int> & b2) {
+    return (get<0>(b1) > get<0>(b2)) || ((get<0>(b1) == get<0>(b2)) && (get<1>(b1) < get<1>(b2)));
+  });
+
+  double bestEU = minSigEDU; // nothing at or below this is ever chosen
+  unsigned int numEval = 0;
+  for (auto bj : bounds) {
+    // ties go to the lowest j, which might come later in this order, so stop only on '<'
+    if ((get<0>(bj) < bestEU) || (get<0>(bj) <= minSigEDU)) {
+      break;
     }
+    const unsigned int j = get<1>(bj);
+    eduI[j] = probEduChlg(i, i, i, j, recordTmpSQLP);
+    numEval++;
+    bestEU = std::max(bestEU, get<1>(eduI[j]));
   }
 
+  const unsigned int numPruned = bounds.size() - numEval;
+  chlgsPruned += numPruned;
+  chlgsEvaluated += numEval;
+  KBase::Profiler::count("SMPState::bestChallengeUtils pruned", numPruned);
   return eduI;
 }
 
@@ -196,20 +277,51 @@ SMPState* SMPState::doBCN() {
   for (unsigned int i = 0; i < na; i++) {
     brgns[i] = vector<BargainSMP*>();
   }
+  chlgTarget = vector<int>(na, -1);
+
+  // The turn is a graph of tasks rather than a chain of barriers, so independent
+  // work overlaps: e.g. logging this turn while setting up the next state.
+  // Database tasks run on this thread, which owns the connection.
+  using TaskID = KBase::TaskGraph::TaskID;
+  chlgPols = {};
+  for (auto tab : { "UtilChlg", "ProbVict", "TPProbVictLoss" }) {
+    if (model->logTurn(tab, turn)) {
+      chlgPols.push_back(&(model->logPolicy(tab)));
+    }
+  }
+  const bool chlgNowP = (!chlgPols.empty()) && (!SMPModel::deferChlgUtils);
+  KBase::TaskGraph tg;
 
-  auto thrBCN = [this](unsigned int i) {
-    this->doBCN(i);
-  };
+  // each initiator picks its best target and proposes bargains
+  auto chlgT = vector<TaskID>();
+  for (unsigned int i = 0; i < na; i++) {
+    chlgT.push_back(tg.add([this, i]() {
+      this->doBCN(i);
+    }));
+  }
 
-  KBase::groupThreads(thrBCN, 0, na - 1);
+  // every perspective on each chosen challenge, only for the challenge tables
+  auto logChlgDeps = chlgT;
+  if (chlgNowP) {
+    for (unsigned int i = 0; i < na; i++) {
+      logChlgDeps.push_back(tg.add([this, i]() {
+        if (0 <= chlgTarget[i]) {
+          calcUtils(i, chlgTarget[i]);
+        }
+      }, { chlgT[i] }));
+    }
+  }
 
-  model->beginDBTransaction();
+  // log the challenges and proposed bargains; the transaction closes in logBrgnT
+  auto logChlgT = tg.add([this, chlgNowP]() {
+    KBase::ScopedTimer tmr("SMPState::doBCN log challenges");
+    model->beginDBTransaction();
 
-  if (model->sqlFlags[2]) {
-    recordProbEduChlg();
-  }
+    if (chlgNowP) {
+      recordProbEduChlg();
+    }
 
-  if (model->sqlFlags[3]) {
+    // only the rows the log policies keep were collected
     for (auto brgnCoord : brgnCos) {
       model->sqlBargainCoords(
         get<0>(brgnCoord), //turn
@@ -218,9 +330,7 @@ SMPState* SMPState::doBCN() {
         get<3>(brgnCoord)  //posRcvr
       );
     }
-  }
 
-  if (model->sqlFlags[4]) {
     for (auto brgnVal : brgnVals) {
       model->sqlBargainEntries(
         get<0>(brgnVal), //turn
@@ -230,28 +340,36 @@ SMPState* SMPState::doBCN() {
         get<4>(brgnVal)  //value
       );
     }
-  }
-
-  //model->commitDBTransaction();
-
-  LOG(INFO) << "Bargains to be resolved";
-  showBargains(brgns);
-
-  w = actrCaps();
-  LOG(INFO) << "w:";
-  w.mPrintf(" %6.2f ");
-
-  s2 = new SMPState(model);
-
-  auto thrCalcPosts = [this](unsigned int k) {
-    this->updateBestBrgnPositions(k);
-  };
-
-  KBase::groupThreads(thrCalcPosts, 0, na - 1);
+  }, logChlgDeps, true);
 
-  //model->beginDBTransaction();
+  auto setupT = tg.add([this]() {
+    if (((const SMPModel*)model)->pruneChlgs && chlgPols.empty()) {
+      const unsigned int nPrn = chlgsPruned;
+      const unsigned int nEvl = chlgsEvaluated;
+      LOG(INFO) << KBase::getFormattedString(
+        "In turn %u, bounds pruned %u of %u challenge evaluations", turn, nPrn, nPrn + nEvl);
+    }
+    LOG(INFO) << "Bargains to be resolved";
+    showBargains(brgns);
+
+    w = actrCaps();
+    LOG(INFO) << "w:";
+    w.mPrintf(" %6.2f ");
+
+    s2 = new SMPState(model);
+  }, chlgT);
+
+  // each actor chooses among the bargains involving it
+  auto brgnT = vector<TaskID>();
+  for (unsigned int k = 0; k < na; k++) {
+    brgnT.push_back(tg.add([this, k]() {
+      this->updateBestBrgnPositions(k);
+    }, { setupT }));
+  }
 
-  if (model->sqlFlags[3]) {
+  auto logBrgnDeps = brgnT;
+  logBrgnDeps.push_back(logChlgT);
+  auto logBrgnT = tg.add([this]() {
     for (auto votes : brgnVotes) {
       for (auto vote : votes) {
         model->sqlBargainVote(
@@ -270,65 +388,79 @@ SMPState* SMPState::doBCN() {
         get<2>(util)  //utilities
       );
     }
-  }
 
-  // record data so far
-  if (model->sqlFlags[4]) {
-    updateBargnTable(brgns, actorBargains, actorMaxBrgNdx);
-  }
-
-  model->commitDBTransaction();
-
-  // Some bargains are nullptr, and there are two copies of every non-nullptr randomly
-  // arranged. If we delete them as we find them, then the second occurance will be corrupted,
-  // so the code crashes when it tries to access the memory to see if it matches something
-  // already deleted. Hence, we scan them all, building a list of unique bargains,
-  // then delete those in order.
-  auto uBrgns = vector<BargainSMP*>();
+    // record data so far
+    if (model->logTurn("Bargn", turn)) {
+      updateBargnTable(brgns, actorBargains, actorMaxBrgNdx);
+    }
 
-  for (unsigned int i = 0; i < brgns.size(); i++) {
-    auto ai = ((const SMPActor*)(model->actrs[i]));
-    for (unsigned int j = 0; j < brgns[i].size(); j++) {
-      BargainSMP* bij = brgns[i][j];
-      if (nullptr != bij) {
-        if (ai == bij->actInit) {
-          uBrgns.push_back(bij); // this is the initiator's copy, so save it for deletion
+    KBase::ScopedTimer tmr("SMPState::doBCN commit");
+    model->commitDBTransaction();
+  }, logBrgnDeps, true);
+
+  // the bargains are deleted only after everything referring to them is done
+  tg.add([this]() {
+    // Some bargains are nullptr, and there are two copies of every non-nullptr randomly
+    // arranged. If we delete them as we find them, then the second occurance will be corrupted,
+    // so the code crashes when it tries to access the memory to see if it matches something
+    // already deleted. Hence, we scan them all, building a list of unique bargains,
+    // then delete those in order.
+    auto uBrgns = vector<BargainSMP*>();
+
+    for (unsigned int i = 0; i < brgns.size(); i++) {
+      auto ai = ((const SMPActor*)(model->actrs[i]));
+      for (unsigned int j = 0; j < brgns[i].size(); j++) {
+        BargainSMP* bij = brgns[i][j];
+        if (nullptr != bij) {
+          if (ai == bij->actInit) {
+            uBrgns.push_back(bij); // this is the initiator's copy, so save it for deletion
+          }
         }
+        brgns[i][j] = nullptr; // either way, null it out.
       }
-      brgns[i][j] = nullptr; // either way, null it out.
     }
-  }
 
-  for (auto b : uBrgns) {
-    //int aI = model->actrNdx(b->actInit);
-    //int aR = model->actrNdx(b->actRcvr);
-    //printf("Delete bargain [%2i:%2i] \n", aI, aR);
-    delete b;
-  }
+    for (auto b : uBrgns) {
+      //int aI = model->actrNdx(b->actInit);
+      //int aR = model->actrNdx(b->actRcvr);
+      //printf("Delete bargain [%2i:%2i] \n", aI, aR);
+      delete b;
+    }
+  }, { logBrgnT });
 
-  // TODO: this really should do all the assessment: ueIndices, rnProb, all U^h_{ij}, raProb
-  s2->setUENdx();
+  // set up the next state, overlapping the logging of this one
+  tg.add([this]() {
+    // TODO: this really should do all the assessment: ueIndices, rnProb, all U^h_{ij}, raProb
+    KBase::ScopedTimer tmrS2("SMPState::doBCN next state");
+    s2->setUENdx();
 
-  if (0 == accomodate.numC()) { // nothing to copy
-    s2->setAccomodate(1.0); // set to identity matrix
-  }
-  else {
-    s2->setAccomodate(accomodate);
-  }
+    if (0 == accomodate.numC()) { // nothing to copy
+      s2->setAccomodate(1.0); // set to identity matrix
+    }
+    else {
+      s2->setAccomodate(accomodate);
+    }
 
-  if (0 == ideals.size()) { // nothing to copy
-    s2->idealsFromPstns(); // set s2's current ideals to s2's current positions
-  }
-  else {
-    s2->ideals = ideals; // copy s1's old ideals
-  }
-  s2->newIdeals(); // adjust s2 ideals toward new ones
-  double ipDist = s2->posIdealDist(ReportingLevel::Medium);
-  LOG(INFO) << KBase::getFormattedString("rms (pstn, ideal) = %.5f", ipDist);
+    if (0 == ideals.size()) { // nothing to copy
+      s2->idealsFromPstns(); // set s2's current ideals to s2's current positions
+    }
+    else {
+      s2->setIdeals(ideals); // copy s1's old ideals
+    }
+    s2->newIdeals(); // adjust s2 ideals toward new ones
+    double ipDist = s2->posIdealDist(ReportingLevel::Medium);
+    LOG(INFO) << KBase::getFormattedString("rms (pstn, ideal) = %.5f", ipDist);
+
+    // as stepBCN would, so it is ready to step
+    s2->setAUtil(-1, ReportingLevel::Low);
+  }, brgnT);
+
+  tg.run();
   return s2;
 }
 
 void SMPState::doBCN(unsigned int i) {
+    KBase::ScopedTimer tmr("SMPState::doBCN(i)");
     auto ai = ((const SMPActor*)(model->actrs[i]));
     auto posI = ((const VctrPstn*)pstns[i]);
     auto smod = dynamic_cast<SMPModel *>(model);
@@ -340,23 +472,11 @@ void SMPState::doBCN(unsigned int i) {
     brgns[i].push_back(sqBrgnI);
     brgnsLock.unlock();
 
-    // before we can log this bargain, we need to get the group ID for this table
-    // so then we can get the flag to populate the table or not
-    // note the implicit assumption that there will never be 43+ groups :-)
-    unsigned int grpID = 42;
-    for (unsigned int t = 0; t<model->KTables.size(); t++)
-    {
-        if (model->KTables[t]->tabName == "Bargn")
-        {
-            grpID = model->KTables[t]->tabGrpID;
-            break;
-        }
-    }
-    // be sure that it found this table
-    assert(grpID != 42);
-    assert(grpID < model->sqlFlags.size());
+    // log this initiator's bargains only if the table, and its log policy, want them
+    const bool bargnP = model->logTurn("Bargn", turn) && model->logPolicy("Bargn").actorP(i);
+    const bool coordsP = model->logTurn("BargnCoords", turn) && model->logPolicy("BargnCoords").actorP(i);
 
-    if (model->sqlFlags[grpID])
+    if (bargnP)
     {
       brgnValsLock.lock();
       brgnVals.push_back(BrgnValue(turn, sqBrgnI->getID(), i, i, 0));
@@ -376,7 +496,11 @@ void SMPState::doBCN(unsigned int i) {
       auto aj = ((const SMPActor*)(model->actrs[j]));
       auto posJ = ((const VctrPstn*)pstns[j]);
 
-      std::thread thr(&SMPState::calcUtils, this, i, bestJ);
+      // the other perspectives on this challenge are only logged, so
+      // they are left to the calcUtils stage
+      if (!chlgPols.empty()) {
+        chlgTarget[i] = bestJ;
+      }
 
       // make the variables local to lexical scope of this block.
       // for testing, calculate and print out a block of data showing each's perspective
@@ -500,13 +624,13 @@ void SMPState::doBCN(unsigned int i) {
       switch (bMod) {
       case SMPBargnModel::InitOnlyInterpSMPBM:
         // record the only one used into SQLite JAH 20160802 use the flag
-        if(model->sqlFlags[grpID])
+        if(bargnP)
         {
           brgnValsLock.lock();
           brgnVals.push_back(BrgnValue(turn, brgnIIJ->getID(), i, j, bestEU));
           brgnValsLock.unlock();
         }
-        if(model->sqlFlags[3])
+        if(coordsP)
         {          
           brgnCosLock.lock();
           brgnCos.push_back(BrgnCoord(turn, brgnIIJ->getID(), brgnIIJ->posInit, brgnIIJ->posRcvr));
@@ -527,14 +651,14 @@ void SMPState::doBCN(unsigned int i) {
 
       case SMPBargnModel::InitRcvrInterpSMPBM:
         // record the pair used into SQLite JAH 20160802 use the flag
-        if(model->sqlFlags[grpID])
+        if(bargnP)
         {
           brgnValsLock.lock();
           brgnVals.push_back(BrgnValue(turn, brgnIIJ->getID(), i, j, bestEU));
           brgnVals.push_back(BrgnValue(turn, brgnJIJ->getID(), i, j, bestEU));
           brgnValsLock.unlock();
         }
-        if(model->sqlFlags[3])
+        if(coordsP)
         {
           brgnCosLock.lock();
           brgnCos.push_back(BrgnCoord(turn, brgnIIJ->getID(), brgnIIJ->posInit, brgnIIJ->posRcvr));
@@ -556,13 +680,13 @@ void SMPState::doBCN(unsigned int i) {
 
       case SMPBargnModel::PWCompInterpSMPBM:
         // record the only one used into SQLite JAH 20160802 use the flag
-        if(model->sqlFlags[grpID])
+        if(bargnP)
         {
           brgnValsLock.lock();
           brgnVals.push_back(BrgnValue(turn, brgnIJ->getID(), i, j, bestEU));
           brgnValsLock.unlock();
         }
-        if(model->sqlFlags[3])
+        if(coordsP)
         {
           brgnCosLock.lock();
           brgnCos.push_back(BrgnCoord(turn, brgnIJ->getID(), brgnIJ->posInit, brgnIJ->posRcvr));
@@ -584,8 +708,6 @@ void SMPState::doBCN(unsigned int i) {
         LOG(INFO) << "SMPState::doBCN unrecognized SMPBargnModel";
         exit(-1);
       }
-
-      thr.join();
     }
     else {
       LOG(INFO) << "In turn" << turn << "Actor" << i << "has no advantageous targets";
@@ -593,6 +715,7 @@ void SMPState::doBCN(unsigned int i) {
 }
 
 void SMPState::updateBestBrgnPositions(int k) {
+  KBase::ScopedTimer tmr("SMPState::updateBestBrgnPositions");
   auto ndxMaxProb = [](const KMatrix & cv) {
     const double pTol = 1E-8;
     assert(fabs(KBase::sum(cv) - 1.0) < pTol);
@@ -603,9 +726,27 @@ void SMPState::updateBestBrgnPositions(int k) {
     return iMax;
   };
 
+  // utilities to every actor of the two new positions in each of k's bargains,
+  // computed one bargain at a time against the ideals and saliences blocks
+  const unsigned int nbk = brgns[k].size();
+  auto uInit = vector<KMatrix>(nbk);
+  auto uRcvr = vector<KMatrix>(nbk);
+  {
+    const KMatrix & iBlk = idealBlock();
+    const KMatrix sBlk = salBlock();
+    for (unsigned int nbj = 0; nbj < nbk; nbj++) {
+      const BargainSMP * b = brgns[k][nbj];
+      assert(nullptr != b);
+      if (b->actInit != b->actRcvr) {
+        uInit[nbj] = posUtils(b->posInit, iBlk, sBlk);
+        uRcvr[nbj] = posUtils(b->posRcvr, iBlk, sBlk);
+      }
+    }
+  }
+
   // what is the utility to actor nai of the state resulting after
   // the nbj-th bargain of the k-th actor is implemented?
-  auto brgnUtil = [this](unsigned int nk, unsigned int nai, unsigned int nbj) {
+  auto brgnUtil = [this, &uInit, &uRcvr](unsigned int nk, unsigned int nai, unsigned int nbj) {
     const unsigned int na = model->numAct;
     BargainSMP * b = brgns[nk][nbj];
     assert(nullptr != b);
@@ -623,12 +764,12 @@ void SMPState::updateBestBrgnPositions(int k) {
       uAvrg = 0.0;
       auto ndxInit = model->actrNdx(b->actInit);
       assert((0 <= ndxInit) && (ndxInit < na)); // must find it
-      double uPosInit = ((SMPActor*)(model->actrs[nai]))->posUtil(&(b->posInit), this);
+      double uPosInit = uInit[nbj](nai, 0);
       uAvrg = uAvrg + uPosInit;
 
       auto ndxRcvr = model->actrNdx(b->actRcvr);
       assert((0 <= ndxRcvr) && (ndxRcvr < na)); // must find it
-      double uPosRcvr = ((SMPActor*)(model->actrs[nai]))->posUtil(&(b->posRcvr), this);
+      double uPosRcvr = uRcvr[nbj](nai, 0);
       uAvrg = uAvrg + uPosRcvr;
 
       for (unsigned int n = 0; n < na; n++) {
@@ -666,7 +807,11 @@ void SMPState::updateBestBrgnPositions(int k) {
     u_im.mPrintf(" %.5f ");
 
     LOG(INFO) << "Doing scalarPCE for the" << nb << "bargains of actor" << k << "...";
-    auto p = Model::scalarPCE(na, nb, w, u_im, smod->vrCltn, smod->vpm, smod->pcem, ReportingLevel::Medium);
+    auto p = KMatrix();
+    {
+      KBase::ScopedTimer tmrPCE("SMPState::bargain scalarPCE");
+      p = Model::scalarPCE(na, nb, w, u_im, smod->vrCltn, smod->vpm, smod->pcem, ReportingLevel::Medium);
+    }
     assert(nb == p.numR());
     assert(1 == p.numC());
     actorBargains.insert(map<unsigned int, KBase::KMatrix>::value_type(k, p));
@@ -693,32 +838,71 @@ void SMPState::updateBestBrgnPositions(int k) {
 
     //populate the Bargain Vote & Util tables
     // JAH added sql flag logging control
-  if (model->sqlFlags[3])
+  const bool voteP = model->logTurn("BargnVote", turn);
+  const bool utilP = model->logTurn("BargnUtil", turn);
+  if (voteP || utilP)
   {
-    auto brgns_k = brgns[k];
-    vector< std::tuple<uint64_t, uint64_t>> barginIDsPair_i_j;
-    vector<uint64_t> bargnIdsRows = {};
-    for (int j = 0; j < nb; j++)
-    {
-      bargnIdsRows.push_back(brgns[k][j]->getID());
-    }
-    for (unsigned int brgnFirst = 0; brgnFirst < nb; brgnFirst++)
-    {
-      for (unsigned int brgnSecond = 0; brgnSecond < brgnFirst; brgnSecond++)
-      {
-        barginIDsPair_i_j.push_back(tuple<uint64_t, uint64_t>(brgns_k[brgnFirst]->getID(), brgns_k[brgnSecond]->getID()));
+    // the columns of u_im for the topK most likely bargains, in their original order; all if topK is 0
+    auto topBrgns = [nb, &p](unsigned int topK) {
+      auto ndx = vector<unsigned int>();
+      for (unsigned int m = 0; m < nb; m++) {
+        ndx.push_back(m);
       }
-    }
+      if ((0 < topK) && (topK < nb)) {
+        std::stable_sort(ndx.begin(), ndx.end(), [&p](unsigned int m1, unsigned int m2) {
+          return p(m1, 0) > p(m2, 0);
+        });
+        ndx.resize(topK);
+        std::sort(ndx.begin(), ndx.end());
+      }
+      return ndx;
+    };
+    auto subU = [na, &u_im](const vector<unsigned int> & ndx) {
+      auto u = KMatrix(na, ndx.size());
+      for (unsigned int i = 0; i < na; i++) {
+        for (unsigned int m = 0; m < ndx.size(); m++) {
+          u(i, m) = u_im(i, ndx[m]);
+        }
+      }
+      return u;
+    };
 
     BrgnVotes votes;
-    for (unsigned int actor = 0; actor < na; ++actor) {
-      auto pv_ij = calcVotes(w, u_im, actor);
+    if (voteP) {
+      const KBase::LogPolicy & lp = model->logPolicy("BargnVote");
+      const auto ndx = topBrgns(lp.topK);
+      const KMatrix u = (ndx.size() == nb) ? u_im : subU(ndx);
+      vector< std::tuple<uint64_t, uint64_t>> barginIDsPair_i_j;
+      for (unsigned int brgnFirst = 0; brgnFirst < ndx.size(); brgnFirst++)
+      {
+        for (unsigned int brgnSecond = 0; brgnSecond < brgnFirst; brgnSecond++)
+        {
+          barginIDsPair_i_j.push_back(tuple<uint64_t, uint64_t>(brgns[k][ndx[brgnFirst]]->getID(),
+                                                                brgns[k][ndx[brgnSecond]]->getID()));
+        }
+      }
 
-      votes.push_back(BrgnVote(turn, barginIDsPair_i_j, pv_ij, actor));
+      for (unsigned int actor = 0; actor < na; ++actor) {
+        if (lp.actorP(actor)) {
+          auto pv_ij = calcVotes(w, u, actor);
+          votes.push_back(BrgnVote(turn, barginIDsPair_i_j, pv_ij, actor));
+        }
+      }
     }
+
     brgnPosLock.lock();
-    brgnVotes.push_back(votes);
-    brgnUtils.push_back(BrgnUtil(turn, bargnIdsRows, u_im));
+    if (voteP) {
+      brgnVotes.push_back(votes);
+    }
+    if (utilP) {
+      const auto ndx = topBrgns(model->logPolicy("BargnUtil").topK);
+      vector<uint64_t> bargnIdsRows = {};
+      for (auto m : ndx)
+      {
+        bargnIdsRows.push_back(brgns[k][m]->getID());
+      }
+      brgnUtils.push_back(BrgnUtil(turn, bargnIdsRows, (ndx.size() == nb) ? u_im : subU(ndx)));
+    }
     brgnPosLock.unlock();
   }
 
@@ -765,6 +949,7 @@ void SMPState::updateBestBrgnPositions(int k) {
 // TODO: offer a choice the different ways of estimating value-of-a-state: even sum or expected value.
 // TODO: we may need to separate euConflict from this at some point
 tuple<double, double> SMPState::probEduChlg(unsigned int h, unsigned int k, unsigned int i, unsigned int j, bool sqlP) const {
+  KBase::ScopedTimer tmr("SMPState::probEduChlg");
 
   // you could make other choices for these two sub-models
   auto sMod = (const SMPModel*)model;
@@ -899,7 +1084,7 @@ tuple<double, double> SMPState::probEduChlg(unsigned int h, unsigned int k, unsi
   // JAH 20160802 switched to use the model sql flags vector to control logging
   // I keep sqlP and short-circuit & it because sometimes probEduChlg is called to
   // do some temporary calcs which should not be store - this is controlled with sqlP
-  if (sqlP && model->sqlFlags[2]) {
+  if (sqlP && chlgRowP(h, i)) {
     // now that the computation is finished, record everything into SQLite
     //
     // record tpvArray into SQLite turn, est (h), init (i), third party (n), receiver (j), and tpvArray[n]
@@ -941,10 +1126,6 @@ tuple<int, double, double> SMPState::bestChallenge(eduChlgsI &eduI) const {
   double pIJ = 0;
   double bestEU = -1.00;
 
-  // for SMP, positive expected gains on the first turn are typically in the 0.5 to 0.01 range
-  // I take a fraction of the minimum.
-  const double minSigEDU = 1e-5; // TODO: 1/20 of the minimum, or 0.0005
-
   for(const auto& eduIJ : eduI) {
     double pij = get<0>(eduIJ.second);
     double edu = get<1>(eduIJ.second);
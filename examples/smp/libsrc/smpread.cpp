@@ -233,6 +233,7 @@ SMPModel * SMPModel::xmlRead(string fName, vector<bool> f) {
     string sDesc;
 
     bool modelHasParams = false;
+    string logPolicies = ""; // as Table:rules;Table:rules
 
     KBase::VPModel vpmScen;
     KBase::VotingRule vrScen;
@@ -454,6 +455,24 @@ SMPModel * SMPModel::xmlRead(string fName, vector<bool> f) {
             throw (KException("SMPModel::readXML: Error reading accomodation data"));
         }
 
+        // Read the optional logging policies, one table each
+        XMLElement* lpsEl = scenEl->FirstChildElement("LogPolicies");
+        if (nullptr != lpsEl) {
+            XMLElement* lpEl = lpsEl->FirstChildElement("logPolicy");
+            while (nullptr != lpEl) {
+                auto tabEl = getFirstChild(lpEl, "table");
+                auto rulesEl = getFirstChild(lpEl, "rules");
+                if ((nullptr == tabEl) || (nullptr == tabEl->GetText())) {
+                    throw (KException("SMPModel::readXML: logPolicy without a table"));
+                }
+                const char* rules = (nullptr == rulesEl) ? nullptr : rulesEl->GetText();
+                logPolicies += string(tabEl->GetText()) + ":" + (rules ? rules : "") + ";";
+                lpEl = lpEl->NextSiblingElement("logPolicy");
+            }
+            LOG(INFO) << "Log policies:" << logPolicies;
+            Model::parseLogPolicies(logPolicies); // throws if malformed
+        }
+
     }
     catch (const KException& ke)
     {
@@ -486,6 +505,9 @@ SMPModel * SMPModel::xmlRead(string fName, vector<bool> f) {
         smp->brgnMod = bModScen;
     }
 
+    // those given on the command line take precedence
+    smp->setLogPolicies(logPolicies, false);
+
     return smp;
 }
 // end of readXML
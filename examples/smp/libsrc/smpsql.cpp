@@ -27,10 +27,13 @@
 
 #include "smp.h"
 #include "sqlite3.h"
-#include <QSqlQuery>
-#include <QVariant>
-#include <QSqlError>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+#ifdef KTAB_QT_SQL
 #include <QCoreApplication>
+#endif
 
 namespace SMPLib {
 using std::function;
@@ -140,8 +143,10 @@ KTable * SMPModel::createSQL(unsigned int n)  {
 
 
 void SMPModel::sqlTest() {
+#ifdef KTAB_QT_SQL
   QCoreApplication::addLibraryPath("./plugins");
-  initDBDriver(QString("smpDB"));
+#endif
+  initDBDriver();
 
   if (0 == dbDriver.compare("QPSQL")) {
     if (!connectDB()) {
@@ -151,22 +156,19 @@ void SMPModel::sqlTest() {
         assert(false);
       }
 
-      query = QSqlQuery(*qtDB);
-
       // Check if the database exists
       if (!isDB(databaseName)) {
         // if doesn't exist create one
         if (createDB(databaseName)) {
           // close the connection to the postgres db
-          qtDB->close();
+          closeDB();
           // connect to the newly created database
           if (connectDB()) {
             LOG(INFO) << "Connected to newly created database.";
-            query = QSqlQuery(*qtDB);
           }
           else {
             LOG(INFO) << "Not connected to new db";
-            LOG(INFO) << qtDB->lastError().text().toStdString();
+            LOG(INFO) << dbConn->lastError();
             assert(false);
           }
         }
@@ -175,19 +177,17 @@ void SMPModel::sqlTest() {
         }
       }
       else {
-        LOG(INFO) << "Database " << databaseName.toStdString()
+        LOG(INFO) << "Database " << databaseName
           << " exists but not able to connect to it.";
         assert(false);
       }
     }
-    else {
-      query = QSqlQuery(*qtDB);
-    }
   }
   else if (0 == dbDriver.compare("QSQLITE")) {
-    qtDB->setDatabaseName(databaseName);
-    qtDB->open();
-    query = QSqlQuery(*qtDB);
+    if (!connectDB()) {
+      LOG(INFO) << "Could not open" << databaseName << ":" << dbConn->lastError();
+      assert(false);
+    }
     configSqlite();
   }
   else {
@@ -195,6 +195,17 @@ void SMPModel::sqlTest() {
       assert(false);
   }
 
+  // an existing database keeps its layout
+  schemaVersion = dbSchemaVersion(*dbConn);
+  if (0 == schemaVersion) {
+    schemaVersion = newSchemaVersion;
+  }
+  LOG(INFO) << "Database schema version" << schemaVersion;
+  if (2 == schemaVersion) {
+    setScenarioKey(); // before the views that join on it
+  }
+  const bool sqliteP = (0 == dbDriver.compare("QSQLITE"));
+
   // Create & execute SQL statements
   // JAH 20160728 rewritten to complete the vector of KTables before creating the table
   for (unsigned int i = 0; i < SMPModel::NumTables + Model::NumTables; i++) {
@@ -203,7 +214,14 @@ void SMPModel::sqlTest() {
     assert(nullptr != thistable);
     KTables.push_back(thistable);
     // create the table
-    execQuery(thistable->tabSQL);
+    if (2 == schemaVersion) {
+      for (auto s : compactSQL(thistable, sqliteP)) {
+        execQuery(s);
+      }
+    }
+    else {
+      execQuery(thistable->tabSQL);
+    }
   }
 
   return;
@@ -215,6 +233,7 @@ void SMPModel::sqlTest() {
 // salience, capability, and dimensions tables
 void SMPModel::LogInfoTables()
 {
+  KBase::ScopedTimer tmr("SMPModel::LogInfoTables");
   // first call the KModel version to do the actors and scenarios tables
   Model::LogInfoTables();
 
@@ -224,25 +243,24 @@ void SMPModel::LogInfoTables()
 
   // for efficiency sake, we'll do all tables in a single transaction
   // form insert commands
-  string sqlD = string("INSERT INTO DimensionDescription (ScenarioId,Dim_k,\"Desc\") VALUES ('")
-    + scenId + "', :dim_k, :desc)";
+  string sqlD = string("INSERT INTO ") + sqlTab("DimensionDescription") + " (" + sqlScenCol() + ",Dim_k,\"Desc\") VALUES ("
+    + sqlScenVal() + ", :dim_k, :desc)";
 
-  string sqlC = string("INSERT INTO SpatialCapability (ScenarioId, Turn_t, Act_i, Cap) VALUES ('")
-    + scenId + "', :turn_t, :act_i, :cap)";
+  string sqlC = string("INSERT INTO ") + sqlTab("SpatialCapability") + " (" + sqlScenCol() + ", Turn_t, Act_i, Cap) VALUES ("
+    + sqlScenVal() + ", :turn_t, :act_i, :cap)";
 
-  string sqlS = string("INSERT INTO SpatialSalience (ScenarioId, Turn_t, Act_i, Dim_k,Sal) VALUES ('")
-    + scenId + "', :turn_t, :act_i, :dim_k, :sal)";
+  string sqlS = string("INSERT INTO ") + sqlTab("SpatialSalience") + " (" + sqlScenCol() + ", Turn_t, Act_i, Dim_k,Sal) VALUES ("
+    + sqlScenVal() + ", :turn_t, :act_i, :dim_k, :sal)";
 
   string sqlSc = string("UPDATE ScenarioDesc SET VotingRule = :vr, BigRAdjust = :br, "
     "BigRRange = :brr, ThirdPartyCommit = :tpc, InterVecBrgn = :ivb, BargnModel = :bm "
     " WHERE ScenarioId = '")
     + scenId + "'";
 
-  string sqlAcc = string("INSERT INTO Accommodation (ScenarioId, Act_i, Act_j, Affinity) VALUES ('")
-    + scenId
-    + "', :act_i, :act_j, :affinity)";
+  string sqlAcc = string("INSERT INTO ") + sqlTab("Accommodation") + " (" + sqlScenCol() + ", Act_i, Act_j, Affinity) VALUES ("
+    + sqlScenVal() + ", :act_i, :act_j, :affinity)";
 
-  qtDB->transaction();
+  dbConn->transaction();
 
   // Retrieve accommodation matrix
   auto st = dynamic_cast<SMPState *>(history.back());
@@ -250,7 +268,7 @@ void SMPModel::LogInfoTables()
   auto accM = st->getAccomodate();
 
   // Accomodation table to record affinities
-  query.prepare(QString::fromStdString(sqlAcc));
+  query.prepare(sqlAcc);
   assert((accM.numR() == numAct) && (accM.numC() == numAct));
   for (unsigned int Act_i = 0; Act_i < numAct; ++Act_i) {
       for (unsigned int Act_j = 0; Act_j < numAct; ++Act_j) {
@@ -260,14 +278,14 @@ void SMPModel::LogInfoTables()
           query.bindValue(":affinity", accM(Act_i, Act_j));
           // record
           if (!query.exec()) {
-            LOG(INFO) << query.lastError().text().toStdString();
+            LOG(INFO) << query.lastError();
             assert(false);
           }
       }
   }
 
   // Dimension Description Table
-  query.prepare(QString::fromStdString(sqlD));
+  query.prepare(sqlD);
   for (unsigned int k = 0; k < dimName.size(); k++)
   {
     // bind the data
@@ -275,13 +293,13 @@ void SMPModel::LogInfoTables()
     query.bindValue(":desc", dimName[k].c_str());
     // record
     if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
+      LOG(INFO) << query.lastError();
       assert(false);
     }
   }
 
   // Spatial Capability
-  query.prepare(QString::fromStdString(sqlC));
+  query.prepare(sqlC);
   // for each turn extract the information
   for (unsigned int t = 0; t < history.size(); t++) {
     auto st = history[t];
@@ -295,14 +313,14 @@ void SMPModel::LogInfoTables()
       query.bindValue(":cap", caps(0, i));
       // record
       if (!query.exec()) {
-        LOG(INFO) << query.lastError().text().toStdString();
+        LOG(INFO) << query.lastError();
         assert(false);
       }
     }
   }
 
   // Spatial Salience
-  query.prepare(QString::fromStdString(sqlS));
+  query.prepare(sqlS);
   // for each turn extract the information
   for (unsigned int t = 0; t < history.size(); t++) {
     // Get the individual turn
@@ -323,14 +341,14 @@ void SMPModel::LogInfoTables()
         query.bindValue(":sal", ai->vSal(k, 0));
         // record
         if (!query.exec()) {
-          LOG(INFO) << query.lastError().text().toStdString();
+          LOG(INFO) << query.lastError();
           assert(false);
         }
       }
     }
   }
 
-  query.prepare(QString::fromStdString(sqlSc));
+  query.prepare(sqlSc);
   //ScenarioDesc table
   query.bindValue(":vr", static_cast<int>(vrCltn));
   query.bindValue(":br", static_cast<int>(bigRAdj));
@@ -340,12 +358,12 @@ void SMPModel::LogInfoTables()
   query.bindValue(":bm", static_cast<int>(brgnMod));
 
   if (!query.exec()) {
-    LOG(INFO) << query.lastError().text().toStdString();
+    LOG(INFO) << query.lastError();
     assert(false);
   }
 
   // finish
-  qtDB->commit();
+  dbConn->commit();
 
   return;
 }
@@ -355,16 +373,17 @@ void SMPModel::LogInfoTables()
 void SMPState::updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
                                 map<unsigned int, KBase::KMatrix>  actorBargains,
                                 map<unsigned int, unsigned int>   actorMaxBrgNdx) const {
+  KBase::ScopedTimer tmr("SMPState::updateBargnTable");
 
-  string sql = string("UPDATE Bargn SET Init_Prob = :init_prob, Init_Seld = :init_seld, "
+  string sql = string("UPDATE ") + model->sqlTab("Bargn") + " SET Init_Prob = :init_prob, Init_Seld = :init_seld, "
     "Recd_Prob = :recd_prob, Recd_Seld = :recd_seld "
-    "WHERE ('" + model->getScenarioID() + "' = ScenarioId) "
+    "WHERE (" + model->sqlScenVal() + " = " + model->sqlScenCol() + ") "
     "and (:turn_t = Turn_t) and (:bgnId = BargnId) "
-    "and (:init_act_i = Init_Act_i) and (:recd_act_j = Recd_Act_j)");
+    "and (:init_act_i = Init_Act_i) and (:recd_act_j = Recd_Act_j)";
 
-  QSqlQuery query = model->getQuery();
+  KBase::DBQuery query = model->getQuery();
 
-  query.prepare(QString::fromStdString(sql));
+  query.prepare(sql);
 
   auto updateBargn = [&query, this](int bargnID,
     int initActor, double initProb, int isInitSelected,
@@ -382,9 +401,9 @@ void SMPState::updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
     }
     else {
       // Pass NULL values for SQ cases
-      query.bindValue(":recd_prob", QVariant::Double);
+      query.bindValue(":recd_prob", KBase::DBValue());
 
-      query.bindValue(":recd_seld", QVariant::Int);
+      query.bindValue(":recd_seld", KBase::DBValue());
     }
 
     query.bindValue(":turn_t", turn);
@@ -396,7 +415,7 @@ void SMPState::updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
     query.bindValue(":recd_act_j", recvActor);
 
     if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
+      LOG(INFO) << query.lastError();
       assert(false);
     }
 
@@ -408,7 +427,11 @@ void SMPState::updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
 
   // Update the bargain table for the bargain values for init actor and recd actor
   // along with the info whether a bargain got selected or not in the respective actor's queue
+  const KBase::LogPolicy & lp = model->logPolicy("Bargn");
   for (unsigned int i = 0; i < brgns.size(); i++) {
+    if (!lp.actorP(i)) {
+      continue; // no rows of this initiator were logged
+    }
     auto ai = ((const SMPActor*)(model->actrs[i]));
     double initProb = -0.1;
     int initSelected = -1;
@@ -479,6 +502,7 @@ void SMPState::updateBargnTable(const vector<vector<BargainSMP*>> & brgns,
 }
 
 void SMPState::recordProbEduChlg() const {
+  KBase::ScopedTimer tmr("SMPState::recordProbEduChlg");
   size_t basePos = -1;
   size_t digCount = 0;
   size_t nextCommaPos = string::npos;
@@ -490,19 +514,35 @@ void SMPState::recordProbEduChlg() const {
     return actors.substr(basePos, digCount);
   };
 
-  QSqlQuery query = model->getQuery();
-  string qsql;
-  qsql = string("INSERT INTO TPProbVictLoss "
-    "(ScenarioId, Turn_t, Est_h, Init_i, ThrdP_k, Rcvr_j, Prob, Util_V, Util_L) "
-    "VALUES ("
-    "'") + model->getScenarioID() + "',"
-    " :t, :h, :i, :thrdp_k, :j, :prob, :util_v, :util_l )";
-
-  query.prepare(QString::fromStdString(qsql));
+  // each table keeps only the rows its log policy wants
+  auto keeper = [this](const char * tab) {
+    const bool turnP = model->logTurn(tab, turn);
+    const KBase::LogPolicy * lp = &(model->logPolicy(tab));
+    return [turnP, lp](int h, int i) {
+      return turnP && lp->estP(h, i) && lp->actorP(i);
+    };
+  };
+  const auto keepTPV = keeper("TPProbVictLoss");
+  const auto keepPV = keeper("ProbVict");
+  const auto keepUC = keeper("UtilChlg");
+
+  // probEduChlg records (t,h,i,j) once per affected actor k, with the same
+  // values each time, so log only the first of each run of equal keys
+  string lastKey = "";
+  auto repeatP = [&lastKey](const string & key) {
+    const bool rp = (key == lastKey);
+    lastKey = key;
+    return rp;
+  };
 
-  //model->beginDBTransaction();
+  // the caller holds the transaction
+  model->bulkBegin("TPProbVictLoss",
+    { "Turn_t", "Est_h", "Init_i", "ThrdP_k", "Rcvr_j", "Prob", "Util_V", "Util_L" }, false);
   for (auto &tpv : tpvData) {
     auto thij = tpv.first;
+    if (repeatP(thij)) {
+      continue;
+    }
     auto tpvArray = tpv.second;
 
     basePos = -1;
@@ -513,38 +553,26 @@ void SMPState::recordProbEduChlg() const {
     auto h = std::stoi(nextActor(thij));
     auto i = std::stoi(nextActor(thij));
     auto j = std::stoi(nextActor(thij));
-
-    query.bindValue(":t", t);
-    query.bindValue(":h", h);
-    query.bindValue(":i", i);
-    query.bindValue(":j", j);
+    if (!keepTPV(h, i)) {
+      continue;
+    }
 
     const unsigned int na = model->numAct;
 
     for (int tpk = 0; tpk < na; tpk++) {  // third party voter, tpk
-      query.bindValue(":thrdp_k", tpk);
-
-      // bind the data
-      query.bindValue(":prob", tpvArray(tpk, 0));
-      query.bindValue(":util_v", tpvArray(tpk, 1));
-      query.bindValue(":util_l", tpvArray(tpk, 2));
-
-      // actually record it
-      if (!query.exec()) {
-        LOG(INFO) << query.lastError().text().toStdString();
-        assert(false);
-      }
+      model->bulkRow({ t, h, i, tpk, j, tpvArray(tpk, 0), tpvArray(tpk, 1), tpvArray(tpk, 2) });
     }
   }
+  model->bulkEnd();
 
-  qsql = string("INSERT INTO ProbVict "
-    "(ScenarioId, Turn_t, Est_h,Init_i,Rcvr_j,Prob) VALUES ('")
-    + model->getScenarioID() + "', :t, :h, :i, :j, :phij)";
-
-  query.prepare(QString::fromStdString(qsql));
+  model->bulkBegin("ProbVict", { "Turn_t", "Est_h", "Init_i", "Rcvr_j", "Prob" }, false);
 
+  lastKey = "";
   for (auto &phijVal : phijData) {
     auto thij = phijVal.first;
+    if (repeatP(thij)) {
+      continue;
+    }
     auto phij = phijVal.second;
 
     basePos = -1;
@@ -555,25 +583,16 @@ void SMPState::recordProbEduChlg() const {
     auto h = std::stoi(nextActor(thij));
     auto i = std::stoi(nextActor(thij));
     auto j = std::stoi(nextActor(thij));
-
-    query.bindValue(":t", t);
-    query.bindValue(":h", h);
-    query.bindValue(":i", i);
-    query.bindValue(":j", j);
-    query.bindValue(":phij", phij);
-
-    // actually record it
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
-      assert(false);
+    if (!keepPV(h, i)) {
+      continue;
     }
-  }
 
-  qsql = string("INSERT INTO UtilChlg "
-    "(ScenarioId, Turn_t, Est_h,Aff_k,Init_i,Rcvr_j,Util_SQ,Util_Vict,Util_Cntst,Util_Chlg) VALUES ('")
-    + model->getScenarioID() + "', :t, :h, :k, :i, :j, :euSQ, :euVict, :euCntst, :euChlg)";
+    model->bulkRow({ t, h, i, j, phij });
+  }
+  model->bulkEnd();
 
-  query.prepare(QString::fromStdString(qsql));
+  model->bulkBegin("UtilChlg",
+    { "Turn_t", "Est_h", "Aff_k", "Init_i", "Rcvr_j", "Util_SQ", "Util_Vict", "Util_Cntst", "Util_Chlg" }, false);
 
   for (auto &euVal : euData) {
     auto thkij = euVal.first;
@@ -586,34 +605,125 @@ void SMPState::recordProbEduChlg() const {
     auto k = std::stoi(nextActor(thkij));
     auto i = std::stoi(nextActor(thkij));
     auto j = std::stoi(nextActor(thkij));
+    if (!keepUC(h, i)) {
+      continue;
+    }
 
     auto eu = euVal.second;
-    auto euSQ = eu[0];
-    auto euVict = eu[1];
-    auto euCntst = eu[2];
-    auto euChlg = eu[3];
-
-    query.bindValue(":t", t);
-    query.bindValue(":h", h);
-    query.bindValue(":k", k);
-    query.bindValue(":i", i);
-    query.bindValue(":j", j);
-    query.bindValue(":euSQ", euSQ);
-    query.bindValue(":euVict", euVict);
-    query.bindValue(":euCntst", euCntst);
-    query.bindValue(":euChlg", euChlg);
-
-    // actually record it
-    if (!query.exec()) {
-      LOG(INFO) << query.lastError().text().toStdString();
-      assert(false);
-    }
+    model->bulkRow({ t, h, k, i, j, eu[0], eu[1], eu[2], eu[3] });
   }
-
-  //model->commitDBTransaction();
+  model->bulkEnd();
   return;
 }
 
+bool SMPModel::migrateDB(string dbName, unsigned int reps) {
+  using std::chrono::steady_clock;
+  assert(0 < reps);
+  if (dbName.empty()) {
+    dbName = databaseName;
+  }
+  const bool sqliteP = (0 == dbDriver.compare("QSQLITE"));
+  bool ok = false;
+  std::unique_ptr<KBase::DBConn> qdb(KBase::DBConn::create(dbDriver));
+  {
+    if ((nullptr == qdb) || !qdb->open(dbName, server, port, userName, password)) {
+      LOG(INFO) << "Could not open" << dbName;
+      LOG(INFO) << ((nullptr == qdb) ? "no driver " + dbDriver : qdb->lastError());
+    }
+    else if (1 != dbSchemaVersion(*qdb)) {
+      LOG(INFO) << dbName << "is not a version 1 database";
+      qdb->close();
+    }
+    else {
+      KBase::DBQuery qry(qdb.get());
+      string scen = "";
+      if (qry.exec("SELECT ScenarioId FROM ScenarioDesc") && qry.next()) {
+        scen = qry.value(0).toString();
+      }
+      qry.finish();
+
+      auto dbSize = [&]() {
+        double mb = 0.0;
+        if (sqliteP) {
+          std::ifstream dbf(dbName, std::ios::binary | std::ios::ate);
+          mb = dbf.is_open() ? dbf.tellg() / 1.0E6 : 0.0;
+        }
+        else if (qry.exec("SELECT pg_database_size(current_database())") && qry.next()) {
+          mb = qry.value(0).toDouble() / 1.0E6;
+        }
+        qry.finish();
+        return mb;
+      };
+
+      // the reads behind SMPQ's plots and tables; negative means the query failed
+      const vector<string> probes = {
+        "SELECT Dim_k, Act_i, Pos_Coord FROM VectorPosition WHERE ScenarioId = :s AND Turn_t = 0 AND Dim_k = 0",
+        "SELECT Dim_k, Turn_t, Pos_Coord FROM VectorPosition WHERE ScenarioId = :s AND Act_i = 0 ORDER BY Dim_k, Turn_t",
+        "SELECT DISTINCT Turn_t FROM VectorPosition WHERE ScenarioId = :s",
+        "SELECT Est_h, Act_i, Pos_j, Util FROM PosUtil WHERE ScenarioId = :s AND Turn_t = 0",
+        "SELECT Est_h, Init_i, Rcvr_j, Util_Chlg FROM UtilChlg WHERE ScenarioId = :s AND Turn_t = 0",
+        "SELECT Act_i, Name, \"Desc\" FROM ActorDescription WHERE ScenarioId = :s"
+      };
+      auto timeProbes = [&]() {
+        auto ms = vector<double>();
+        for (auto sql : probes) {
+          auto times = vector<double>();
+          for (unsigned int r = 0; r < reps; r++) {
+            auto t0 = steady_clock::now();
+            bool qOK = qry.prepare(sql);
+            qry.bindValue(":s", scen);
+            qOK = qOK && qry.exec();
+            while (qOK && qry.next()) {
+              qry.value(0);
+            }
+            qry.finish();
+            auto t1 = steady_clock::now();
+            times.push_back(qOK ? std::chrono::duration<double, std::milli>(t1 - t0).count() : -1.0);
+          }
+          std::sort(times.begin(), times.end());
+          ms.push_back(times[times.size() / 2]);
+        }
+        return ms;
+      };
+
+      const double mb1 = dbSize();
+      const auto ms1 = timeProbes();
+
+      auto tabs = vector<KTable*>();
+      for (unsigned int n = 0; n < Model::NumTables + NumTables; n++) {
+        tabs.push_back(createSQL(n));
+      }
+      ok = migrateToCompact(*qdb, tabs);
+      for (auto t : tabs) {
+        delete t;
+      }
+
+      if (ok) {
+        if (sqliteP) {
+          qry.exec("VACUUM");
+        }
+        else {
+          qry.exec("VACUUM ANALYZE");
+        }
+        qry.finish();
+        const double mb2 = dbSize();
+        const auto ms2 = timeProbes();
+        printf("Migrated %s to schema version %u\n", dbName.c_str(), newSchemaVersion);
+        printf("Size: %.2f MB -> %.2f MB\n", mb1, mb2);
+        printf("Median ms over %u reps for scenario %s:\n", reps, scen.c_str());
+        for (unsigned int i = 0; i < probes.size(); i++) {
+          printf("%9.3f -> %9.3f  %s\n", ms1[i], ms2[i], probes[i].c_str());
+        }
+      }
+      else {
+        LOG(INFO) << "Migration of" << dbName << "failed and was rolled back";
+      }
+      qdb->close();
+    }
+  }
+  return ok;
+}
+
 };
 // end of namespace
 
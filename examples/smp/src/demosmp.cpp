@@ -82,6 +82,11 @@ int main(int ac, char **av) {
   string inputDBname = "";
   string inputXML = "";
   string connstr;
+  string profFile = "";
+  string sankeyPrefix = "";
+  bool profP = false;
+  unsigned int numEnsemble = 0;
+  int quadMapInit = -1;
 
   auto showHelp = []() {
     printf("\n");
@@ -94,7 +99,18 @@ int main(int ac, char **av) {
     printf("--logmin         log only scenario information + position histories\n");
     printf("--savehist       export by-dim by-turn position histories (input+'_posLog.csv') and\n");
     printf("                 by-dim actor effective powers (input+'_effPower.csv')\n");
+    printf("--deferchlg      compute the challenge tables after the run rather than each turn\n");
+    printf("--logpolicy <p>  log only some rows of some tables, as Table:rules;Table:rules where\n");
+    printf("                 rules are a comma separated list of every=<n>, first=<k>, last=<k>,\n");
+    printf("                 h=i (own estimates only), actors=<i>[-<j>][+...] and top=<k> (bargains),\n");
+    printf("                 e.g. \"UtilChlg:every=5,h=i;BargnVote:top=3\"; these override the XML ones\n");
     printf("--seed <n>       set a 64bit seed; default is %020llu; 0 means truly random\n", dSeed);
+    printf("--profile <f>    time each phase of each turn; record in TurnTiming and JSON file f\n");
+    printf("--ensemble <n>   run n stochastic trajectories of the --csv or --xml scenario and\n");
+    printf("                 export by-turn position and win-probability stats (input+'_ensemble.csv')\n");
+    printf("--quadmap <i>    export the objective quad map of initiator i for every turn (input+'_quadmap.csv')\n");
+    printf("--sankey <p>     after any runs, export the Sankey files of every scenario in the --connstr\n");
+    printf("                 database, several at once, to p+'_'+scenario+'_effPow.csv' and '_posLog.csv'\n");
     printf("--connstr        a comma separated string for database server credentials:\n");
     printf("                 \"Driver=<QPSQL|QSQLITE>;Server=<IP>*;[Port=<port>]*;Database=<DB_name>;\n");
     printf("                 Uid=<user_id>*;Pwd=<password>*\"*for QPSQL only\n");
@@ -147,6 +163,70 @@ int main(int ac, char **av) {
       else if (strcmp(av[i], "--savehist") == 0) {
         saveHist = true;
       }
+      else if (strcmp(av[i], "--deferchlg") == 0) {
+        SMPLib::SMPModel::deferChlgUtils = true;
+      }
+      else if (strcmp(av[i], "--logpolicy") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                KBase::Model::logPolicySpec = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--profile") == 0) {
+        profP = true;
+        i++;
+        if (av[i] != NULL)
+        {
+                profFile = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--ensemble") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                numEnsemble = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--quadmap") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                quadMapInit = std::stoi(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--sankey") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                sankeyPrefix = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
       else if(strcmp(av[i], "--connstr") == 0) {
         i++;
         connstr = av[i];
@@ -173,6 +253,16 @@ int main(int ac, char **av) {
     sqlFlags = {true,false,false,false,true};
   }
 
+  if (run) {
+    try {
+      KBase::Model::parseLogPolicies(KBase::Model::logPolicySpec);
+    }
+    catch (const KBase::KException & ke) {
+      printf("%s\n", ke.msg.c_str());
+      run = false;
+    }
+  }
+
   if (!run) {
     showHelp();
     return 0;
@@ -202,6 +292,10 @@ int main(int ac, char **av) {
 
   SMPLib::SMPModel::loginCredentials(connstr);
 
+  if (profP) {
+    SMPLib::SMPModel::profileTurns(profFile);
+  }
+
   // note that we reset the seed every time, so that in case something
   // goes wrong, we need not scroll back too far to find the
   // seed required to reproduce the bug.
@@ -209,13 +303,34 @@ int main(int ac, char **av) {
     SMPLib::SMPModel::randomSMP(0, 0, randAccP, seed, sqlFlags);
   }
   if (csvP) {
-    SMPLib::SMPModel::runModel(sqlFlags, inputCSV, seed, saveHist);
+    if (0 < numEnsemble) {
+      SMPLib::SMPModel::runEnsembleModel(sqlFlags, inputCSV, seed, numEnsemble);
+    }
+    else {
+      SMPLib::SMPModel::runModel(sqlFlags, inputCSV, seed, saveHist);
+      if (0 <= quadMapInit) {
+        string qmFile = inputCSV.substr(0, inputCSV.find_last_of(".")) + "_quadmap.csv";
+        SMPLib::SMPModel::quadMapCSV(qmFile, quadMapInit);
+      }
+    }
     SMPLib::SMPModel::destroyModel();
   }
   if (xmlP) {
-    SMPLib::SMPModel::runModel(sqlFlags, inputXML, seed, saveHist);
+    if (0 < numEnsemble) {
+      SMPLib::SMPModel::runEnsembleModel(sqlFlags, inputXML, seed, numEnsemble);
+    }
+    else {
+      SMPLib::SMPModel::runModel(sqlFlags, inputXML, seed, saveHist);
+      if (0 <= quadMapInit) {
+        string qmFile = inputXML.substr(0, inputXML.find_last_of(".")) + "_quadmap.csv";
+        SMPLib::SMPModel::quadMapCSV(qmFile, quadMapInit);
+      }
+    }
     SMPLib::SMPModel::destroyModel();
   }
+  if (!sankeyPrefix.empty()) {
+    SMPLib::SMPModel::sankeyOutputAll(sankeyPrefix, "");
+  }
 
   KBase::displayProgramEnd(sTime);
   return 0;
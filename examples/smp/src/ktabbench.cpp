@@ -0,0 +1,454 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+//
+// Reproducible micro- and macro-benchmarks for kutils, kmodel and SMP.
+// Every case is seeded, so two runs on the same machine do the same work;
+// results go to <prefix>.csv and <prefix>.json so regressions can be tracked.
+//
+// --------------------------------------------
+
+#include "smp.h"
+#include "ktabbench.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <easylogging++.h>
+
+namespace KTabBench {
+
+using std::get;
+using KBase::VotingRule;
+using KBase::VPModel;
+using KBase::PCEModel;
+using SMPLib::SMPModel;
+using SMPLib::SMPState;
+
+// accumulate results here so the optimizer can not discard the work being timed
+static volatile double benchSink = 0.0;
+
+BenchResult timeBench(const string & group, const string & name, const string & params,
+                      unsigned int reps, function<void()> setup,
+                      function<void()> body, function<void()> teardown) {
+  using std::chrono::steady_clock;
+  assert(0 < reps);
+  auto times = vector<double>();
+  for (unsigned int r = 0; r < reps; r++) {
+    if (nullptr != setup) {
+      setup();
+    }
+    auto t0 = steady_clock::now();
+    body();
+    auto t1 = steady_clock::now();
+    if (nullptr != teardown) {
+      teardown();
+    }
+    std::chrono::duration<double, std::milli> dt = t1 - t0;
+    times.push_back(dt.count());
+  }
+  std::sort(times.begin(), times.end());
+
+  BenchResult br;
+  br.group = group;
+  br.name = name;
+  br.params = params;
+  br.reps = reps;
+  br.minMS = times[0];
+  br.maxMS = times[reps - 1];
+  br.medianMS = (1 == reps % 2) ? times[reps / 2] : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+  double s = 0.0;
+  for (auto t : times) {
+    s = s + t;
+  }
+  br.meanMS = s / reps;
+
+  printf("%-8s %-28s %-26s %3u  min %10.3f  med %10.3f  mean %10.3f ms\n",
+         group.c_str(), name.c_str(), params.c_str(), reps, br.minMS, br.medianMS, br.meanMS);
+  fflush(stdout);
+  return br;
+}
+
+// --------------------------------------------
+
+vector<BenchResult> benchKMatrix(const BenchConfig & cfg) {
+  auto rslts = vector<BenchResult>();
+  auto rng = new PRNG(cfg.seed);
+
+  for (auto n : cfg.matSizes) {
+    const string prm = "n=" + std::to_string(n);
+    auto a = KMatrix::uniform(rng, n, n, -1.0, +1.0);
+    auto b = KMatrix::uniform(rng, n, n, -1.0, +1.0);
+
+    rslts.push_back(timeBench("kutils", "KMatrix::operator*", prm, cfg.reps, nullptr,
+      [&a, &b]() {
+      auto c = a * b;
+      benchSink = benchSink + c(0, 0);
+    }, nullptr));
+
+    // diagonally dominant, so always well-conditioned
+    auto d = a + (((double)n) * KBase::iMat(n));
+    rslts.push_back(timeBench("kutils", "KBase::inv", prm, cfg.reps, nullptr,
+      [&d]() {
+      auto di = KBase::inv(d);
+      benchSink = benchSink + di(0, 0);
+    }, nullptr));
+
+    // strictly positive, so the dominant eigenvector is unique and positive
+    auto e = KMatrix::uniform(rng, n, n, 0.1, 1.0);
+    rslts.push_back(timeBench("kutils", "KBase::firstEigenvector", prm, cfg.reps, nullptr,
+      [&e]() {
+      auto ev = KBase::firstEigenvector(e, 1E-10);
+      benchSink = benchSink + ev(0, 0);
+    }, nullptr));
+  }
+
+  delete rng;
+  rng = nullptr;
+  return rslts;
+}
+
+// --------------------------------------------
+
+vector<BenchResult> benchPCE(const BenchConfig & cfg) {
+  auto rslts = vector<BenchResult>();
+  auto rng = new PRNG(cfg.seed);
+  const VPModel vpm = VPModel::Linear;
+
+  // condPCE and markovUniformPCE are private to Model,
+  // so all three solvers are reached through probCE2
+  const vector<tuple<PCEModel, string>> solvers = {
+    tuple<PCEModel, string>(PCEModel::ConditionalPCM, "Model::condPCE"),
+    tuple<PCEModel, string>(PCEModel::MarkovUPCM, "Model::markovUniformPCE"),
+    tuple<PCEModel, string>(PCEModel::MarkovIPCM, "Model::markovIncentivePCE")
+  };
+
+  for (auto n : cfg.pceSizes) {
+    const string prm = "n=" + std::to_string(n);
+    auto c = KMatrix::uniform(rng, n, n, 0.1, 1.0);
+    for (auto sv : solvers) {
+      const PCEModel pcm = get<0>(sv);
+      rslts.push_back(timeBench("kmodel", get<1>(sv), prm, cfg.reps, nullptr,
+        [&c, pcm, vpm]() {
+        auto pv = Model::probCE2(pcm, vpm, c);
+        benchSink = benchSink + get<0>(pv)(0, 0);
+      }, nullptr));
+    }
+
+    auto w = KMatrix::uniform(rng, 1, n, 1.0, 100.0);
+    auto u = KMatrix::uniform(rng, n, n, 0.0, 1.0);
+    auto vfn = [&w, &u](unsigned int k, unsigned int i, unsigned int j) {
+      return Model::vote(VotingRule::Proportional, w(0, k), u(k, i), u(k, j));
+    };
+    rslts.push_back(timeBench("kmodel", "Model::coalitions", prm, cfg.reps, nullptr,
+      [&vfn, n]() {
+      auto cs = Model::coalitions(vfn, n, n);
+      benchSink = benchSink + cs(0, 0);
+    }, nullptr));
+  }
+
+  delete rng;
+  rng = nullptr;
+  return rslts;
+}
+
+// --------------------------------------------
+
+vector<BenchResult> benchSMP(const BenchConfig & cfg) {
+  auto rslts = vector<BenchResult>();
+  const vector<bool> sqlOff = { false, false, false, false, false };
+  const vector<bool> sqlOn = { true, true, true, true, true };
+
+  // the last element is Model::bulkCopy; "on-rows" times the row-by-row INSERT, which
+  // differs from "on" only on PostgreSQL in a KTAB_PG_COPY build
+  auto sqlCases = vector<tuple<vector<bool>, string, bool>>();
+  sqlCases.push_back(tuple<vector<bool>, string, bool>(sqlOff, "off", true));
+  if (cfg.sqlOn) {
+    sqlCases.push_back(tuple<vector<bool>, string, bool>(sqlOn, "on", true));
+    sqlCases.push_back(tuple<vector<bool>, string, bool>(sqlOn, "on-rows", false));
+  }
+
+  for (auto na : cfg.numActors) {
+    for (auto nd : cfg.numDims) {
+      const string prm = "na=" + std::to_string(na) + ";nd=" + std::to_string(nd);
+      SMPModel * md = nullptr;
+      SMPState * s1 = nullptr;
+
+      auto mkModel = [&md, &cfg, na, nd](const vector<bool> & f) {
+        md = SMPModel::randomModel(na, nd, false, cfg.seed, f);
+      };
+      auto rmModel = [&md, &s1]() {
+        if (nullptr != s1) {
+          delete s1;
+          s1 = nullptr;
+        }
+        delete md;
+        md = nullptr;
+      };
+
+      // all the (i,i,i,j) estimates each actor makes when choosing a target
+      rslts.push_back(timeBench("smp", "SMPState::probEduChlg", prm, cfg.reps,
+        [&mkModel, &sqlOff]() { mkModel(sqlOff); },
+        [&md, na]() {
+        auto st0 = ((const SMPState*)(md->history[0]));
+        for (unsigned int i = 0; i < na; i++) {
+          for (unsigned int j = 0; j < na; j++) {
+            if (i != j) {
+              auto est = st0->probEduChlg(i, i, i, j, false);
+              benchSink = benchSink + get<1>(est);
+            }
+          }
+        }
+      }, rmModel));
+
+      // stepBCN on a fully prepared state with all logging off is doBCN
+      // plus the setup of the following state
+      rslts.push_back(timeBench("smp", "SMPState::doBCN", prm, cfg.reps,
+        [&mkModel, &sqlOff]() { mkModel(sqlOff); },
+        [&md, &s1]() {
+        auto st0 = ((SMPState*)(md->history[0]));
+        s1 = st0->stepBCN();
+      }, rmModel));
+
+      for (auto sc : sqlCases) {
+        const vector<bool> f = get<0>(sc);
+        const string prmSQL = prm + ";sql=" + get<1>(sc);
+        Model::bulkCopy = get<2>(sc);
+
+        // one complete turn through Model::run, including the stopping test
+        rslts.push_back(timeBench("smp", "SMP turn", prmSQL, cfg.reps,
+          [&mkModel, &md, f]() {
+          mkModel(f);
+          md->stop = SMPLib::smpStopFn(1, 1, 0.02, 1E-4);
+        },
+          [&md]() { md->run(); }, rmModel));
+
+        if (cfg.fullRuns) {
+          rslts.push_back(timeBench("smp", "SMPModel::configExec", prmSQL, cfg.reps,
+            [&mkModel, f]() { mkModel(f); },
+            [&md]() { SMPModel::configExec(md); }, rmModel));
+        }
+      }
+      Model::bulkCopy = true;
+    }
+  }
+  return rslts;
+}
+
+// --------------------------------------------
+
+void writeCSV(const string & fName, const vector<BenchResult> & rslts) {
+  std::ofstream ofs(fName);
+  if (!ofs.is_open()) {
+    throw KBase::KException("KTabBench::writeCSV: could not open " + fName);
+  }
+  ofs << "group,name,params,reps,min_ms,median_ms,mean_ms,max_ms" << std::endl;
+  for (auto br : rslts) {
+    ofs << br.group << "," << br.name << ",\"" << br.params << "\"," << br.reps << ","
+        << KBase::getFormattedString("%.6f,%.6f,%.6f,%.6f", br.minMS, br.medianMS, br.meanMS, br.maxMS)
+        << std::endl;
+  }
+  ofs.close();
+  return;
+}
+
+void writeJSON(const string & fName, const BenchConfig & cfg, const vector<BenchResult> & rslts) {
+  std::ofstream ofs(fName);
+  if (!ofs.is_open()) {
+    throw KBase::KException("KTabBench::writeJSON: could not open " + fName);
+  }
+
+  auto t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  char utc[32];
+  std::strftime(utc, sizeof(utc), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+
+  ofs << "{" << std::endl;
+  ofs << "  \"app\": \"" << appName << "\"," << std::endl;
+  ofs << "  \"version\": \"" << appVersion << "\"," << std::endl;
+  ofs << "  \"utc\": \"" << utc << "\"," << std::endl;
+  ofs << KBase::getFormattedString("  \"seed\": %llu,", (unsigned long long)cfg.seed) << std::endl;
+  ofs << "  \"reps\": " << cfg.reps << "," << std::endl;
+  ofs << "  \"hwThreads\": " << std::thread::hardware_concurrency() << "," << std::endl;
+  ofs << "  \"results\": [" << std::endl;
+  for (unsigned int n = 0; n < rslts.size(); n++) {
+    auto br = rslts[n];
+    ofs << "    {\"group\": \"" << br.group << "\", \"name\": \"" << br.name
+        << "\", \"params\": \"" << br.params << "\", \"reps\": " << br.reps << ", "
+        << KBase::getFormattedString(
+          "\"min_ms\": %.6f, \"median_ms\": %.6f, \"mean_ms\": %.6f, \"max_ms\": %.6f}",
+          br.minMS, br.medianMS, br.meanMS, br.maxMS)
+        << ((n + 1 < rslts.size()) ? "," : "") << std::endl;
+  }
+  ofs << "  ]" << std::endl;
+  ofs << "}" << std::endl;
+  ofs.close();
+  return;
+}
+
+}; // end of namespace
+
+// --------------------------------------------
+
+int main(int ac, char **av) {
+  using std::string;
+  using KTabBench::BenchConfig;
+  using KTabBench::BenchResult;
+  using KBase::Model;
+
+  BenchConfig cfg;
+  bool run = true;
+  bool kutilsP = true;
+  bool kmodelP = true;
+  bool smpP = true;
+  string logConf = "";
+  string connstr = "Driver=QSQLITE;Database=ktab-bench";
+
+  auto parseList = [](const char * s) {
+    auto lst = std::vector<unsigned int>();
+    std::stringstream ss(s);
+    string tok;
+    while (getline(ss, tok, ',')) {
+      lst.push_back(std::stoul(tok));
+    }
+    return lst;
+  };
+
+  auto showHelp = []() {
+    printf("\n");
+    printf("Usage: specify zero or more of these options\n");
+    printf("--help           print this message\n");
+    printf("--reps <n>       timed repetitions of each case; default is 5\n");
+    printf("--seed <n>       set a 64bit seed; default is %020llu\n", (unsigned long long)KBase::dSeed);
+    printf("--mat <list>     comma-separated KMatrix sizes; default is 10,50,100,200\n");
+    printf("--pce <list>     comma-separated PCE/coalition sizes; default is 10,25,50\n");
+    printf("--actors <list>  comma-separated SMP actor counts; default is 5,10,20\n");
+    printf("--dims <list>    comma-separated SMP dimension counts; default is 1,2,3\n");
+    printf("--only <grp>     run only one group: kutils, kmodel, or smp\n");
+    printf("--nosql          skip the SMP cases with SQL logging on\n");
+    printf("--noruns         skip the full SMP runs\n");
+    printf("--out <prefix>   write <prefix>.csv and <prefix>.json; default is ktab-bench\n");
+    printf("--log <f>        enable logging, configured from file f; default is no logging\n");
+    printf("--connstr        database credentials, as for smpc; default is %s\n",
+           "\"Driver=QSQLITE;Database=ktab-bench\"");
+    printf("                 with a local QPSQL server, sql=on vs. sql=on-rows compares COPY\n");
+    printf("                 with row-by-row INSERT\n");
+  };
+
+  for (int i = 1; i < ac; i++) {
+    bool hasVal = (i + 1 < ac);
+    if ((strcmp(av[i], "--reps") == 0) && hasVal) {
+      cfg.reps = std::stoul(av[++i]);
+    }
+    else if ((strcmp(av[i], "--seed") == 0) && hasVal) {
+      cfg.seed = std::stoull(av[++i]);
+    }
+    else if ((strcmp(av[i], "--mat") == 0) && hasVal) {
+      cfg.matSizes = parseList(av[++i]);
+    }
+    else if ((strcmp(av[i], "--pce") == 0) && hasVal) {
+      cfg.pceSizes = parseList(av[++i]);
+    }
+    else if ((strcmp(av[i], "--actors") == 0) && hasVal) {
+      cfg.numActors = parseList(av[++i]);
+    }
+    else if ((strcmp(av[i], "--dims") == 0) && hasVal) {
+      cfg.numDims = parseList(av[++i]);
+    }
+    else if ((strcmp(av[i], "--only") == 0) && hasVal) {
+      string grp = av[++i];
+      kutilsP = (grp == "kutils");
+      kmodelP = (grp == "kmodel");
+      smpP = (grp == "smp");
+    }
+    else if (strcmp(av[i], "--nosql") == 0) {
+      cfg.sqlOn = false;
+    }
+    else if (strcmp(av[i], "--noruns") == 0) {
+      cfg.fullRuns = false;
+    }
+    else if ((strcmp(av[i], "--out") == 0) && hasVal) {
+      cfg.outPrefix = av[++i];
+    }
+    else if ((strcmp(av[i], "--log") == 0) && hasVal) {
+      logConf = av[++i];
+    }
+    else if ((strcmp(av[i], "--connstr") == 0) && hasVal) {
+      connstr = av[++i];
+    }
+    else if (strcmp(av[i], "--help") == 0) {
+      run = false;
+    }
+    else {
+      run = false;
+      printf("Unrecognized argument %s\n", av[i]);
+    }
+  }
+
+  if (!run) {
+    showHelp();
+    return 0;
+  }
+
+  if (0 == cfg.reps) {
+    cfg.reps = 1;
+  }
+
+  // the model code logs copiously, which would dominate the timings
+  if (logConf.empty()) {
+    el::Configurations loggerConf;
+    loggerConf.set(el::Level::Global, el::ConfigurationType::Enabled, "false");
+    el::Loggers::reconfigureAllLoggers(loggerConf);
+  }
+  else {
+    Model::configLogger(logConf);
+  }
+
+  auto sTime = KBase::displayProgramStart(KTabBench::appName, KTabBench::appVersion);
+  printf("Using PRNG seed:  %020llu \n", (unsigned long long)cfg.seed);
+
+  auto rslts = std::vector<BenchResult>();
+  auto addAll = [&rslts](const std::vector<BenchResult> & rs) {
+    rslts.insert(rslts.end(), rs.begin(), rs.end());
+  };
+
+  if (kutilsP) {
+    addAll(KTabBench::benchKMatrix(cfg));
+  }
+  if (kmodelP) {
+    addAll(KTabBench::benchPCE(cfg));
+  }
+  if (smpP) {
+    Model::loginCredentials(connstr);
+    addAll(KTabBench::benchSMP(cfg));
+  }
+
+  KTabBench::writeCSV(cfg.outPrefix + ".csv", rslts);
+  KTabBench::writeJSON(cfg.outPrefix + ".json", cfg, rslts);
+  printf("Results written to %s.csv and %s.json \n", cfg.outPrefix.c_str(), cfg.outPrefix.c_str());
+
+  KBase::displayProgramEnd(sTime);
+  return 0;
+}
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,86 @@
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+
+#ifndef KTAB_BENCH_H
+#define KTAB_BENCH_H
+
+#include "smp.h"
+
+namespace KTabBench {
+// namespace to which KBase has no access
+using std::function;
+using std::string;
+using std::tuple;
+using std::vector;
+using KBase::KMatrix;
+using KBase::PRNG;
+using KBase::Model;
+
+const string appName = "ktab-bench";
+const string appVersion = "0.1";
+// -------------------------------------------------
+
+// One timed benchmark: 'reps' repetitions of the body, each after an
+// untimed setup and followed by an untimed teardown. Times in milliseconds.
+struct BenchResult {
+  string group = "";  // kutils, kmodel, smp
+  string name = "";   // e.g. "KMatrix::inv"
+  string params = ""; // e.g. "n=50" or "na=10;nd=2;sql=on"
+  unsigned int reps = 0;
+  double minMS = 0.0;
+  double medianMS = 0.0;
+  double meanMS = 0.0;
+  double maxMS = 0.0;
+};
+
+struct BenchConfig {
+  uint64_t seed = KBase::dSeed;
+  unsigned int reps = 5;
+  vector<unsigned int> matSizes = { 10, 50, 100, 200 };
+  vector<unsigned int> pceSizes = { 10, 25, 50 };
+  vector<unsigned int> numActors = { 5, 10, 20 };
+  vector<unsigned int> numDims = { 1, 2, 3 };
+  bool sqlOn = true;  // also time the SMP cases with all SQL logging groups enabled
+  bool fullRuns = true;
+  string outPrefix = "ktab-bench";
+};
+
+BenchResult timeBench(const string & group, const string & name, const string & params,
+                      unsigned int reps, function<void()> setup,
+                      function<void()> body, function<void()> teardown);
+
+vector<BenchResult> benchKMatrix(const BenchConfig & cfg);
+vector<BenchResult> benchPCE(const BenchConfig & cfg);
+vector<BenchResult> benchSMP(const BenchConfig & cfg);
+
+void writeCSV(const string & fName, const vector<BenchResult> & rslts);
+void writeJSON(const string & fName, const BenchConfig & cfg, const vector<BenchResult> & rslts);
+
+}; // end of namespace
+
+
+// --------------------------------------------
+#endif
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
@@ -0,0 +1,106 @@
+﻿// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------
+// The MIT License (MIT)
+//
+// Copyright (c) 2015 King Abdullah Petroleum Studies and Research Center
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom
+// the Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies or
+// substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+// --------------------------------------------
+//
+//
+// Convert an SMP database to the compact schema and report how its size and
+// the latency of typical SMPQ queries change.
+//
+// --------------------------------------------
+
+#include "smp.h"
+#include "smpmigrate.h"
+#include <easylogging++.h>
+
+int main(int ac, char **av) {
+  using std::string;
+  bool run = true;
+  unsigned int reps = 5;
+  string connstr = "";
+
+  auto showHelp = []() {
+    printf("\n");
+    printf("Usage: specify one or more of these options\n");
+    printf("--help           print this message\n");
+    printf("--reps <n>       time each query n times and report the median; default is 5\n");
+    printf("--connstr        a comma separated string for database server credentials:\n");
+    printf("                 \"Driver=<QPSQL|QSQLITE>;Server=<IP>*;[Port=<port>]*;Database=<DB_name>;\n");
+    printf("                 Uid=<user_id>*;Pwd=<password>*\"*for QPSQL only\n");
+  };
+
+  if (ac > 1) {
+    for (int i = 1; i < ac; i++) {
+      if (strcmp(av[i], "--reps") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                reps = std::stoul(av[i]);
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--connstr") == 0) {
+        i++;
+        if (av[i] != NULL)
+        {
+                connstr = av[i];
+        }
+        else
+        {
+                run = false;
+                break;
+        }
+      }
+      else if (strcmp(av[i], "--help") == 0) {
+        run = false;
+      }
+      else {
+        run = false;
+        printf("Unrecognized argument %s\n", av[i]);
+      }
+    }
+  }
+  else {
+    run = false; // no arguments supplied
+  }
+
+  if ((!run) || connstr.empty() || (0 == reps)) {
+    showHelp();
+    return 0;
+  }
+
+  SMPLib::SMPModel::configLogger("./smpc-logger.conf");
+  auto sTime = KBase::displayProgramStart(SMPMigrate::appName, SMPMigrate::appVersion);
+
+  SMPLib::SMPModel::loginCredentials(connstr);
+  const bool ok = SMPLib::SMPModel::migrateDB("", reps);
+
+  KBase::displayProgramEnd(sTime);
+  return ok ? 0 : 1;
+}
+
+// --------------------------------------------
+// Copyright KAPSARC. Open source MIT License.
+// --------------------------------------------